@@ -0,0 +1,249 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <exception>
+#include <algorithm>
+
+#include "thread-pool.h"
+
+using namespace Tools;
+using namespace std;
+
+namespace
+{
+	//! pool and queue index of the worker running in this thread
+	thread_local const ThreadPool* currentPool = NULL;
+	thread_local size_t currentWorker = 0;
+}
+
+ThreadPool::ThreadPool(unsigned int threads)
+	: _pending(0),
+		_stop(false)
+{
+	if(threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	for(unsigned int i = 0; i < threads; i++)
+		_queues.push_back(unique_ptr<Queue>(new Queue));
+	for(unsigned int i = 1; i < threads; i++)
+		_threads.push_back(thread(&ThreadPool::work, this, size_t(i - 1)));
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard<mutex> lock(_sleepMutex);
+		_stop = true;
+	}
+	_wakeUp.notify_all();
+	for(size_t i = 0; i < _threads.size(); i++)
+		_threads[i].join();
+}
+
+bool ThreadPool::isWorkerThread() const
+{
+	return currentPool == this;
+}
+
+void ThreadPool::submit(function<void()> task)
+{
+	//without workers nobody would ever take it from the queue
+	if(_threads.empty())
+	{
+		task();
+		return;
+	}
+	Queue& q = *_queues[isWorkerThread() ? currentWorker : _threads.size()];
+	{
+		lock_guard<mutex> lock(q.mutex);
+		q.tasks.push_back(std::move(task));
+	}
+	++_pending;
+	{
+		lock_guard<mutex> lock(_sleepMutex);
+	}
+	_wakeUp.notify_one();
+}
+
+bool ThreadPool::popTask(size_t self, function<void()>& task)
+{
+	size_t nq = _queues.size();
+	//own tasks newest first, then the oldest of the others
+	for(size_t i = 0; i < nq; i++)
+	{
+		Queue& q = *_queues[(self + i) % nq];
+		lock_guard<mutex> lock(q.mutex);
+		if(q.tasks.empty())
+			continue;
+		if(i == 0 && self < _threads.size())
+		{
+			task = std::move(q.tasks.back());
+			q.tasks.pop_back();
+		}
+		else
+		{
+			task = std::move(q.tasks.front());
+			q.tasks.pop_front();
+		}
+		--_pending;
+		return true;
+	}
+	return false;
+}
+
+bool ThreadPool::runPendingTask()
+{
+	function<void()> task;
+	if(!popTask(isWorkerThread() ? currentWorker : _threads.size(), task))
+		return false;
+	task();
+	return true;
+}
+
+void ThreadPool::work(size_t index)
+{
+	currentPool = this;
+	currentWorker = index;
+	while(true)
+	{
+		function<void()> task;
+		if(popTask(index, task))
+		{
+			task();
+			continue;
+		}
+
+		unique_lock<mutex> lock(_sleepMutex);
+		_wakeUp.wait(lock, [this]() { return _stop || _pending > 0; });
+		if(_stop && _pending == 0)
+			return;
+	}
+}
+
+namespace
+{
+	//! shared by the caller and the helper tasks, which may outlive the call
+	struct ParallelForState
+	{
+		ParallelForState(size_t n, const function<void(size_t)>& f,
+										 const CancellationToken& token)
+			: n(n), next(0), done(0), f(f), token(token) {}
+
+		size_t n;
+		atomic<size_t> next, done;
+		const function<void(size_t)>& f;
+		CancellationToken token;
+		mutex m;
+		condition_variable finished;
+		exception_ptr error;
+
+		void run()
+		{
+			size_t i;
+			while((i = next++) < n)
+			{
+				try
+				{
+					if(!token.isCancelled())
+						f(i);
+				}
+				catch(...)
+				{
+					lock_guard<mutex> lock(m);
+					if(!error)
+						error = current_exception();
+				}
+				if(++done == n)
+				{
+					lock_guard<mutex> lock(m);
+					finished.notify_all();
+				}
+			}
+		}
+	};
+}
+
+bool ThreadPool::parallelFor(size_t n, const function<void(size_t)>& f,
+														 const CancellationToken& token)
+{
+	if(n <= 1 || _threads.empty())
+	{
+		for(size_t i = 0; i < n && !token.isCancelled(); i++)
+			f(i);
+		return !token.isCancelled();
+	}
+
+	shared_ptr<ParallelForState> s = make_shared<ParallelForState>(n, f, token);
+	for(size_t i = 0, helpers = min(n - 1, _threads.size()); i < helpers; i++)
+		submit([s]() { s->run(); });
+	s->run();
+
+	{
+		unique_lock<mutex> lock(s->m);
+		s->finished.wait(lock, [&s]() { return s->done == s->n; });
+	}
+	if(s->error)
+		rethrow_exception(s->error);
+	return !token.isCancelled();
+}
+
+bool ThreadPool::parallelForTiles(size_t rows, size_t cols,
+																	size_t tileRows, size_t tileCols,
+																	const function<void(const Tile&)>& f,
+																	const CancellationToken& token)
+{
+	tileRows = max<size_t>(1, tileRows);
+	tileCols = max<size_t>(1, tileCols);
+	size_t tr = (rows + tileRows - 1) / tileRows, tc = (cols + tileCols - 1) / tileCols;
+	return parallelFor(tr*tc, [&](size_t i)
+	{
+		Tile t;
+		t.row = (i / tc)*tileRows;
+		t.col = (i % tc)*tileCols;
+		t.rows = min(tileRows, rows - t.row);
+		t.cols = min(tileCols, cols - t.col);
+		f(t);
+	}, token);
+}
+
+namespace
+{
+	mutex defaultPoolMutex;
+	unsigned int defaultPoolSize = 0;
+	bool defaultPoolCreated = false;
+}
+
+ThreadPool& Tools::defaultThreadPool()
+{
+	static ThreadPool* pool = NULL;
+	static once_flag created;
+	call_once(created, []()
+	{
+		lock_guard<mutex> lock(defaultPoolMutex);
+		defaultPoolCreated = true;
+		//never deleted, tasks may still use it while static objects are destroyed
+		pool = new ThreadPool(defaultPoolSize);
+	});
+	return *pool;
+}
+
+bool Tools::setDefaultThreadPoolSize(unsigned int threads)
+{
+	lock_guard<mutex> lock(defaultPoolMutex);
+	if(defaultPoolCreated)
+		return false;
+	defaultPoolSize = threads;
+	return true;
+}
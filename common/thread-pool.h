@@ -0,0 +1,236 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <future>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <stdexcept>
+#include <type_traits>
+#include <cstddef>
+
+namespace Tools
+{
+	/*!
+	 * how bulk operations may run
+	 * sequential: in the calling thread only
+	 * parallel: blocks of work are spread over the library thread pool
+	 * parallelUnsequenced: like parallel, additionally the given callables
+	 * may be called in any order (also for skipped cells), so the inner
+	 * loops can be vectorized
+	 */
+	enum class ExecutionPolicy
+	{
+		sequential,
+		parallel,
+		parallelUnsequenced
+	};
+
+	inline bool isParallel(ExecutionPolicy policy)
+	{
+		return policy != ExecutionPolicy::sequential;
+	}
+
+	//! thrown by TaskFuture::get for tasks cancelled before they started
+	class TaskCancelled : public std::runtime_error
+	{
+	public:
+		TaskCancelled() : std::runtime_error("task cancelled") {}
+	};
+
+	/*!
+	 * shared flag to stop work: tasks not started yet are skipped,
+	 * running ones can check isCancelled() to stop early,
+	 * copies refer to the same flag
+	 */
+	class CancellationToken
+	{
+	public:
+		CancellationToken() : _cancelled(std::make_shared<std::atomic<bool> >(false)) {}
+
+		void cancel() { *_cancelled = true; }
+
+		bool isCancelled() const { return *_cancelled; }
+
+	private:
+		std::shared_ptr<std::atomic<bool> > _cancelled;
+	};
+
+	//! part of a 2-D range, see ThreadPool::parallelForTiles
+	struct Tile
+	{
+		std::size_t row, col, rows, cols;
+	};
+
+	class ThreadPool;
+
+	/*!
+	 * result of ThreadPool::async, waiting on it from a task of the same pool
+	 * runs other queued tasks meanwhile, so tasks can wait on tasks
+	 */
+	template<typename T>
+	class TaskFuture
+	{
+	public:
+		TaskFuture() : _pool(NULL) {}
+		TaskFuture(ThreadPool* pool, std::future<T>&& future, CancellationToken token)
+			: _pool(pool), _future(std::move(future)), _token(token) {}
+
+		bool isValid() const { return _future.valid(); }
+
+		bool isReady() const
+		{
+			return _future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		void wait() const;
+
+		//! the result or the exception thrown by the task (TaskCancelled if cancelled)
+		T get() { wait(); return _future.get(); }
+
+		//! don't start the task if it hasn't started yet
+		void cancel() { _token.cancel(); }
+
+		const CancellationToken& cancellationToken() const { return _token; }
+
+	private:
+		ThreadPool* _pool;
+		std::future<T> _future;
+		CancellationToken _token;
+	};
+
+	/*!
+	 * work stealing thread pool: every worker has its own deque, tasks
+	 * submitted from a worker go to its deque and are taken from the back
+	 * (recently pushed, still in cache), idle workers steal from the front of
+	 * the others' deques; tasks from outside the pool go to a shared queue
+	 */
+	class ThreadPool
+	{
+	public:
+		//! 0 = one thread per core (the calling thread counts as one)
+		explicit ThreadPool(unsigned int threads = 0);
+		~ThreadPool();
+
+		//! number of threads working on a parallelFor (workers + caller)
+		unsigned int size() const { return (unsigned int)(_threads.size()) + 1; }
+
+		//! run task on one of the workers, in the calling thread if the pool has none
+		void submit(std::function<void()> task);
+
+		//! run one queued task in the calling thread, false if there was none
+		bool runPendingTask();
+
+		//! is the calling thread one of the pool's workers
+		bool isWorkerThread() const;
+
+		/*!
+		 * f(i) for all i in [0, n), returns when all are done, the calling
+		 * thread works on the loop too, so nested calls can't dead lock,
+		 * the first exception thrown by f is rethrown here
+		 * @return false if token has been cancelled (the rest of f(i) is skipped)
+		 */
+		bool parallelFor(std::size_t n, const std::function<void(std::size_t)>& f,
+										 const CancellationToken& token = CancellationToken());
+
+		/*!
+		 * f(tile) for the tiles of at most tileRows x tileCols covering
+		 * rows x cols, row major, like parallelFor
+		 */
+		bool parallelForTiles(std::size_t rows, std::size_t cols,
+													std::size_t tileRows, std::size_t tileCols,
+													const std::function<void(const Tile&)>& f,
+													const CancellationToken& token = CancellationToken());
+
+		/*!
+		 * run f() on the pool, f is skipped if token is cancelled before it
+		 * started, a pool without workers (size 1) runs f before returning
+		 */
+		template<class F>
+		TaskFuture<typename std::result_of<F()>::type>
+		async(F f, CancellationToken token = CancellationToken())
+		{
+			typedef typename std::result_of<F()>::type R;
+			std::shared_ptr<std::packaged_task<R()> > task =
+					std::make_shared<std::packaged_task<R()> >([f, token]() mutable -> R
+			{
+				if(token.isCancelled())
+					throw TaskCancelled();
+				return f();
+			});
+			TaskFuture<R> res(this, task->get_future(), token);
+			submit([task]() { (*task)(); });
+			return res;
+		}
+
+	private:
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<std::function<void()> > tasks;
+		};
+
+		bool popTask(std::size_t self, std::function<void()>& task);
+		void work(std::size_t index);
+
+		//! one per worker, the last one for tasks from outside
+		std::vector<std::unique_ptr<Queue> > _queues;
+		std::vector<std::thread> _threads;
+		std::atomic<std::size_t> _pending;
+		std::mutex _sleepMutex;
+		std::condition_variable _wakeUp;
+		bool _stop;
+	};
+
+	template<typename T>
+	void TaskFuture<T>::wait() const
+	{
+		if(!_pool || !_pool->isWorkerThread())
+		{
+			_future.wait();
+			return;
+		}
+		while(!isReady())
+			if(!_pool->runPendingTask())
+				_future.wait_for(std::chrono::milliseconds(1));
+	}
+
+	/*!
+	 * the pool shared by all parts of the library (grid operations, grid
+	 * loading, interpolation, database queries), created on first use
+	 */
+	ThreadPool& defaultThreadPool();
+
+	/*!
+	 * number of threads of the default pool (0 = one per core), has to be
+	 * called before its first use, else false is returned and nothing changes
+	 */
+	bool setDefaultThreadPoolSize(unsigned int threads);
+}
+
+#endif
@@ -1,35 +1,19 @@
-#include <list>
+#include <memory>
 
 #include "db-async.h"
+#include "common/thread-pool.h"
 
 using namespace Db;
 using namespace std;
-using namespace boost;
 
 DB* Db::connectionFor(string abstractSchema)
 {
 	return newConnection(abstractSchema);
 }
 
-struct QueryRequestData
+QueryResult runQuery(DB* con, const string& queryStatement)
 {
-	QueryRequestData() {}
-	QueryRequestData(QueryRequestData& other)
-		: abstractSchema(other.abstractSchema),
-			queryStatement(other.queryStatement),
-			resultPromise(std::move(other.resultPromise)) {}
-	QueryRequestData(const QueryRequestData& other)
-		: abstractSchema(other.abstractSchema),
-			queryStatement(other.queryStatement),
-			resultPromise(std::move(other.resultPromise)) {}
-	string abstractSchema;
-	string queryStatement;
-	promise<QueryResult> resultPromise;
-};
-
-void runQuery(DB* con, QueryRequestData qrd)
-{
-	con->select(qrd.queryStatement.c_str());
+	con->select(queryStatement.c_str());
 	DBRow row;
 
 	unsigned int cols = con->getNumberOfFields();
@@ -43,57 +27,41 @@ void runQuery(DB* con, QueryRequestData qrd)
 		qr.push_back(v);
 	}
 
-	qrd.resultPromise.set_value(qr);
+	return qr;
 }
 
-unique_future<QueryResult> Db::query(string abstractSchema, std::string queryStatement)
+namespace
 {
-	condition_variable cond;
-	mutex mut;
-
-	struct RunQueries
+	//! the workers running the queries, bounded and apart from the library pool
+	Tools::ThreadPool& queryPool()
 	{
-		condition_variable& cond;
-		mutex& mut;
-		list<QueryRequestData> jobs;
+		//the pool counts the calling thread as one of its threads
+		static Tools::ThreadPool pool(maxConcurrentQueries + 1);
+		return pool;
+	}
+}
 
-		RunQueries(condition_variable& cond, mutex& mut)
-			: cond(cond), mut(mut) {}
+boost::unique_future<QueryResult> Db::query(string abstractSchema, std::string queryStatement)
+{
+	std::shared_ptr<boost::promise<QueryResult> > result =
+		std::make_shared<boost::promise<QueryResult> >();
+	boost::unique_future<QueryResult> f = result->get_future();
 
-		void operator()()
+	//every query with its own connection
+	queryPool().submit([result, abstractSchema, queryStatement]()
+	{
+		try
 		{
-			unique_lock<mutex> lock(mut);
-			for(;;)
-			{
-				while(jobs.empty())
-				{
-					cond.wait(lock);
-				}
-
-				QueryRequestData qrd = jobs.front();
-				DB* con = connectionFor(qrd.abstractSchema);
-				runQuery(con, qrd);
-				jobs.pop_front();
-				delete con;
-			}
+			DB* con = connectionFor(abstractSchema);
+			QueryResult qr = runQuery(con, queryStatement);
+			delete con;
+			result->set_value(qr);
 		}
-	};
-	static RunQueries runQueries(cond, mut);
-	static boost::thread t(runQueries);
-
-	QueryRequestData qrd;
-	qrd.queryStatement = queryStatement;
-	qrd.abstractSchema = abstractSchema;
-
-	unique_future<QueryResult> f = qrd.resultPromise.get_future();
-
-	{
-		lock_guard<mutex> lock(runQueries.mut);
-		runQueries.jobs.push_back(qrd);
-	}
-	runQueries.cond.notify_one();
+		catch(...)
+		{
+			result->set_exception(boost::current_exception());
+		}
+	});
 
 	return std::move(f);
 }
-
-
@@ -16,8 +16,13 @@ namespace Db
 
 	//vector of result rows
 	typedef std::vector<std::vector<std::string> > QueryResult;
+	//runs the query on a few own worker threads (not the library thread pool,
+	//so waiting for the database never blocks the grid algorithms),
+	//at most maxConcurrentQueries run at the same time, the others wait
 	boost::unique_future<QueryResult> query(std::string abstractSchema, std::string queryStatement);
 
+	const unsigned int maxConcurrentQueries = 4;
+
 	//returns a vector of typed result fows
 	template<typename Tuple>
 	std::vector<Tuple> query(std::string queryStatement)
@@ -21,14 +21,40 @@ grid.h \
 platform.h \
 grid+.h \
 grid-manager.h \
-types.h
+ascii-grid-io.h \
+ascii-grid-stream.h \
+mapped-file.h \
+binary-grid.h \
+nodata-mask.h \
+neighbourhood.h \
+distance-transform.h \
+viewshed.h \
+hydrology.h \
+components.h \
+landscape-metrics.h \
+point-index.h \
+types.h \
+../common/thread-pool.h
 
 SOURCES += \
 grid.cpp \
 platform.cpp \
 feldw.cpp \
 grid+.cpp \
-grid-manager.cpp
+grid-manager.cpp \
+ascii-grid-io.cpp \
+ascii-grid-stream.cpp \
+mapped-file.cpp \
+binary-grid.cpp \
+nodata-mask.cpp \
+neighbourhood.cpp \
+distance-transform.cpp \
+viewshed.cpp \
+hydrology.cpp \
+components.cpp \
+landscape-metrics.cpp \
+point-index.cpp \
+../common/thread-pool.cpp
 
 #config
 #------------------------------------------------------------
@@ -4,14 +4,40 @@ TARGET = list-hdf
 DESTDIR = .
 OBJECTS_DIR = obj
 
+QMAKE_CXXFLAGS += -std=c++0x
+
 HEADERS += \
 	grid.h \
 	platform.h \
+	ascii-grid-io.h \
+	mapped-file.h \
+	binary-grid.h \
+	nodata-mask.h \
+	neighbourhood.h \
+	distance-transform.h \
+	viewshed.h \
+	hydrology.h \
+	components.h \
+	landscape-metrics.h \
+	point-index.h \
+	../common/thread-pool.h \
 
 SOURCES += \
 	grid.cpp \
 	platform.cpp \
 	feldw.cpp \
+	ascii-grid-io.cpp \
+	mapped-file.cpp \
+	binary-grid.cpp \
+	nodata-mask.cpp \
+	neighbourhood.cpp \
+	distance-transform.cpp \
+	viewshed.cpp \
+	hydrology.cpp \
+	components.cpp \
+	landscape-metrics.cpp \
+	point-index.cpp \
+	../common/thread-pool.cpp \
   list-hdf-main.cpp
 
 LIBS += \
@@ -21,6 +47,7 @@ LIBS += \
   -lproj \
 	-lm -lgsl -lgslcblas \
 	-lhdf5 \
+	-lpthread \
 	-L../lib \
 	-ltools
 
@@ -28,6 +55,7 @@ CONFIG += debug
 
 INCLUDEPATH += \
 	. \
+	.. \
 	../include \
 	../../sys-libs/include \
 	../../sys-libs/boost-1.39.0 \
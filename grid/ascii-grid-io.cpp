@@ -0,0 +1,703 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <cfloat>
+#include <stdint.h>
+
+#include "ascii-grid-io.h"
+#include "grid.h"
+#include "common/thread-pool.h"
+
+using namespace Grids;
+using namespace std;
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	inline const char* tokenEnd(const char* p, const char* end)
+	{
+		while(p < end && !isAsciiSpace(*p))
+			++p;
+		return p;
+	}
+
+	//! slow path for values the fast path doesn't handle exactly (nan, inf, long mantissas)
+	const char* parseWithStrtod(const char* p, const char* end, double& value)
+	{
+		const char* te = tokenEnd(p, end);
+		char buf[64];
+		size_t len = size_t(te - p);
+		if(len == 0 || len >= sizeof(buf))
+			return NULL;
+		memcpy(buf, p, len);
+		buf[len] = '\0';
+		char* e = NULL;
+		value = strtod(buf, &e);
+		return e == buf + len ? te : NULL;
+	}
+
+	//! strtof, not strtod and narrowing, which would round twice
+	const char* parseWithStrtod(const char* p, const char* end, float& value)
+	{
+		const char* te = tokenEnd(p, end);
+		char buf[64];
+		size_t len = size_t(te - p);
+		if(len == 0 || len >= sizeof(buf))
+			return NULL;
+		memcpy(buf, p, len);
+		buf[len] = '\0';
+		char* e = NULL;
+		value = strtof(buf, &e);
+		return e == buf + len ? te : NULL;
+	}
+
+	/*!
+	 * narrowing a correctly rounded double v to float rounds the exact value
+	 * correctly unless v lies exactly halfway between two floats (then the
+	 * exact value might not), subnormal floats are treated as halfway too
+	 */
+	bool isFloatHalfway(double v)
+	{
+		if(v == 0 || fabs(v) > FLT_MAX)
+			return false;
+		if(fabs(v) < FLT_MIN)
+			return true;
+		uint64_t bits;
+		memcpy(&bits, &v, sizeof(bits));
+		//the 29 mantissa bits a float doesn't have
+		return (bits & ((uint64_t(1) << 29) - 1)) == uint64_t(1) << 28;
+	}
+
+	string tokenAt(const char* p, const char* end)
+	{
+		return string(p, min(tokenEnd(p, end), p + 32));
+	}
+
+	size_t lineOf(const char* begin, const char* p)
+	{
+		return size_t(count(begin, p, '\n')) + 1;
+	}
+}
+
+const char* Grids::parseAsciiFloat(const char* p, const char* end, float& value)
+{
+	//powers of ten exactly representable as double
+	static const double pow10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* start = p;
+	bool neg = false;
+	if(p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+
+	unsigned long long m = 0;
+	int digits = 0, exp10 = 0;
+	bool anyDigit = false;
+	for(; p < end && unsigned(*p - '0') < 10; ++p, anyDigit = true)
+	{
+		if(digits < 19)
+		{
+			m = m*10 + unsigned(*p - '0');
+			if(m)
+				++digits;
+		}
+		else
+			++exp10;
+	}
+	if(p < end && *p == '.')
+	{
+		for(++p; p < end && unsigned(*p - '0') < 10; ++p, anyDigit = true)
+		{
+			if(digits < 19)
+			{
+				m = m*10 + unsigned(*p - '0');
+				if(m)
+					++digits;
+				--exp10;
+			}
+		}
+	}
+	if(!anyDigit)
+		return parseWithStrtod(start, end, value);
+
+	if(p < end && (*p == 'e' || *p == 'E'))
+	{
+		++p;
+		bool negExp = false;
+		if(p < end && (*p == '-' || *p == '+'))
+			negExp = *p++ == '-';
+		if(p == end || unsigned(*p - '0') >= 10)
+			return NULL;
+		int e = 0;
+		for(; p < end && unsigned(*p - '0') < 10; ++p)
+			if(e < 10000)
+				e = e*10 + (*p - '0');
+		exp10 += negExp ? -e : e;
+	}
+	if(p < end && !isAsciiSpace(*p))
+		return NULL;
+
+	//m and 10^|exp10| are exact doubles, so v is correctly rounded to double
+	if(digits > 15 || exp10 < -22 || exp10 > 22)
+		return parseWithStrtod(start, end, value);
+	double v = double(m);
+	v = exp10 < 0 ? v / pow10[-exp10] : v * pow10[exp10];
+	//and narrowing it to float is exact too, except for the rare halfway cases
+	if(isFloatHalfway(v))
+		return parseWithStrtod(start, end, value);
+	value = float(neg ? -v : v);
+	return p;
+}
+
+const char* Grids::parseAsciiDouble(const char* p, const char* end, double& value)
+{
+	return parseWithStrtod(p, end, value);
+}
+
+bool Grids::parseAsciiGridHeader(const char*& p, const char* end,
+																 AsciiGridHeader& h, string& error)
+{
+	bool hasNcols = false, hasNrows = false, hasX = false, hasY = false, hasCs = false;
+	bool xIsCenter = false, yIsCenter = false;
+
+	const char* q = skipAsciiSpace(p, end);
+	while(q < end && isalpha((unsigned char)*q))
+	{
+		const char* ke = tokenEnd(q, end);
+		string key(q, ke);
+		transform(key.begin(), key.end(), key.begin(), ::tolower);
+
+		//the body may start with a non numeric value (e.g. nan)
+		bool isKey = key == "ncols" || key == "nrows" || key == "cellsize"
+			|| key == "xllcorner" || key == "xllcenter" || key == "yllcorner"
+			|| key == "yllcenter" || key == "nodata_value";
+		if(!isKey && hasNcols && hasNrows && hasX && hasY && hasCs)
+			break;
+
+		if(!isKey)
+		{
+			error = "unknown header key '" + key + "'";
+			return false;
+		}
+
+		const char* vs = skipAsciiSpace(ke, end);
+		const char* ve = tokenEnd(vs, end);
+		string val(vs, ve);
+		char* e = NULL;
+		double v = strtod(val.c_str(), &e);
+		if(val.empty() || *e != '\0')
+		{
+			error = "invalid value '" + val + "' for header key '" + key + "'";
+			return false;
+		}
+
+		if(key == "ncols" || key == "nrows")
+		{
+			if(v < 1 || v != floor(v))
+			{
+				error = key + " has to be a positive integer, but is " + val;
+				return false;
+			}
+			(key == "ncols" ? h.ncols : h.nrows) = size_t(v);
+			(key == "ncols" ? hasNcols : hasNrows) = true;
+		}
+		else if(key == "xllcorner" || key == "xllcenter")
+		{
+			h.xllcorner = v;
+			hasX = true;
+			xIsCenter = key == "xllcenter";
+		}
+		else if(key == "yllcorner" || key == "yllcenter")
+		{
+			h.yllcorner = v;
+			hasY = true;
+			yIsCenter = key == "yllcenter";
+		}
+		else if(key == "cellsize")
+		{
+			if(v <= 0)
+			{
+				error = "cellsize has to be positive, but is " + val;
+				return false;
+			}
+			h.cellsize = v;
+			hasCs = true;
+		}
+		else if(key == "nodata_value")
+			h.nodata = v;
+		q = skipAsciiSpace(ve, end);
+	}
+
+	string missing;
+	if(!hasNcols) missing += " ncols";
+	if(!hasNrows) missing += " nrows";
+	if(!hasX) missing += " xllcorner";
+	if(!hasY) missing += " yllcorner";
+	if(!hasCs) missing += " cellsize";
+	if(!missing.empty())
+	{
+		error = "missing header key(s):" + missing;
+		return false;
+	}
+
+	if(xIsCenter)
+		h.xllcorner -= h.cellsize/2.0;
+	if(yIsCenter)
+		h.yllcorner -= h.cellsize/2.0;
+
+	p = q;
+	return true;
+}
+
+unsigned int Grids::asciiGridThreadCount(size_t bytes, unsigned int maxThreads)
+{
+	//below about 1MB per thread the start up costs more than it saves
+	const size_t minBytesPerThread = 1 << 20;
+	unsigned int hw = maxThreads > 0 ? maxThreads : Tools::defaultThreadPool().size();
+	size_t byBytes = bytes / minBytesPerThread;
+	return unsigned(max<size_t>(1, min<size_t>(hw > 0 ? hw : 1, byBytes)));
+}
+
+int Grids::readAsciiGrid(const string& pathToFile, grid& g, bool reversed,
+												 unsigned int threads)
+{
+	MappedFile f(pathToFile);
+	if(!f.isOpen())
+	{
+		cerr << "error (read_ascii): can not open inputfile: " << pathToFile << endl;
+		return eAsciiGridCantOpen;
+	}
+
+	const char* begin = f.data();
+	const char* end = begin + f.size();
+	const char* body = begin;
+	AsciiGridHeader h;
+	string error;
+	if(!parseAsciiGridHeader(body, end, h, error))
+	{
+		cerr << "error (read_ascii): not an ASCII-Grid: " << pathToFile
+				 << " (" << error << ")" << endl;
+		return eAsciiGridBadHeader;
+	}
+
+	g.release();
+	g.xcorner = h.xllcorner;
+	g.ycorner = h.yllcorner;
+	g.csize = float(h.cellsize);
+	g.nodata = int(h.nodata);
+	if(!g.allocate(h.nrows, h.ncols))
+		return eAsciiGridNoMemory;
+
+	//split the body at whitespace into one range per thread
+	unsigned int nt = threads > 0 ? threads : asciiGridThreadCount(size_t(end - body));
+	vector<const char*> starts(nt + 1, end);
+	starts[0] = body;
+	for(unsigned int t = 1; t < nt; t++)
+	{
+		const char* s = max(starts[t - 1], body + size_t(end - body)*t/nt);
+		while(s < end && !isAsciiSpace(*s))
+			++s;
+		starts[t] = s;
+	}
+
+	auto forAllRanges = [&](function<void(unsigned int)> f)
+	{
+		Tools::defaultThreadPool().parallelFor(nt, [&f](size_t t) { f((unsigned int)(t)); });
+	};
+
+	//count the values of every range to know where it starts in the grid
+	vector<size_t> counts(nt, 0);
+	forAllRanges([&](unsigned int t)
+	{
+		size_t c = 0;
+		for(const char* p = skipAsciiSpace(starts[t], starts[t + 1]); p < starts[t + 1];
+				p = skipAsciiSpace(tokenEnd(p, starts[t + 1]), starts[t + 1]))
+			++c;
+		counts[t] = c;
+	});
+	vector<size_t> offsets(nt + 1, 0);
+	for(unsigned int t = 0; t < nt; t++)
+		offsets[t + 1] = offsets[t] + counts[t];
+
+	size_t n = h.nrows*h.ncols;
+	if(offsets[nt] < n)
+	{
+		cerr << "error (read_ascii): file too short: " << pathToFile << " has "
+				 << offsets[nt] << " of " << n << " values ("
+				 << h.nrows << " rows x " << h.ncols << " cols)" << endl;
+		g.allocate(0, 0);
+		return eAsciiGridBadData;
+	}
+	if(offsets[nt] > n)
+		cerr << "warning (read_ascii): " << pathToFile << " contains "
+				 << (offsets[nt] - n) << " values more than the header declares" << endl;
+
+	//parse directly into the grid's block
+	float* data = g.data();
+	vector<const char*> errorAt(nt, (const char*)NULL);
+	forAllRanges([&](unsigned int t)
+	{
+		const char* e = starts[t + 1];
+		size_t i = offsets[t];
+		for(const char* p = skipAsciiSpace(starts[t], e); p < e && i < n; ++i)
+		{
+			float v;
+			const char* next = parseAsciiFloat(p, e, v);
+			if(!next)
+			{
+				errorAt[t] = p;
+				return;
+			}
+			data[reversed ? n - 1 - i : i] = v;
+			p = skipAsciiSpace(next, e);
+		}
+	});
+
+	for(unsigned int t = 0; t < nt; t++)
+	{
+		if(errorAt[t])
+		{
+			cerr << "error (read_ascii): malformed value '" << tokenAt(errorAt[t], end)
+					 << "' in line " << lineOf(begin, errorAt[t]) << " of " << pathToFile << endl;
+			g.allocate(0, 0);
+			return eAsciiGridBadData;
+		}
+	}
+
+	return eAsciiGridOk;
+}
+
+//------------------------------------------------------------------------------
+
+namespace
+{
+	//! digits of v written backwards from end, returns the new start
+	inline char* writeUInt(char* end, unsigned long long v)
+	{
+		do
+		{
+			*--end = char('0' + v % 10);
+			v /= 10;
+		}
+		while(v);
+		return end;
+	}
+
+	inline size_t writeInteger(char* out, long long v)
+	{
+		char buf[24];
+		char* e = buf + sizeof(buf);
+		char* b = writeUInt(e, v < 0 ? 0ULL - (unsigned long long)v : (unsigned long long)v);
+		if(v < 0)
+			*--b = '-';
+		memcpy(out, b, size_t(e - b));
+		return size_t(e - b);
+	}
+}
+
+size_t Grids::formatAsciiValue(char* out, float value, AsciiGridFormat format)
+{
+	static const double pow10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+	};
+
+	double v = value;
+	if(v != v || v - v != 0) //nan or inf
+		return size_t(snprintf(out, 64, "%f", v));
+
+	if(format.integral)
+		return writeInteger(out, (long long)v);
+
+	if(format.precision < 0)
+	{
+		//grids are mostly integers (nodata, classes), which need no printf
+		if(v == floor(v) && fabs(v) < 1e7)
+			return writeInteger(out, (long long)v);
+		int n = 0;
+		for(int p = 6; p <= 9; p++)
+		{
+			n = snprintf(out, 64, "%.*g", p, v);
+			if(strtof(out, NULL) == value)
+				break;
+		}
+		return size_t(n);
+	}
+
+	//fixed point like %.Nf, through one integer conversion if it fits
+	int prec = format.precision;
+	if(prec > 9 || fabs(v) >= 1e15/pow10[prec])
+		return size_t(min(63, snprintf(out, 64, "%.*f", prec, v)));
+
+	//round half to even on the exact product like printf, fma gives the
+	//rounding error of scaled to decide values which look like ties
+	double p10 = pow10[prec];
+	double scaled = fabs(v)*p10;
+	double fl = floor(scaled);
+	unsigned long long i = (unsigned long long)fl;
+	double frac = scaled - fl;
+	if(frac == 0.5)
+	{
+		double err = fma(fabs(v), p10, -scaled);
+		if(err > 0 || (err == 0 && (i & 1)))
+			++i;
+	}
+	else if(frac > 0.5)
+		++i;
+	char buf[40];
+	char* e = buf + sizeof(buf);
+	char* b = e;
+	for(int k = 0; k < prec; k++, i /= 10)
+		*--b = char('0' + i % 10);
+	if(prec > 0)
+		*--b = '.';
+	b = writeUInt(b, i);
+	if(signbit(v))
+		*--b = '-';
+	memcpy(out, b, size_t(e - b));
+	return size_t(e - b);
+}
+
+bool Grids::writeAsciiGrid(const string& pathToFile, const string& header,
+													 const float* const* rows, size_t nrows, size_t ncols,
+													 AsciiGridFormat format, bool rowsReversed,
+													 unsigned int threads)
+{
+	FILE* fp = fopen(pathToFile.c_str(), "wb");
+	if(!fp)
+	{
+		cerr << "error (write_ascii): can not open outputfile: " << pathToFile << endl;
+		return false;
+	}
+	bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+	//rows are formatted in blocks of about 4MB, one block per thread and round
+	const size_t estBytesPerRow = ncols*10 + 1;
+	size_t rowsPerBlock = max<size_t>(1, (size_t(4) << 20) / max<size_t>(1, estBytesPerRow));
+	unsigned int nt = threads > 0 ? threads : asciiGridThreadCount(nrows*estBytesPerRow);
+	vector<string> buffers(nt);
+
+	for(size_t first = 0; ok && first < nrows; first += nt*rowsPerBlock)
+	{
+		auto formatBlock = [&](unsigned int t)
+		{
+			string& buf = buffers[t];
+			buf.clear();
+			size_t from = first + t*rowsPerBlock;
+			size_t to = min(nrows, from + rowsPerBlock);
+			char value[64];
+			for(size_t r = from; r < to; r++)
+			{
+				const float* row = rows[rowsReversed ? nrows - 1 - r : r];
+				for(size_t c = 0; c < ncols; c++)
+				{
+					size_t n = formatAsciiValue(value, row[c], format);
+					value[n] = ' ';
+					buf.append(value, n + 1);
+				}
+				buf.push_back('\n');
+			}
+		};
+
+		Tools::defaultThreadPool().parallelFor(nt, [&](size_t t) { formatBlock((unsigned int)(t)); });
+
+		for(unsigned int t = 0; ok && t < nt; t++)
+			ok = fwrite(buffers[t].data(), 1, buffers[t].size(), fp) == buffers[t].size();
+	}
+
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		cerr << "error (write_ascii): could not write: " << pathToFile << endl;
+	return ok;
+}
+
+//------------------------------------------------------------------------------
+
+AsciiGridReader::AsciiGridReader(const string& pathToFile, size_t rowsPerBlock)
+	: _pathToFile(pathToFile),
+		_file(pathToFile),
+		_body(NULL),
+		_pos(NULL),
+		_nextRow(0),
+		_rowsPerBlock(max<size_t>(1, rowsPerBlock))
+{
+	if(!_file.isOpen())
+	{
+		_error = "can not open inputfile: " + pathToFile;
+		return;
+	}
+	const char* p = _file.data();
+	string error;
+	if(!parseAsciiGridHeader(p, p + _file.size(), _header, error))
+	{
+		_error = "not an ASCII-Grid: " + pathToFile + " (" + error + ")";
+		return;
+	}
+	_body = _pos = p;
+}
+
+void AsciiGridReader::rewind()
+{
+	_pos = _body;
+	_nextRow = 0;
+}
+
+bool AsciiGridReader::nextBlock(AsciiGridRowBlock& block)
+{
+	if(!isOk() || _nextRow >= _header.nrows)
+		return false;
+
+	const char* begin = _file.data();
+	const char* end = begin + _file.size();
+	size_t ncols = _header.ncols;
+	block.firstRow = _nextRow;
+	block.rows = min(_rowsPerBlock, _header.nrows - _nextRow);
+	block.ncols = ncols;
+	block.data.resize(block.rows*ncols);
+
+	const char* p = skipAsciiSpace(_pos, end);
+	for(size_t i = 0, n = block.rows*ncols; i < n; i++)
+	{
+		if(p == end)
+		{
+			ostringstream s;
+			s << "file too short: " << _pathToFile << " ends in row "
+				<< (block.firstRow + i/ncols) << " of " << _header.nrows;
+			_error = s.str();
+			return false;
+		}
+		const char* next = parseAsciiFloat(p, end, block.data[i]);
+		if(!next)
+		{
+			ostringstream s;
+			s << "malformed value '" << tokenAt(p, end) << "' in line "
+				<< lineOf(begin, p) << " of " << _pathToFile;
+			_error = s.str();
+			return false;
+		}
+		p = skipAsciiSpace(next, end);
+	}
+
+	_pos = p;
+	_nextRow += block.rows;
+	_file.dontNeed(size_t(p - begin));
+	return true;
+}
+
+//------------------------------------------------------------------------------
+
+string Grids::formatAsciiGridHeader(const AsciiGridHeader& h)
+{
+	char header[512];
+	snprintf(header, sizeof(header),
+					 "ncols         %d\n"
+					 "nrows         %d\n"
+					 "xllcorner     %f\n"
+					 "yllcorner     %f\n"
+					 "cellsize      %5.1f\n"
+					 "NODATA_value  %d\n",
+					 int(h.ncols), int(h.nrows), h.xllcorner, h.yllcorner,
+					 h.cellsize, int(h.nodata));
+	return header;
+}
+
+AsciiGridWriter::AsciiGridWriter(const string& pathToFile,
+																 const AsciiGridHeader& header,
+																 AsciiGridFormat format)
+	: _pathToFile(pathToFile),
+		_header(header),
+		_format(format),
+		_fp(fopen(pathToFile.c_str(), "wb")),
+		_ok(true),
+		_rowsWritten(0)
+{
+	if(!_fp)
+	{
+		cerr << "error (write_ascii): can not open outputfile: " << pathToFile << endl;
+		_ok = false;
+		return;
+	}
+	string h = formatAsciiGridHeader(header);
+	_ok = fwrite(h.data(), 1, h.size(), _fp) == h.size();
+}
+
+AsciiGridWriter::~AsciiGridWriter()
+{
+	close();
+}
+
+bool AsciiGridWriter::write(const AsciiGridRowBlock& block)
+{
+	if(!isOk())
+		return false;
+	if(block.firstRow != _rowsWritten || block.ncols != _header.ncols
+		 || _rowsWritten + block.rows > _header.nrows)
+	{
+		cerr << "error (write_ascii): block of rows " << block.firstRow << "-"
+				 << (block.firstRow + block.rows) << " doesn't fit into "
+				 << _pathToFile << endl;
+		_ok = false;
+		return false;
+	}
+
+	_buffer.clear();
+	char value[64];
+	for(size_t r = 0; r < block.rows; r++)
+	{
+		const float* row = block.row(r);
+		for(size_t c = 0; c < block.ncols; c++)
+		{
+			size_t n = formatAsciiValue(value, row[c], _format);
+			value[n] = ' ';
+			_buffer.append(value, n + 1);
+		}
+		_buffer.push_back('\n');
+	}
+	_ok = fwrite(_buffer.data(), 1, _buffer.size(), _fp) == _buffer.size();
+	_rowsWritten += block.rows;
+	return _ok;
+}
+
+bool AsciiGridWriter::close()
+{
+	if(!_fp)
+		return _ok;
+	if(fclose(_fp) != 0)
+		_ok = false;
+	_fp = NULL;
+	if(_ok && _rowsWritten != _header.nrows)
+	{
+		cerr << "error (write_ascii): only " << _rowsWritten << " of "
+				 << _header.nrows << " rows written to " << _pathToFile << endl;
+		_ok = false;
+	}
+	return _ok;
+}
@@ -0,0 +1,218 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef ASCII_GRID_IO_H_
+#define ASCII_GRID_IO_H_
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+#include "mapped-file.h"
+
+namespace Grids
+{
+	class grid;
+
+	//! the ESRI ASCII grid header
+	struct AsciiGridHeader
+	{
+		AsciiGridHeader()
+			: ncols(0), nrows(0), xllcorner(0), yllcorner(0),
+				cellsize(0), nodata(-9999) {}
+
+		std::size_t ncols, nrows;
+		double xllcorner, yllcorner;
+		double cellsize;
+		double nodata;
+	};
+
+	//! result of readAsciiGrid, same values as grid::read_ascii returns
+	enum AsciiGridResult
+	{
+		eAsciiGridOk = 0,
+		eAsciiGridCantOpen = -1,
+		eAsciiGridBadHeader = -2,
+		eAsciiGridNoMemory = -3,
+		eAsciiGridBadData = -4
+	};
+
+	/*!
+	 * parse the header (keys in any order, case insensitive, xllcenter/yllcenter
+	 * are converted to corners, nodata_value is optional)
+	 * @param p start of the file, on success set to the first data value
+	 * @param error description of the problem if false is returned
+	 */
+	bool parseAsciiGridHeader(const char*& p, const char* end,
+														AsciiGridHeader& header, std::string& error);
+
+	inline bool isAsciiSpace(char c)
+	{
+		return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\v';
+	}
+
+	//! first non whitespace character in [p, end) or end
+	inline const char* skipAsciiSpace(const char* p, const char* end)
+	{
+		while(p < end && isAsciiSpace(*p))
+			++p;
+		return p;
+	}
+
+	/*!
+	 * parse one whitespace delimited float starting at p (no leading whitespace),
+	 * correctly rounded to float (like strtof)
+	 * @return pointer behind the value or NULL if [p, end) doesn't start with
+	 * a valid value
+	 */
+	const char* parseAsciiFloat(const char* p, const char* end, float& value);
+
+	//! like parseAsciiFloat, but correctly rounded to double (slower)
+	const char* parseAsciiDouble(const char* p, const char* end, double& value);
+
+	//! number of parallel parts for work of the given size in bytes (at least 1)
+	unsigned int asciiGridThreadCount(std::size_t bytes, unsigned int maxThreads = 0);
+
+	/*!
+	 * read an ESRI ASCII grid into g, the body is split into ranges
+	 * which are parsed in parallel directly into g's storage
+	 * @param reversed store the values in reverse order (see grid::read_ascii_inv)
+	 * @param threads number of ranges parsed on the library thread pool,
+	 * 0 = choose by file size and pool size
+	 * @return AsciiGridResult, errors are reported on cerr
+	 */
+	int readAsciiGrid(const std::string& pathToFile, grid& g,
+										bool reversed = false, unsigned int threads = 0);
+
+	//----------------------------------------------------------------------------
+
+	//! some consecutive rows of a grid, row major
+	struct AsciiGridRowBlock
+	{
+		AsciiGridRowBlock() : firstRow(0), rows(0), ncols(0) {}
+
+		float* row(std::size_t r) { return &data[r*ncols]; }
+		const float* row(std::size_t r) const { return &data[r*ncols]; }
+
+		std::size_t firstRow, rows, ncols;
+		std::vector<float> data;
+	};
+
+	/*!
+	 * reads an ASCII grid block of rows by block of rows, so grids larger
+	 * than the memory can be processed, already read parts of the file are
+	 * given back to the OS
+	 */
+	class AsciiGridReader
+	{
+	public:
+		AsciiGridReader(const std::string& pathToFile, std::size_t rowsPerBlock = 256);
+
+		//! header could be read and no error occured so far
+		bool isOk() const { return _error.empty(); }
+
+		//! description of the last error
+		const std::string& error() const { return _error; }
+
+		const AsciiGridHeader& header() const { return _header; }
+
+		//! read the next rows into block, false at the end or on error
+		bool nextBlock(AsciiGridRowBlock& block);
+
+		//! start again with the first row
+		void rewind();
+
+	private:
+		std::string _pathToFile;
+		MappedFile _file;
+		AsciiGridHeader _header;
+		std::string _error;
+		const char* _body;
+		const char* _pos;
+		std::size_t _nextRow;
+		std::size_t _rowsPerBlock;
+	};
+
+	//----------------------------------------------------------------------------
+
+	//! how the values of a grid are written
+	struct AsciiGridFormat
+	{
+		//! shortest representation which reads back to the same float
+		static const int shortest = -1;
+
+		explicit AsciiGridFormat(int precision = 6, bool integral = false)
+			: precision(precision), integral(integral) {}
+
+		//! digits after the decimal point (like %.Nf) or shortest
+		int precision;
+		//! write values truncated to integers (e.g. for writeAscii<int>)
+		bool integral;
+	};
+
+	//! format value into out (at least 64 chars), returns the number of chars written
+	std::size_t formatAsciiValue(char* out, float value, AsciiGridFormat format);
+
+	/*!
+	 * write header and rows of an ASCII grid, blocks of rows are formatted
+	 * in parallel into large buffers and written in order
+	 * @param header the already formatted header lines
+	 * @param rows row pointers (e.g. grid::feld), every row has ncols values
+	 * @param rowsReversed write the last row first (see grid::write_ascii_inv)
+	 * @param threads number of blocks formatted at once on the library
+	 * thread pool, 0 = choose by grid size and pool size
+	 * @return false if the file couldn't be written
+	 */
+	bool writeAsciiGrid(const std::string& pathToFile, const std::string& header,
+											const float* const* rows, std::size_t nrows, std::size_t ncols,
+											AsciiGridFormat format = AsciiGridFormat(),
+											bool rowsReversed = false, unsigned int threads = 0);
+
+	//! header lines in the layout grid::write_ascii uses
+	std::string formatAsciiGridHeader(const AsciiGridHeader& header);
+
+	//! writes an ASCII grid block of rows by block of rows
+	class AsciiGridWriter
+	{
+	public:
+		AsciiGridWriter(const std::string& pathToFile, const AsciiGridHeader& header,
+										AsciiGridFormat format = AsciiGridFormat(3));
+		~AsciiGridWriter();
+
+		bool isOk() const { return _fp != NULL && _ok; }
+
+		//! append the rows of block (they have to follow the already written ones)
+		bool write(const AsciiGridRowBlock& block);
+
+		//! true if all rows have been written successfully
+		bool close();
+
+	private:
+		AsciiGridWriter(const AsciiGridWriter&);
+		AsciiGridWriter& operator=(const AsciiGridWriter&);
+
+		std::string _pathToFile;
+		AsciiGridHeader _header;
+		AsciiGridFormat _format;
+		FILE* _fp;
+		bool _ok;
+		std::size_t _rowsWritten;
+		std::string _buffer;
+	};
+}
+
+#endif
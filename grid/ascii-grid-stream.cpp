@@ -0,0 +1,203 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <iostream>
+#include <cmath>
+#include <cfloat>
+
+#include "ascii-grid-stream.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	//! report the error of a reader which couldn't be opened or stopped early
+	bool failed(const AsciiGridReader& r, const char* op)
+	{
+		if(r.isOk())
+			return false;
+		cerr << "error (" << op << "): " << r.error() << endl;
+		return true;
+	}
+}
+
+bool Grids::streamStat(const string& pathToFile, AsciiGridStat& st,
+											 size_t rowsPerBlock)
+{
+	AsciiGridReader in(pathToFile, rowsPerBlock);
+	if(failed(in, "stream_stat"))
+		return false;
+
+	int nodata = int(in.header().nodata);
+	st = AsciiGridStat();
+	st.min = FLT_MAX;
+	st.max = -FLT_MAX;
+	//Welford, one pass and numerically stable
+	double mean = 0, m2 = 0;
+	AsciiGridRowBlock b;
+	while(in.nextBlock(b))
+	{
+		for(size_t r = 0; r < b.rows; r++)
+		{
+			const float* row = b.row(r);
+			for(size_t c = 0; c < b.ncols; c++)
+			{
+				float v = row[c];
+				if(int(v) == nodata)
+				{
+					st.countNoData++;
+					continue;
+				}
+				st.countData++;
+				if(v < st.min)
+				{
+					st.min = v;
+					st.minRow = b.firstRow + r;
+					st.minCol = c;
+				}
+				if(v > st.max)
+				{
+					st.max = v;
+					st.maxRow = b.firstRow + r;
+					st.maxCol = c;
+				}
+				double d = v - mean;
+				mean += d/st.countData;
+				m2 += d*(v - mean);
+			}
+		}
+	}
+	if(failed(in, "stream_stat"))
+		return false;
+
+	st.mean = float(mean);
+	st.std = st.countData > 1 ? float(sqrt(m2/(st.countData - 1))) : 0.0f;
+	return true;
+}
+
+bool Grids::streamHist(const string& pathToFile, int bins, vector<int>& hist,
+											 size_t rowsPerBlock)
+{
+	if(bins < 1)
+		return false;
+	AsciiGridStat st;
+	if(!streamStat(pathToFile, st, rowsPerBlock))
+		return false;
+
+	AsciiGridReader in(pathToFile, rowsPerBlock);
+	if(failed(in, "stream_hist"))
+		return false;
+
+	int nodata = int(in.header().nodata);
+	float delta = st.max - st.min;
+	hist.assign(bins + 1, 0);
+	AsciiGridRowBlock b;
+	while(in.nextBlock(b))
+	{
+		for(float v : b.data)
+			if(int(v) != nodata)
+				hist[delta > 0 ? int(bins*(v - st.min)/delta) : 0]++;
+	}
+	return !failed(in, "stream_hist");
+}
+
+bool Grids::streamTransform(const string& pathToInFile, const string& pathToOutFile,
+														function<float(float)> f, AsciiGridFormat format,
+														size_t rowsPerBlock)
+{
+	AsciiGridReader in(pathToInFile, rowsPerBlock);
+	if(failed(in, "stream_transform"))
+		return false;
+
+	AsciiGridWriter out(pathToOutFile, in.header(), format);
+	int nodata = int(in.header().nodata);
+	AsciiGridRowBlock b;
+	while(out.isOk() && in.nextBlock(b))
+	{
+		for(float& v : b.data)
+			if(int(v) != nodata)
+				v = f(v);
+			else
+				v = float(nodata);
+		out.write(b);
+	}
+	return !failed(in, "stream_transform") && out.close();
+}
+
+bool Grids::streamCombine(const string& pathToInFile1, const string& pathToInFile2,
+													const string& pathToOutFile,
+													function<float(float, float)> f,
+													AsciiGridFormat format, size_t rowsPerBlock)
+{
+	AsciiGridReader in1(pathToInFile1, rowsPerBlock);
+	AsciiGridReader in2(pathToInFile2, rowsPerBlock);
+	if(failed(in1, "stream_combine") || failed(in2, "stream_combine"))
+		return false;
+
+	const AsciiGridHeader& h1 = in1.header();
+	const AsciiGridHeader& h2 = in2.header();
+	if(h1.ncols != h2.ncols || h1.nrows != h2.nrows)
+	{
+		cerr << "error (stream_combine): ncols=" << h1.ncols << " nrows=" << h1.nrows
+				 << " of " << pathToInFile1 << " differ from ncols=" << h2.ncols
+				 << " nrows=" << h2.nrows << " of " << pathToInFile2 << endl;
+		return false;
+	}
+
+	AsciiGridWriter out(pathToOutFile, h1, format);
+	int nodata1 = int(h1.nodata), nodata2 = int(h2.nodata);
+	AsciiGridRowBlock b1, b2;
+	while(out.isOk() && in1.nextBlock(b1) && in2.nextBlock(b2))
+	{
+		for(size_t i = 0, n = b1.data.size(); i < n; i++)
+		{
+			float v1 = b1.data[i], v2 = b2.data[i];
+			b1.data[i] = int(v1) != nodata1 && int(v2) != nodata2
+				? f(v1, v2) : float(nodata1);
+		}
+		out.write(b1);
+	}
+	return !failed(in1, "stream_combine") && !failed(in2, "stream_combine")
+		&& out.close();
+}
+
+bool Grids::streamCut(const string& pathToInFile, const string& pathToOutFile,
+											float val1, float val2, float val3, AsciiGridFormat format)
+{
+	return streamTransform(pathToInFile, pathToOutFile, [=](float v)
+	{
+		if(val3 < 0)
+			return v > val2 || v < val1 ? -1.0f : v;
+		return v >= val1 && v <= val2 ? val3 : 0.0f;
+	}, format);
+}
+
+bool Grids::streamClassGrid(const string& pathToInFile, const string& pathToOutFile,
+														float minx, float maxx, float step,
+														AsciiGridFormat format)
+{
+	if(step <= 0 || minx >= maxx)
+		return false;
+	return streamTransform(pathToInFile, pathToOutFile, [=](float v)
+	{
+		if(v <= minx)
+			return minx;
+		if(v >= maxx)
+			return maxx;
+		return int((v - minx)/step)*step + minx;
+	}, format);
+}
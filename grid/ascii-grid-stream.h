@@ -0,0 +1,82 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef ASCII_GRID_STREAM_H_
+#define ASCII_GRID_STREAM_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "ascii-grid-io.h"
+
+/*
+Operations on ASCII grid files which never hold more than a block of rows
+in memory, so they work for grids larger than the available RAM.
+They follow the semantics of the grid member functions of the same name,
+but read from and write to files.
+*/
+
+namespace Grids
+{
+	//! result of streamStat, see grid::stat
+	struct AsciiGridStat
+	{
+		AsciiGridStat()
+			: min(0), max(0), mean(0), std(0), countData(0), countNoData(0),
+				minRow(0), minCol(0), maxRow(0), maxCol(0) {}
+
+		float min, max, mean, std;
+		long countData, countNoData;
+		std::size_t minRow, minCol, maxRow, maxCol;
+	};
+
+	//! min, max, mean and (sample) standard deviation of the data fields
+	bool streamStat(const std::string& pathToFile, AsciiGridStat& stat,
+									std::size_t rowsPerBlock = 256);
+
+	//! histogram with bins+1 classes of width (max-min)/bins, see grid::hist
+	bool streamHist(const std::string& pathToFile, int bins, std::vector<int>& hist,
+									std::size_t rowsPerBlock = 256);
+
+	//! out = f(in) for all data fields, nodata stays nodata
+	bool streamTransform(const std::string& pathToInFile,
+											 const std::string& pathToOutFile,
+											 std::function<float(float)> f,
+											 AsciiGridFormat format = AsciiGridFormat(3),
+											 std::size_t rowsPerBlock = 256);
+
+	//! out = f(in1, in2), nodata if any of them is nodata, see grid::combine_grid
+	bool streamCombine(const std::string& pathToInFile1,
+										 const std::string& pathToInFile2,
+										 const std::string& pathToOutFile,
+										 std::function<float(float, float)> f,
+										 AsciiGridFormat format = AsciiGridFormat(3),
+										 std::size_t rowsPerBlock = 256);
+
+	//! see grid::cut
+	bool streamCut(const std::string& pathToInFile, const std::string& pathToOutFile,
+								 float val1, float val2, float val3,
+								 AsciiGridFormat format = AsciiGridFormat(3));
+
+	//! see grid::class_grid
+	bool streamClassGrid(const std::string& pathToInFile,
+											 const std::string& pathToOutFile,
+											 float minx, float maxx, float step,
+											 AsciiGridFormat format = AsciiGridFormat(3));
+}
+
+#endif
@@ -0,0 +1,337 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <iostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <climits>
+#include <limits>
+
+#include "binary-grid.h"
+#include "mapped-file.h"
+#include "grid.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	const char magic[8] = { 'U', 'T', 'I', 'L', 'G', 'R', 'I', 'D' };
+	const uint32_t currentVersion = 1;
+	const uint64_t dataOffset = 256;
+	const uint32_t byteOrderMark = 0x01020304;
+	const uint32_t swappedByteOrderMark = 0x04030201;
+
+	//the values are stored as they are in memory, byteOrder marks the order
+	static_assert(sizeof(BinaryGridHeader) == 256, "binary grid header has to be 256 bytes");
+
+	/*!
+	 * the nodata value stored for type T: nodata if T can hold it, else the
+	 * largest (unsigned) or smallest (signed) value of T
+	 */
+	template<typename T>
+	double storedNoData(int nodata)
+	{
+		typedef numeric_limits<T> L;
+		if(!L::is_integer || (nodata >= double(L::lowest()) && nodata <= double(L::max())))
+			return nodata;
+		return L::is_signed ? double(L::lowest()) : double(L::max());
+	}
+
+	/*!
+	 * no data cells become storedNoData, integral types are rounded and
+	 * clamped to the range of T without the stored no data value
+	 */
+	template<typename T>
+	void convertRow(const float* from, size_t n, char* to, int nodata)
+	{
+		typedef numeric_limits<T> L;
+		T* t = reinterpret_cast<T*>(to);
+		double nd = storedNoData<T>(nodata);
+		if(!L::is_integer)
+		{
+			for(size_t i = 0; i < n; i++)
+				t[i] = isNoDataValue(from[i], nodata) ? T(nd) : T(from[i]);
+			return;
+		}
+		double lo = double(L::lowest()), hi = double(L::max());
+		if(nd == lo)
+			lo++;
+		if(nd == hi)
+			hi--;
+		for(size_t i = 0; i < n; i++)
+		{
+			double v = floor(double(from[i]) + 0.5);
+			if(isNoDataValue(from[i], nodata))
+				v = nd;
+			else if(!(v >= lo))
+				v = lo;
+			else if(v > hi)
+				v = hi;
+			t[i] = T(v);
+		}
+	}
+
+	template<typename T>
+	void convertRow(const char* from, size_t n, float* to)
+	{
+		const T* f = reinterpret_cast<const T*>(from);
+		for(size_t i = 0; i < n; i++)
+			to[i] = float(f[i]);
+	}
+
+	bool isValid(const BinaryGridHeader& h, size_t fileSize, string& error)
+	{
+		size_t typeSize = binaryGridTypeSize(BinaryGridType(h.dataType));
+		//the header fields are untrusted, check them one at a time without
+		//ever multiplying them (which could wrap)
+		if(fileSize < sizeof(BinaryGridHeader))
+			error = "file too short";
+		else if(memcmp(h.magic, magic, sizeof(magic)) != 0)
+			error = "not a binary grid";
+		else if(h.byteOrder == swappedByteOrderMark)
+			error = "written with the other byte order";
+		else if(h.byteOrder != byteOrderMark)
+			error = "invalid byte order mark";
+		else if(h.version != currentVersion)
+			error = "unsupported version";
+		else if(typeSize == 0)
+			error = "unknown data type";
+		else if(h.dataOffset < sizeof(BinaryGridHeader) || h.dataOffset % 64 != 0
+						|| h.dataOffset > fileSize)
+			error = "invalid data offset";
+		else if(h.ncols > uint64_t(INT_MAX) || h.nrows > uint64_t(INT_MAX))
+			error = "grid too large";
+		else
+		{
+			uint64_t bytes = fileSize - h.dataOffset;
+			if(h.ncols > 0 && h.nrows > bytes / typeSize / h.ncols)
+				error = "file too short";
+			else
+				return true;
+		}
+		return false;
+	}
+
+	//! releases the mapping when the grid gives back its block
+	void deleteMappedFile(void* mf)
+	{
+		delete static_cast<MappedFile*>(mf);
+	}
+}
+
+size_t Grids::binaryGridTypeSize(BinaryGridType type)
+{
+	switch(type)
+	{
+	case eBinaryFloat32: return 4;
+	case eBinaryFloat64: return 8;
+	case eBinaryInt32: return 4;
+	case eBinaryInt16: return 2;
+	case eBinaryUInt8: return 1;
+	}
+	return 0;
+}
+
+void Grids::initBinaryGridHeader(BinaryGridHeader& h, BinaryGridType type)
+{
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, magic, sizeof(magic));
+	h.version = currentVersion;
+	h.dataType = type;
+	h.dataOffset = dataOffset;
+	h.byteOrder = byteOrderMark;
+}
+
+const char* Grids::binaryGridCells(const MappedFile& file, BinaryGridHeader& h,
+																	 string& error)
+{
+	if(!file.isOpen())
+	{
+		error = "can not open file";
+		return NULL;
+	}
+	if(file.size() >= sizeof(h))
+		memcpy(&h, file.data(), sizeof(h));
+	if(!isValid(h, file.size(), error))
+		return NULL;
+	return file.data() + h.dataOffset;
+}
+
+bool Grids::isBinaryGridFile(const string& pathToFile)
+{
+	char m[sizeof(magic)];
+	FILE* fp = fopen(pathToFile.c_str(), "rb");
+	if(!fp)
+		return false;
+	bool is = fread(m, 1, sizeof(m), fp) == sizeof(m) && memcmp(m, magic, sizeof(m)) == 0;
+	fclose(fp);
+	return is;
+}
+
+bool Grids::readBinaryGridHeader(const string& pathToFile, BinaryGridHeader& h,
+																 string* error)
+{
+	//mapping only touches the header page but gives the size for the checks
+	MappedFile file(pathToFile);
+	string e;
+	bool ok = binaryGridCells(file, h, e) != NULL;
+	if(error)
+		*error = e;
+	return ok;
+}
+
+namespace
+{
+	//! writes header and padding up to the data offset
+	FILE* createBinaryGrid(const string& pathToFile, const BinaryGridHeader& h)
+	{
+		FILE* fp = fopen(pathToFile.c_str(), "wb");
+		if(!fp)
+		{
+			cerr << "error (write_binary): can not open outputfile: " << pathToFile << endl;
+			return NULL;
+		}
+		vector<char> padding(size_t(h.dataOffset - sizeof(h)), 0);
+		if(fwrite(&h, sizeof(h), 1, fp) != 1
+			 || (!padding.empty() && fwrite(&padding[0], 1, padding.size(), fp) != padding.size()))
+		{
+			fclose(fp);
+			return NULL;
+		}
+		return fp;
+	}
+
+	bool finishBinaryGrid(const string& pathToFile, FILE* fp, bool ok)
+	{
+		if(fclose(fp) != 0)
+			ok = false;
+		if(!ok)
+			cerr << "error (write_binary): could not write: " << pathToFile << endl;
+		return ok;
+	}
+}
+
+bool Grids::writeBinaryGridData(const string& pathToFile, const BinaryGridHeader& h,
+																const void* cells)
+{
+	FILE* fp = createBinaryGrid(pathToFile, h);
+	if(!fp)
+		return false;
+	size_t bytes = size_t(h.ncols*h.nrows)*binaryGridTypeSize(BinaryGridType(h.dataType));
+	return finishBinaryGrid(pathToFile, fp, fwrite(cells, 1, bytes, fp) == bytes);
+}
+
+bool Grids::writeBinaryGrid(const string& pathToFile, const grid& g,
+														const string& coordinateSystemShort, BinaryGridType type)
+{
+	BinaryGridHeader h;
+	initBinaryGridHeader(h, type);
+	h.ncols = g.ncols;
+	h.nrows = g.nrows;
+	h.xllcorner = g.xcorner;
+	h.yllcorner = g.ycorner;
+	h.cellsize = g.csize;
+	switch(type)
+	{
+	case eBinaryInt16: h.nodata = storedNoData<int16_t>(g.nodata); break;
+	case eBinaryUInt8: h.nodata = storedNoData<uint8_t>(g.nodata); break;
+	default: h.nodata = g.nodata;
+	}
+	strncpy(h.coordinateSystem, coordinateSystemShort.c_str(), sizeof(h.coordinateSystem) - 1);
+
+	FILE* fp = createBinaryGrid(pathToFile, h);
+	if(!fp)
+		return false;
+
+	bool ok = true;
+	size_t rowBytes = g.ncols*binaryGridTypeSize(type);
+	vector<char> buf(type == eBinaryFloat32 ? 0 : rowBytes);
+	for(size_t i = 0; ok && i < g.nrows; i++)
+	{
+		const float* row = g.feld[i];
+		const char* out = reinterpret_cast<const char*>(row);
+		switch(type)
+		{
+		case eBinaryFloat32: break;
+		case eBinaryFloat64: convertRow<double>(row, g.ncols, &buf[0], g.nodata); out = &buf[0]; break;
+		case eBinaryInt32: convertRow<int32_t>(row, g.ncols, &buf[0], g.nodata); out = &buf[0]; break;
+		case eBinaryInt16: convertRow<int16_t>(row, g.ncols, &buf[0], g.nodata); out = &buf[0]; break;
+		case eBinaryUInt8: convertRow<uint8_t>(row, g.ncols, &buf[0], g.nodata); out = &buf[0]; break;
+		}
+		ok = fwrite(out, 1, rowBytes, fp) == rowBytes;
+	}
+	return finishBinaryGrid(pathToFile, fp, ok);
+}
+
+int Grids::readBinaryGrid(const string& pathToFile, grid& g, string* coordinateSystemShort)
+{
+	MappedFile* mf = new MappedFile(pathToFile, true);
+	if(!mf->isOpen())
+	{
+		cerr << "error (read_binary): can not open inputfile: " << pathToFile << endl;
+		delete mf;
+		return -1;
+	}
+
+	BinaryGridHeader h;
+	string error;
+	if(!binaryGridCells(*mf, h, error))
+	{
+		cerr << "error (read_binary): " << error << ": " << pathToFile << endl;
+		delete mf;
+		return -2;
+	}
+	g.release();
+	g.xcorner = h.xllcorner;
+	g.ycorner = h.yllcorner;
+	g.csize = float(h.cellsize);
+	g.nodata = int(h.nodata);
+	if(coordinateSystemShort)
+		*coordinateSystemShort = string(h.coordinateSystem,
+																		strnlen(h.coordinateSystem, sizeof(h.coordinateSystem)));
+
+	char* cells = mf->mutableData() + h.dataOffset;
+	if(h.dataType == eBinaryFloat32)
+	{
+		//the grid owns the mapping from now on
+		g.attach(reinterpret_cast<float*>(cells), h.nrows, h.ncols, &deleteMappedFile, mf);
+		return 0;
+	}
+
+	if(!g.allocate(h.nrows, h.ncols))
+	{
+		delete mf;
+		return -3;
+	}
+	size_t rowBytes = h.ncols*binaryGridTypeSize(BinaryGridType(h.dataType));
+	for(size_t i = 0; i < h.nrows; i++)
+	{
+		const char* row = cells + i*rowBytes;
+		switch(h.dataType)
+		{
+		case eBinaryFloat64: convertRow<double>(row, h.ncols, g.feld[i]); break;
+		case eBinaryInt32: convertRow<int32_t>(row, h.ncols, g.feld[i]); break;
+		case eBinaryInt16: convertRow<int16_t>(row, h.ncols, g.feld[i]); break;
+		case eBinaryUInt8: convertRow<uint8_t>(row, h.ncols, g.feld[i]); break;
+		}
+	}
+	delete mf;
+	return 0;
+}
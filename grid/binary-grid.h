@@ -0,0 +1,115 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef BINARY_GRID_H_
+#define BINARY_GRID_H_
+
+#include <string>
+#include <cstddef>
+#include <stdint.h>
+
+/*
+Native binary grid format: a fixed 256 byte header followed by the cells
+row major (top row first) as raw values in the byte order of the writing
+machine (marked in the header, files of the other byte order are rejected)
+starting at a 64 byte aligned offset. Float grids are not read but mapped (copy on write), so
+opening costs nothing and the cells are paged in when they are touched.
+*/
+
+namespace Grids
+{
+	class grid;
+
+	//! type of the stored cells
+	enum BinaryGridType
+	{
+		eBinaryFloat32 = 1,
+		eBinaryFloat64 = 2,
+		eBinaryInt32 = 3,
+		eBinaryInt16 = 4,
+		eBinaryUInt8 = 5
+	};
+
+	//! the fixed header at the start of a binary grid file
+	struct BinaryGridHeader
+	{
+		char magic[8];                //!< "UTILGRID"
+		uint32_t version;             //!< currently 1
+		uint32_t dataType;            //!< BinaryGridType
+		uint64_t ncols, nrows;
+		double xllcorner, yllcorner;
+		double cellsize;
+		double nodata;
+		uint64_t dataOffset;          //!< start of the cells in the file
+		char coordinateSystem[32];    //!< short name, e.g. gk5, 0 terminated
+		uint32_t byteOrder;           //!< 0x01020304 as written by the creating machine
+		char reserved[148];
+	};
+
+	class MappedFile;
+
+	//! bytes per cell of type, 0 for unknown types
+	std::size_t binaryGridTypeSize(BinaryGridType type);
+
+	//! zeroed header with magic, version, type and data offset set
+	void initBinaryGridHeader(BinaryGridHeader& header, BinaryGridType type);
+
+	/*!
+	 * check the header of an opened binary grid
+	 * @return the first cell or NULL (error describes why)
+	 */
+	const char* binaryGridCells(const MappedFile& file, BinaryGridHeader& header,
+															std::string& error);
+
+	/*!
+	 * write header (made by initBinaryGridHeader) and the row major cells,
+	 * which have to be of header.dataType
+	 */
+	bool writeBinaryGridData(const std::string& pathToFile,
+													 const BinaryGridHeader& header, const void* cells);
+
+	//! is the file a binary grid (checks the magic, not the name)
+	bool isBinaryGridFile(const std::string& pathToFile);
+
+	/*!
+	 * read and check the header of a binary grid file
+	 * @param error if not NULL receives why the header was rejected
+	 */
+	bool readBinaryGridHeader(const std::string& pathToFile, BinaryGridHeader& header,
+														std::string* error = NULL);
+
+	/*!
+	 * write g as binary grid
+	 * @param type cells are converted to type, integral types are rounded and
+	 * clamped to their range, no data cells get the header's nodata value:
+	 * g.nodata or, if type can't hold it, the largest (UInt8) or smallest
+	 * (Int16) value of type
+	 */
+	bool writeBinaryGrid(const std::string& pathToFile, const grid& g,
+											 const std::string& coordinateSystemShort = std::string(),
+											 BinaryGridType type = eBinaryFloat32);
+
+	/*!
+	 * open a binary grid into g, float grids are backed by the mapped file,
+	 * other types are converted into g's own storage
+	 * @param coordinateSystemShort if not NULL receives the stored coordinate system
+	 * @return 0 = ok, otherwise the codes of grid::read_ascii
+	 */
+	int readBinaryGrid(const std::string& pathToFile, grid& g,
+										 std::string* coordinateSystemShort = NULL);
+}
+
+#endif
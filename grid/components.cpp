@@ -0,0 +1,221 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <algorithm>
+
+#include "components.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	//! rows labelled at once before the bands are merged
+	const int componentBandRows = 256;
+
+	//! the parent of a cell is never behind it, so the root is the first cell
+	int findRoot(vector<int>& parent, int i)
+	{
+		while(parent[i] != i)
+		{
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	}
+
+	void unite(vector<int>& parent, int a, int b)
+	{
+		a = findRoot(parent, a);
+		b = findRoot(parent, b);
+		if(a < b)
+			parent[b] = a;
+		else if(b < a)
+			parent[a] = b;
+	}
+
+	template<class F>
+	void forEachIndex(size_t n, Tools::ExecutionPolicy policy, F f)
+	{
+		if(Tools::isParallel(policy))
+			Tools::defaultThreadPool().parallelFor(n, f);
+		else
+			for(size_t i = 0; i < n; i++)
+				f(i);
+	}
+
+	grid* labelGrid(const grid& g, const vector<unsigned char>& mask, const float* const* values,
+									ComponentConnectivity connectivity, vector<Component>* components,
+									Tools::ExecutionPolicy policy)
+	{
+		vector<int> labels;
+		labelComponents(g.nrows, g.ncols, mask, values, connectivity, labels, components, policy);
+		grid* gx = gridLike(g);
+		forEachIndex(g.nrows, policy, [&](size_t r)
+		{
+			for(size_t c = 0; c < g.ncols; c++)
+				gx->feld[r][c] = isNoDataValue(g.feld[r][c], g.nodata)
+												 ? float(g.nodata) : float(labels[r*g.ncols + c]);
+		});
+		return gx;
+	}
+}
+
+int Grids::labelComponents(size_t rows, size_t cols, const vector<unsigned char>& mask,
+													 const float* const* values, ComponentConnectivity connectivity,
+													 vector<int>& labels, vector<Component>* components,
+													 Tools::ExecutionPolicy policy)
+{
+	int nr = int(rows), nc = int(cols);
+	vector<int> parent(rows*cols, -1);
+	auto link = [&](int r, int c, int r2, int c2)
+	{
+		int a = r*nc + c, b = r2*nc + c2;
+		if(mask[b] && (!values || values[r][c] == values[r2][c2]))
+			unite(parent, a, b);
+	};
+	//the neighbours of (r, c) labelled before it, with or without the row above
+	auto linkBack = [&](int r, int c, bool above)
+	{
+		if(c > 0)
+			link(r, c, r, c - 1);
+		if(!above)
+			return;
+		link(r, c, r - 1, c);
+		if(connectivity == eConnect8)
+		{
+			if(c > 0)
+				link(r, c, r - 1, c - 1);
+			if(c + 1 < nc)
+				link(r, c, r - 1, c + 1);
+		}
+	};
+
+	//1. label the bands independently
+	int bandRows = Tools::isParallel(policy) ? componentBandRows : max(nr, 1);
+	int bands = (nr + bandRows - 1) / bandRows;
+	auto labelBand = [&](size_t b)
+	{
+		int r0 = int(b)*bandRows, r1 = min(r0 + bandRows, nr);
+		for(int r = r0; r < r1; r++)
+			for(int c = 0; c < nc; c++)
+			{
+				int i = r*nc + c;
+				if(!mask[i])
+					continue;
+				parent[i] = i;
+				linkBack(r, c, r > r0);
+			}
+	};
+	forEachIndex(size_t(bands), policy, labelBand);
+
+	//2. merge neighbouring groups of bands along their border, all union-find
+	//paths stay within a group, so the merges of one round are independent
+	for(int step = 1; step < bands; step *= 2)
+	{
+		size_t merges = size_t((bands + 2*step - 1) / (2*step));
+		Tools::defaultThreadPool().parallelFor(merges, [&](size_t m)
+		{
+			int b = int(m)*2*step + step;
+			if(b >= bands)
+				return;
+			int r = b*bandRows;
+			for(int c = 0; c < nc; c++)
+				if(mask[r*nc + c])
+				{
+					link(r, c, r - 1, c);
+					if(connectivity == eConnect8)
+					{
+						if(c > 0)
+							link(r, c, r - 1, c - 1);
+						if(c + 1 < nc)
+							link(r, c, r - 1, c + 1);
+					}
+				}
+		});
+	}
+
+	//3. number the roots in row major order, the parent of a cell comes
+	//before it and is done already
+	labels.assign(rows*cols, 0);
+	if(components)
+		components->clear();
+	int count = 0;
+	for(int r = 0; r < nr; r++)
+		for(int c = 0; c < nc; c++)
+		{
+			int i = r*nc + c;
+			if(!mask[i])
+				continue;
+			int p = parent[i];
+			if(p == i)
+			{
+				labels[i] = ++count;
+				if(components)
+				{
+					Component component;
+					component.row = component.minRow = component.maxRow = r;
+					component.col = component.minCol = component.maxCol = c;
+					components->push_back(component);
+				}
+			}
+			else
+			{
+				p = parent[i] = parent[p];
+				labels[i] = labels[p];
+			}
+			if(components)
+			{
+				Component& component = (*components)[labels[i] - 1];
+				component.area++;
+				component.minRow = min(component.minRow, r);
+				component.maxRow = max(component.maxRow, r);
+				component.minCol = min(component.minCol, c);
+				component.maxCol = max(component.maxCol, c);
+			}
+		}
+	return count;
+}
+
+grid* Grids::labelPatches(const grid& g, ComponentConnectivity connectivity,
+													vector<Component>* components, Tools::ExecutionPolicy policy)
+{
+	vector<unsigned char> mask(g.nrows*g.ncols);
+	forEachIndex(g.nrows, policy, [&](size_t r)
+	{
+		for(size_t c = 0; c < g.ncols; c++)
+			mask[r*g.ncols + c] = !isNoDataValue(g.feld[r][c], g.nodata);
+	});
+	return labelGrid(g, mask, g.feld, connectivity, components, policy);
+}
+
+grid* Grids::labelRegions(const grid& g, float lower, float upper,
+													ComponentConnectivity connectivity,
+													vector<Component>* components, Tools::ExecutionPolicy policy)
+{
+	vector<unsigned char> mask(g.nrows*g.ncols);
+	forEachIndex(g.nrows, policy, [&](size_t r)
+	{
+		for(size_t c = 0; c < g.ncols; c++)
+		{
+			float v = g.feld[r][c];
+			mask[r*g.ncols + c] = !isNoDataValue(v, g.nodata) && v >= lower && v <= upper;
+		}
+	});
+	return labelGrid(g, mask, NULL, connectivity, components, policy);
+}
@@ -0,0 +1,90 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef COMPONENTS_H_
+#define COMPONENTS_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "grid.h"
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	enum ComponentConnectivity
+	{
+		//! E, S, W, N neighbours
+		eConnect4 = 4,
+		//! the diagonal neighbours too
+		eConnect8 = 8
+	};
+
+	//! size and extent of a connected component
+	struct Component
+	{
+		Component()
+			: area(0), row(0), col(0), minRow(0), minCol(0), maxRow(0), maxCol(0) {}
+
+		//! number of cells
+		std::size_t area;
+		//! first cell (row major), where the component's label starts
+		int row, col;
+		//! bounding box, inclusive
+		int minRow, minCol, maxRow, maxCol;
+	};
+
+	/*!
+	 * label all connected components in one sweep (two pass union-find):
+	 * neighbouring cells belong together if both are set in mask and, if
+	 * values is given, have equal values; with a parallel policy bands of
+	 * rows are labelled on the library thread pool and merged pairwise along
+	 * their borders
+	 * @param mask row major rows*cols, != 0 for the cells to label
+	 * @param values NULL or row pointers (e.g. grid::feld)
+	 * @param labels row major, 0 outside mask, the components are numbered
+	 * 1.. in the row major order of their first cell
+	 * @param components if not NULL, components[l - 1] describes label l
+	 * @return number of components
+	 */
+	int labelComponents(std::size_t rows, std::size_t cols,
+											const std::vector<unsigned char>& mask,
+											const float* const* values,
+											ComponentConnectivity connectivity,
+											std::vector<int>& labels,
+											std::vector<Component>* components = NULL,
+											Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * label the patches of equal value of g (e.g. the fields of a land use
+	 * map), no data where g has no data
+	 */
+	grid* labelPatches(const grid& g, ComponentConnectivity connectivity = eConnect8,
+										 std::vector<Component>* components = NULL,
+										 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * label the connected regions of cells with lower <= value <= upper,
+	 * 0 for the other cells, no data where g has no data
+	 */
+	grid* labelRegions(const grid& g, float lower, float upper,
+										 ComponentConnectivity connectivity = eConnect8,
+										 std::vector<Component>* components = NULL,
+										 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+}
+
+#endif
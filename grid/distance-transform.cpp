@@ -0,0 +1,142 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <limits>
+#include <algorithm>
+
+#include "distance-transform.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	//! columns swept together in the first pass, so the rows are read in cache lines
+	const size_t columnBlock = 64;
+
+	template<class F>
+	void forEach(size_t n, Tools::ExecutionPolicy policy, F f)
+	{
+		if(Tools::isParallel(policy))
+			Tools::defaultThreadPool().parallelFor(n, f);
+		else
+			for(size_t i = 0; i < n; i++)
+				f(i);
+	}
+}
+
+void Grids::squaredDistanceTransform(size_t rows, size_t cols,
+																		 const vector<unsigned char>& isSource,
+																		 vector<double>& dist2,
+																		 vector<ptrdiff_t>* nearest,
+																		 Tools::ExecutionPolicy policy)
+{
+	const double inf = numeric_limits<double>::infinity();
+	dist2.assign(rows*cols, inf);
+	if(nearest)
+		nearest->assign(rows*cols, -1);
+	if(rows == 0 || cols == 0)
+		return;
+
+	//1. pass: distance to the nearest source in the same column (and its row)
+	forEach((cols + columnBlock - 1) / columnBlock, policy, [&](size_t b)
+	{
+		size_t c0 = b*columnBlock, c1 = min(cols, c0 + columnBlock);
+		for(size_t r = 0; r < rows; r++)
+		{
+			for(size_t c = c0; c < c1; c++)
+			{
+				size_t i = r*cols + c;
+				if(isSource[i])
+				{
+					dist2[i] = 0;
+					if(nearest)
+						(*nearest)[i] = ptrdiff_t(r);
+				}
+				else if(r > 0 && dist2[i - cols] < inf)
+				{
+					dist2[i] = dist2[i - cols] + 1;
+					if(nearest)
+						(*nearest)[i] = (*nearest)[i - cols];
+				}
+			}
+		}
+		for(size_t r = rows - 1; r-- > 0; )
+		{
+			for(size_t c = c0; c < c1; c++)
+			{
+				size_t i = r*cols + c;
+				if(dist2[i + cols] + 1 < dist2[i])
+				{
+					dist2[i] = dist2[i + cols] + 1;
+					if(nearest)
+						(*nearest)[i] = (*nearest)[i + cols];
+				}
+			}
+		}
+	});
+
+	//2. pass: lower envelope of the parabolas of every row
+	forEach(rows, policy, [&](size_t r)
+	{
+		double* d = &dist2[r*cols];
+		ptrdiff_t* n = nearest ? &(*nearest)[r*cols] : NULL;
+		vector<double> f(cols);
+		vector<ptrdiff_t> sourceRow;
+		vector<size_t> v(cols);
+		vector<double> z(cols + 1);
+		for(size_t q = 0; q < cols; q++)
+			f[q] = d[q]*d[q];
+		if(n)
+			sourceRow.assign(n, n + cols);
+
+		//parabolas with their vertex at v[0..k], parabola v[j] is lowest in [z[j], z[j+1]]
+		ptrdiff_t k = -1;
+		for(size_t q = 0; q < cols; q++)
+		{
+			if(f[q] == inf)
+				continue;
+			double s = -inf;
+			while(k >= 0)
+			{
+				double p = double(v[k]);
+				s = ((f[q] + double(q)*q) - (f[v[k]] + p*p)) / (2*(double(q) - p));
+				if(s > z[k])
+					break;
+				k--;
+				s = -inf;
+			}
+			k++;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = inf;
+		}
+		if(k < 0)
+			return;
+
+		k = 0;
+		for(size_t q = 0; q < cols; q++)
+		{
+			while(z[k + 1] < double(q))
+				k++;
+			double dq = double(q) - double(v[k]);
+			d[q] = dq*dq + f[v[k]];
+			if(n)
+				n[q] = sourceRow[v[k]]*ptrdiff_t(cols) + ptrdiff_t(v[k]);
+		}
+	});
+}
@@ -0,0 +1,47 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef DISTANCE_TRANSFORM_H_
+#define DISTANCE_TRANSFORM_H_
+
+#include <vector>
+#include <cstddef>
+
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	/*!
+	 * exact squared euclidean distance transform in O(rows*cols)
+	 * (Felzenszwalb/Huttenlocher, Meijster): first the distance to the nearest
+	 * source in every column, then per row the lower envelope of the parabolas
+	 * (c - q)^2 + g(q)^2, columns and rows run on the library thread pool
+	 * unless policy is sequential
+	 * @param isSource row major rows*cols, != 0 for the source cells
+	 * @param dist2 squared distance in cells to the nearest source,
+	 * infinity if there is no source at all
+	 * @param nearest if not NULL the row major index of the nearest source
+	 * (-1 if there is none)
+	 */
+	void squaredDistanceTransform(std::size_t rows, std::size_t cols,
+																const std::vector<unsigned char>& isSource,
+																std::vector<double>& dist2,
+																std::vector<std::ptrdiff_t>* nearest = NULL,
+																Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+}
+
+#endif
@@ -35,6 +35,11 @@ hdf5::hdf5()
 	size=0;
 	i1 = (int*)NULL;
 	f1 = (float*)NULL;
+	file = -1;
+	dataset = -1;
+	chunk_rows = 256;
+	chunk_cols = 256;
+	deflate = 4;
 }
 
 hdf5::~hdf5()
@@ -101,50 +106,66 @@ list<string> hdf5::allDatasetNames(const char* fileName){
 	return dsns;
 }
 
-void hdf5::write_i_feld(const char* name, int* feld,int nx,int ny)
+void hdf5::set_chunking(int rows, int cols, int level)
 {
-	//int *f1;
-	hid_t dataspace, datatype;
-	herr_t status;
-	hsize_t dims[1];
+	chunk_rows = rows;
+	chunk_cols = cols;
+	deflate = level;
+}
 
-	dims[0]=nx*ny;
-	dataspace=H5Screate_simple(1,dims,NULL);
-	datatype=H5Tcopy(H5T_NATIVE_INT);
-	status=H5Tset_order(datatype,H5T_ORDER_LE);
-	dataset=H5Dcreate(file,name,datatype,dataspace,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
-	status=H5Dwrite(dataset
-	                ,H5T_NATIVE_INT,H5S_ALL,H5S_ALL
-	                ,H5P_DEFAULT,feld);
-	H5Sclose(dataspace);
-	H5Tclose(datatype);
+// creation properties of a 2-D dataset nx*ny: chunked with shuffle and
+// deflate if enabled and available, otherwise contiguous (H5P_DEFAULT)
+hid_t hdf5::create_plist(int nx, int ny)
+{
+	if(chunk_rows<=0 || chunk_cols<=0 || nx<=0 || ny<=0)
+		return H5P_DEFAULT;
+	hsize_t chunk[2];
+	chunk[0] = chunk_rows<nx ? chunk_rows : nx;
+	chunk[1] = chunk_cols<ny ? chunk_cols : ny;
+	hid_t plist = H5Pcreate(H5P_DATASET_CREATE);
+	H5Pset_chunk(plist, 2, chunk);
+	if(deflate>0 && H5Zfilter_avail(H5Z_FILTER_DEFLATE)>0){
+		H5Pset_shuffle(plist);
+		H5Pset_deflate(plist, deflate>9 ? 9 : deflate);
+	}
+	return plist;
 }
 
-void hdf5::write_f_feld(const char* name, float* feld,int nx,int ny)
+void hdf5::write_feld(const char* name, hid_t memtype, const void* feld, int nx, int ny)
 {
-	//float *f1;
-	hid_t dataspace, datatype;
+	hid_t dataspace, datatype, plist;
 	herr_t status;
-	hsize_t dims[1];
+	hsize_t dims[2];
 
-	dims[0]=nx*ny;
-	dataspace=H5Screate_simple(1,dims,NULL);
-	datatype=H5Tcopy(H5T_NATIVE_FLOAT);
+	dims[0]=nx;
+	dims[1]=ny;
+	dataspace=H5Screate_simple(2,dims,NULL);
+	datatype=H5Tcopy(memtype);
 	status=H5Tset_order(datatype,H5T_ORDER_LE);
-	dataset=H5Dcreate(file,name,datatype,dataspace,H5P_DEFAULT,H5P_DEFAULT,H5P_DEFAULT);
+	plist=create_plist(nx,ny);
+	dataset=H5Dcreate(file,name,datatype,dataspace,H5P_DEFAULT,plist,H5P_DEFAULT);
 	status=H5Dwrite(dataset
-	                ,H5T_NATIVE_FLOAT,H5S_ALL,H5S_ALL
+	                ,memtype,H5S_ALL,H5S_ALL
 	                ,H5P_DEFAULT,feld);
+	if(plist!=H5P_DEFAULT) H5Pclose(plist);
 	H5Sclose(dataspace);
 	H5Tclose(datatype);
 }
 
+void hdf5::write_i_feld(const char* name, int* feld,int nx,int ny)
+{
+	write_feld(name,H5T_NATIVE_INT,feld,nx,ny);
+}
+
+void hdf5::write_f_feld(const char* name, float* feld,int nx,int ny)
+{
+	write_feld(name,H5T_NATIVE_FLOAT,feld,nx,ny);
+}
+
 int* hdf5::read_i_feld(const char* name)
 {
 	hid_t dataspace;//, datatype;
-	int rank;
-	herr_t status;
-	hsize_t dims[1];
+	hssize_t npoints;
 	herr_t  ret;
 
 	if((dataset = H5Dopen(file, name,H5P_DEFAULT))<0){
@@ -152,15 +173,14 @@ int* hdf5::read_i_feld(const char* name)
 		exit(2);
 	}
 	dataspace = H5Dget_space(dataset);    /* dataspace handle */
-	rank      = H5Sget_simple_extent_ndims(dataspace);
-	status    = H5Sget_simple_extent_dims(dataspace, dims, NULL);
+	npoints   = H5Sget_simple_extent_npoints(dataspace); // 1-D or 2-D
 
-	i1=(int*) malloc(dims[0]*sizeof(int));
+	i1=(int*) malloc(npoints*sizeof(int));
 	if(i1==NULL){
 		fprintf(stderr,"not space on device\n");
 		exit(2);
 	}
-	size=dims[0];
+	size=npoints;
 	ret = H5Dread(dataset, H5T_NATIVE_INT, H5S_ALL, H5S_ALL,
 	              H5P_DEFAULT, i1);
 	H5Sclose(dataspace);
@@ -170,9 +190,7 @@ int* hdf5::read_i_feld(const char* name)
 float* hdf5::read_f_feld(const char* name)
 {
 	hid_t dataspace;//, datatype;
-	int rank;
-	herr_t status;
-	hsize_t dims[1];
+	hssize_t npoints;
 	herr_t  ret;
 
 	if((dataset = H5Dopen(file, name,H5P_DEFAULT))<0){
@@ -180,21 +198,104 @@ float* hdf5::read_f_feld(const char* name)
 		exit(2);
 	}
 	dataspace = H5Dget_space(dataset);    /* dataspace handle */
-	rank      = H5Sget_simple_extent_ndims(dataspace);
-	status    = H5Sget_simple_extent_dims(dataspace, dims, NULL);
-  //cerr << "read_dims: " << dims[0] << endl;
-	f1=(float*) malloc(dims[0]*sizeof(float));
+	npoints   = H5Sget_simple_extent_npoints(dataspace); // 1-D or 2-D
+	f1=(float*) malloc(npoints*sizeof(float));
 	if(f1==NULL){
 		fprintf(stderr,"not space on device\n");
 		exit(2);
 	}
-	size=dims[0];
+	size=npoints;
 	ret = H5Dread(dataset, H5T_NATIVE_FLOAT, H5S_ALL, H5S_ALL,
 	              H5P_DEFAULT, f1);
 	H5Sclose(dataspace);
 	return f1;
 }
 
+// reads the dataset directly into a caller owned buffer of n floats,
+// the dataset may be stored 1-D (nx*ny) or 2-D (nrows x ncols)
+// returns 0: ok, 1: no dataset, 2: size mismatch, 3: read error
+int hdf5::read_f_feld(const char* name, float* target, size_t n)
+{
+	return read_feld(name,H5T_NATIVE_FLOAT,target,n);
+}
+
+// like read_f_feld, but into n values of memtype, hdf converts
+// from the stored type
+int hdf5::read_feld(const char* name, hid_t memtype, void* target, size_t n)
+{
+	hid_t dataspace, memspace;
+	hsize_t dims[2];
+	herr_t ret;
+
+	if(dataset>=0) H5Dclose(dataset);
+	if((dataset = H5Dopen(file, name,H5P_DEFAULT))<0){
+		fprintf(stderr,"No Dataset : %s\n",name);
+		return 1;
+	}
+	dataspace = H5Dget_space(dataset);
+	if((size_t)H5Sget_simple_extent_npoints(dataspace)!=n){
+		fprintf(stderr,"Dataset %s: size does not match grid\n",name);
+		H5Sclose(dataspace);
+		return 2;
+	}
+	dims[0]=n;
+	memspace=H5Screate_simple(1,dims,NULL);
+	ret = H5Dread(dataset, memtype, memspace, dataspace,
+	              H5P_DEFAULT, target);
+	H5Sclose(memspace);
+	H5Sclose(dataspace);
+	size=n;
+	return ret<0 ? 3 : 0;
+}
+
+// reads only the window [top,top+rows)x[left,left+cols) of a grid with
+// ncols columns into target (rows*cols floats, row-major),
+// works for 2-D datasets as well as for old 1-D (nx*ny) ones
+int hdf5::read_f_feld(const char* name, float* target, size_t top, size_t left,
+                      size_t rows, size_t cols, size_t ncols)
+{
+	hid_t dataspace, memspace;
+	hsize_t start[2], stride[2], count[2], block[2], dims[2];
+	herr_t ret;
+
+	if(dataset>=0) H5Dclose(dataset);
+	if((dataset = H5Dopen(file, name,H5P_DEFAULT))<0){
+		fprintf(stderr,"No Dataset : %s\n",name);
+		return 1;
+	}
+	dataspace = H5Dget_space(dataset);
+	int rank = H5Sget_simple_extent_ndims(dataspace);
+	H5Sget_simple_extent_dims(dataspace, dims, NULL);
+	if((rank==2 && (top+rows>dims[0] || left+cols>dims[1] || dims[1]!=ncols))
+	   || (rank==1 && (top+rows)*ncols>dims[0]) || left+cols>ncols
+	   || rank<1 || rank>2){
+		fprintf(stderr,"Dataset %s: window outside of grid\n",name);
+		H5Sclose(dataspace);
+		return 2;
+	}
+	if(rank==2){
+		start[0]=top; start[1]=left;
+		count[0]=rows; count[1]=cols;
+		ret = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, NULL, count, NULL);
+	}
+	else{ // one block of cols values every ncols values
+		start[0]=top*ncols+left;
+		stride[0]=ncols;
+		count[0]=rows;
+		block[0]=cols;
+		ret = H5Sselect_hyperslab(dataspace, H5S_SELECT_SET, start, stride, count, block);
+	}
+	dims[0]=rows*cols;
+	memspace=H5Screate_simple(1,dims,NULL);
+	if(ret>=0)
+		ret = H5Dread(dataset, H5T_NATIVE_FLOAT, memspace, dataspace,
+		              H5P_DEFAULT, target);
+	H5Sclose(memspace);
+	H5Sclose(dataspace);
+	size=rows*cols;
+	return ret<0 ? 3 : 0;
+}
+
 int hdf5::write_i_attribute(const char* name, int val)
 {
 	hid_t aid1,attr1;
@@ -30,6 +30,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #endif
 
 #include "grid+.h"
+#include "binary-grid.h"
 #include "tools/algorithms.h"
 #include "tools/helper.h"
 
@@ -363,6 +364,24 @@ pair<Row, Col> Grids::rowColInGrid(const GridMetaData& gmd, const RectCoord& c)
 	return make_pair(indexH, indexR);
 }
 
+SubData Grids::subDataInGrid(const GridMetaData& gmd, const RCRect& r)
+{
+  auto rc2rowCol = [&](const RectCoord& rc)
+  {
+    int col = int(std::floor((rc.r - gmd.xllcorner)/gmd.cellsize));
+    if(col == gmd.ncols)
+      --col;
+    int row = gmd.nrows - int(std::ceil((rc.h - gmd.yllcorner)/gmd.cellsize));
+    if(row == gmd.nrows)
+      --row;
+    return make_pair(row, col);
+  };
+
+  auto tl = rc2rowCol(r.tl);
+  auto br = rc2rowCol(r.br);
+  return SubData(tl.first, tl.second, br.first - tl.first, br.second - tl.second);
+}
+
 //------------------------------------------------------------------------------
 
 GridP::GridP(CoordinateSystem cs)
@@ -417,6 +436,14 @@ GridP::GridP(const string& datasetName, FileType ft, const string& pathToFile,
     _grid = GridPtr(new grid(100));
     _grid->read_ascii((char*)pathToFile.c_str());
     break;
+  case BINARY:
+  {
+    _grid = GridPtr(new grid(100));
+    string cs;
+    if(readBinaryGrid(pathToFile, *_grid, &cs) == 0 && !cs.empty())
+      _coordinateSystem = Tools::shortStringToCoordinateSystem(cs);
+    break;
+  }
 	}
 }
 
@@ -427,11 +454,25 @@ GridP::GridP(grid* wrapThisGrid, CoordinateSystem cs)
 
 //! copy constructor
 GridP::GridP(const GridP& other)
-  : _grid(GridPtr(other._grid->grid_copy())),
+  : _grid(other._grid),
   _datasetName(other._datasetName),
   _descriptiveLabel(other._descriptiveLabel),
 	_unit(other._unit),
-	_coordinateSystem(other._coordinateSystem)
+	_coordinateSystem(other._coordinateSystem),
+	_shared(true)
+{
+	other._shared = true;
+}
+
+GridP::GridP(GridP&& other)
+	: _grid(std::move(other._grid)),
+		_datasetName(std::move(other._datasetName)),
+		_descriptiveLabel(std::move(other._descriptiveLabel)),
+		_unit(std::move(other._unit)),
+		_displayValueTransformFunction(std::move(other._displayValueTransformFunction)),
+		_coordinateSystem(other._coordinateSystem),
+		_noDataMask(std::move(other._noDataMask)),
+		_shared(other._shared.load())
 {
 }
 
@@ -448,21 +489,76 @@ GridP::GridP(grid const *const other, CoordinateSystem cs)
 { }
 
 GridP& GridP::operator=(const GridP& other)
-                       {
-	_grid = GridPtr(other._grid->grid_copy());
+{
+	_grid = other._grid;
+	other._shared = true;
+	_shared = true;
 	_datasetName = other._datasetName;
 	_descriptiveLabel = other._descriptiveLabel;
   _unit = other._unit;
 	_coordinateSystem = other._coordinateSystem;
+	invalidateNoDataMask();
+	return *this;
+}
+
+GridP& GridP::operator=(GridP&& other)
+{
+	_grid = std::move(other._grid);
+	_datasetName = std::move(other._datasetName);
+	_descriptiveLabel = std::move(other._descriptiveLabel);
+	_unit = std::move(other._unit);
+	_displayValueTransformFunction = std::move(other._displayValueTransformFunction);
+	_coordinateSystem = other._coordinateSystem;
+	_noDataMask = std::move(other._noDataMask);
+	_shared = other._shared.load();
 	return *this;
 }
 
 GridP& GridP::operator=(const grid& other)
 {
 	_grid = GridPtr(const_cast<grid*>(&other)->grid_copy());
+	_shared = false;
+	invalidateNoDataMask();
 	return *this;
 }
 
+void GridP::keepNoDataMask(bool keep)
+{
+	if(!keep)
+		_noDataMask.reset();
+	else if(!_noDataMask)
+		_noDataMask = std::make_shared<NoDataMask>();
+}
+
+std::shared_ptr<const NoDataMask> GridP::noDataMask(ExecutionPolicy policy) const
+{
+	bool keep;
+	{
+		std::lock_guard<std::mutex> lock(_noDataMaskMutex);
+		keep = bool(_noDataMask);
+		if(keep && _noDataMask->rows() == rows() && _noDataMask->cols() == cols())
+			return _noDataMask;
+	}
+
+	//built outside the lock, the pool may run other work on this thread meanwhile
+	std::shared_ptr<NoDataMask> mask = std::make_shared<NoDataMask>(rows(), cols());
+	int nd = noDataValue();
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+			noDataMaskBits(_grid->feld[r], cs, nd, mask->row(r));
+	});
+	if(keep)
+	{
+		//a handed out mask is never changed here, the kept one is replaced
+		std::lock_guard<std::mutex> lock(_noDataMaskMutex);
+		if(_noDataMask)
+			_noDataMask = mask;
+	}
+	return mask;
+}
+
 bool GridP::operator==(const GridP& other) const
 {
 	if(descriptiveLabel() != other.descriptiveLabel())
@@ -483,24 +579,29 @@ bool GridP::operator==(const GridP& other) const
 }
 
 #ifndef NO_HDF5
-int GridP::readHdf(const string& pathToHdfFile, const string& datasetName)
+int GridP::readHdf(const string& pathToHdfFile, const string& datasetName,
+                   const SubData& window)
 {
   hdf5* hd = new hdf5;
   if(hd->open_f(pathToHdfFile.c_str())!=0){
     cerr << "error (read_hdf): can not open hdf_file: " << pathToHdfFile << endl;
+    delete hd;
     return -1;
   }
   if(hd->open_d(datasetName.c_str())!=0){
     cerr << "error (read_hdf): can not open dataset: " << datasetName << endl;
+    delete hd;
     return -2;
   }
-  if(_grid->feld!=(float**)NULL){
-    for(int i=0; i<_grid->nrows; i++){
-      delete[] _grid->feld[i];
-    }
+  if(_shared)
+  {
+    _grid = GridPtr(new grid(100)); //replaced anyway, leave the shared cells alone
+    _shared = false;
   }
-  _grid->ncols=hd->get_i_attribute("ncols");
-  _grid->nrows=hd->get_i_attribute("nrows");
+  _grid->release();
+  invalidateNoDataMask();
+  size_t ncols = hd->get_i_attribute("ncols");
+  size_t nrows = hd->get_i_attribute("nrows");
   _grid->nodata=hd->get_i_attribute("nodata");
   _grid->xcorner=hd->get_d_attribute("xllcorner");
   _grid->ycorner=hd->get_d_attribute("yllcorner");
@@ -509,22 +610,33 @@ int GridP::readHdf(const string& pathToHdfFile, const string& datasetName)
   _coordinateSystem = Tools::shortStringToCoordinateSystem(string(cs));
   free(cs);
   //cerr << ncols << " " << nrows << " " << csize << endl;
-  hd->read_f_feld(datasetName.c_str()); // writes to f1 in grid
-  int nrows = _grid->nrows;
-  int ncols = _grid->ncols;
-  _grid->feld = new float*[nrows];
-  for(int i=0; i<nrows; i++){
-    if((_grid->feld[i]=new float[ncols])==NULL){
-      cerr << "error (read_hdf): no sufficient memory" << endl;
-    }
+
+  //only the window, the corners move to the window's lower left corner
+  SubData w = window.isValid() ? window : SubData(0, 0, nrows, ncols);
+  if(window.isValid())
+  {
+    _grid->xcorner += w.col*_grid->csize;
+    _grid->ycorner += (nrows - w.row - w.rows)*_grid->csize;
   }
-  // read_in
-  for(size_t i=0; i<nrows; i++){
-    for(size_t j=0; j<ncols; j++){
-      _grid->feld[i][j]=hd->f1[i*ncols+j];
-    }
+
+  if(!_grid->allocate(w.rows, w.cols)){
+    cerr << "error (read_hdf): no sufficient memory" << endl;
+    delete hd;
+    return -3;
   }
+  // read_in, directly into the grid block
+  int err = 0;
+  if(window.isValid())
+    err = hd->read_f_feld(datasetName.c_str(), _grid->data(),
+                          w.row, w.col, w.rows, w.cols, ncols);
+  else if(nrows*ncols > 0)
+    err = hd->read_f_feld(datasetName.c_str(), _grid->data(), nrows*ncols);
   delete hd;
+  if(err != 0){
+    cerr << "error (read_hdf): can not read dataset: " << datasetName
+         << (window.isValid() ? " window: " + w.toString() : string()) << endl;
+    return -2;
+  }
   return 0;
 }
 
@@ -537,25 +649,15 @@ bool GridP::writeHdf(const string& pathToHdfFile, const string& datasetName,
 
   size_t ncols = _grid->ncols;
   size_t nrows = _grid->nrows;
-	float** feld = _grid->feld;
 
   //cerr << "hdf " << fname << " " << datasetn << endl;
-	float* f1 = new float[nrows * ncols];
-  if(f1 == NULL)
-  {
-		cerr << "error (write_hdf): no space on device\n";
-		exit(2);
-	}
-  for(size_t i = 0; i < nrows; i++)
-    for(size_t j = 0; j < ncols; j++)
-			f1[i * ncols + j] = feld[i][j];
 	hdf5* hd = new hdf5;
   if(hd->open_f(pathToHdfFile.c_str()) != 0)
     hd->create_f(pathToHdfFile.c_str());
 	bool success = false;
   if(hd->open_d(datasetName.c_str()) != 0)
   {
-    hd->write_f_feld(datasetName.c_str(), f1, nrows, ncols);
+    hd->write_f_feld(datasetName.c_str(), _grid->data(), nrows, ncols);
     hd->write_s_attribute("coordinate-system", coordinateSystemShort.c_str());
     hd->write_s_attribute("region-name", regionName.c_str());
     hd->write_l_attribute("time", t);
@@ -567,12 +669,17 @@ bool GridP::writeHdf(const string& pathToHdfFile, const string& datasetName,
     hd->write_i_attribute("nrows", nrows);
 		success = true;
 	}
-	delete[] f1;
 	delete hd;
 	return success;
 }
 #endif
 
+bool GridP::writeBinary(const string& pathToBinaryFile) const
+{
+	return writeBinaryGrid(pathToBinaryFile, *_grid,
+												 coordinateSystemToShortString(coordinateSystem()));
+}
+
 //void GridP::writeAscii(const std::string& pathToAsciiFile)
 //{
 //	return _grid->write_ascii((char*)pathToAsciiFile.c_str());
@@ -596,17 +703,19 @@ HistogramData GridP::histogram(int noOfClasses)
 	vector<double> linear(rows()*cols());
 	int k = -1;
   size_t nop = 0; // number of pixels
+	std::shared_ptr<const NoDataMask> mask = noDataMask();
   for(size_t i = 0; i < rows(); i++)
   {
+		//compact the valid values without branching on the single cells
+		const uint64_t* words = mask->row(i);
+		const float* row = _grid->feld[i];
     for(size_t j = 0; j < cols(); j++)
     {
-      if(isDataField(i, j))
-      {
-				linear[++k] = dataAt(i, j);
-				nop++;
-			}
+			linear[nop] = row[j];
+			nop += (words[j >> 6] >> (j & 63)) & 1;
 		}
 	}
+	k = int(nop) - 1;
 
 	if(nop == 0) return res;
 
@@ -670,12 +779,27 @@ multimap<double, double, greater<double> >
 }
 */
 
-GridP* GridP::setAllFieldsTo(double newValue, bool keepNoData)
+GridP* GridP::setAllFieldsTo(double newValue, bool keepNoData, ExecutionPolicy policy)
 {
-  for(size_t i = 0; i < rows(); i++)
-    for(size_t k = 0; k < cols(); k++)
-			if(!isNoDataField(i, k) || !keepNoData)
-				setDataAt(i, k, newValue);
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	grid* g = mutableGrid();
+	float v = float(newValue);
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+			if(keepNoData)
+				maskedUpdate(mask->row(r), cs, g->feld[r], [v](size_t) { return v; });
+			else
+				std::fill(g->feld[r], g->feld[r] + cs, v);
+	});
+
+	if(isNoDataValue(v, noDataValue()))
+		updateNoDataMask(NoDataMask(rows(), cols(), false));
+	else if(keepNoData)
+		updateNoDataMask(*mask);
+	else
+		updateNoDataMask(NoDataMask(rows(), cols(), true));
 	return this;
 }
 
@@ -690,7 +814,7 @@ GridP* GridP::setAllFieldsWithoutTo(float withoutValue, float toNewValue, bool i
 
 GridP::Rc2RowColRes GridP::rc2rowCol(Tools::RectCoord rc) const
 {
-	grid& g = gridRef();
+	const grid& g = gridRef();
   size_t row = -1, col = -1;
 
   bool rowsInside = g.xcorner <= rc.r && rc.r <= (g.xcorner + cellSize()*cols());
@@ -742,7 +866,7 @@ RCRect GridP::rcRect() const
 
 RCRect GridP::cellRCRectAt(size_t row, size_t col) const
 {
-	grid& g = gridRef();
+	const grid& g = gridRef();
 	RectCoord tl(coordinateSystem(),
 							 g.xcorner + col*cellSize(),
 							 g.ycorner + (rows() - row -1 + 1)*cellSize());
@@ -755,7 +879,7 @@ RCRect GridP::cellRCRectAt(size_t row, size_t col) const
 
 RectCoord GridP::rcCoordAt(size_t row, size_t col) const
 {
-	grid& g = gridRef();
+	const grid& g = gridRef();
 	return RectCoord(coordinateSystem(),
 									 g.xcorner + col*cellSize(),
 									 g.ycorner + (rows() - row - 1)*cellSize());
@@ -763,7 +887,7 @@ RectCoord GridP::rcCoordAt(size_t row, size_t col) const
 
 RectCoord GridP::rcCoordAtCenter(size_t row, size_t col) const
 {
-	grid& g = gridRef();
+	const grid& g = gridRef();
 	return RectCoord(coordinateSystem(),
 									 g.xcorner + col*cellSize() + cellSize()/2.0,
 									 g.ycorner + (rows() - row - 1)*cellSize() + cellSize()/2.0);
@@ -771,7 +895,7 @@ RectCoord GridP::rcCoordAtCenter(size_t row, size_t col) const
 
 RectCoord GridP::lowerLeftCorner() const
 {
-	grid& g = gridRef();
+	const grid& g = gridRef();
 	return RectCoord(coordinateSystem(), g.xcorner, g.ycorner);
 }
 
@@ -784,7 +908,7 @@ GridP* GridP::subGridClone(size_t top, size_t left, size_t nrows, size_t ncols)
 {
 	GridP* subGrid = new GridP(datasetName(), nrows, ncols, cellSize(),
 														 _grid->xcorner + left*cellSize(),
-														 _grid->ycorner + (rows() - top)*cellSize(),
+														 _grid->ycorner + (rows() - top - nrows)*cellSize(),
 														 noDataValue(),
 														 coordinateSystem());
 
@@ -816,37 +940,40 @@ string GridP::descriptiveLabel() const
 		: _descriptiveLabel;
 }
 
-std::pair<double, double> GridP::minMax() const
+std::pair<double, double> GridP::minMax(ExecutionPolicy policy) const
 {
 	if(rows() < 1 && cols() < 1)
 		return make_pair(0.0, 0.0);
 
-	double min = 0;
-  for(size_t i = 0; i < rows(); i++)
-  {
-    for(size_t j = 0; j < cols(); j++)
-    {
-      if(isDataField(i, j))
-      {
-        min = dataAt(i, j);
-        goto foundValidValue;
-      }
-    }
-  }
-  foundValidValue:
-	double max = min;
-
-  for(size_t i = 0; i < rows(); i++)
-  {
-    for(size_t j = 0; j < cols(); j++)
-    {
-      if(isDataField(i, j))
-      {
-				double v = dataAt(i, j);
-				if(v < min) min = v;
-				if(v > max) max = v;
+	struct MinMax { float min, max; bool found; };
+	vector<MinMax> parts(rowBlockCount(rows(), cols()));
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t block, size_t r0, size_t r1)
+	{
+		MinMax mm = {0, 0, false};
+		for(size_t r = r0; r < r1; r++)
+		{
+			float mi, ma;
+			if(maskedMinMax(mask->row(r), cs, _grid->feld[r], mi, ma))
+			{
+				mm.min = mm.found ? std::min(mm.min, mi) : mi;
+				mm.max = mm.found ? std::max(mm.max, ma) : ma;
+				mm.found = true;
 			}
 		}
+		parts[block] = mm;
+	});
+
+	double min = 0, max = 0;
+	bool found = false;
+	for(size_t i = 0; i < parts.size(); i++)
+	{
+		if(!parts[i].found)
+			continue;
+		min = found ? std::min(min, double(parts[i].min)) : parts[i].min;
+		max = found ? std::max(max, double(parts[i].max)) : parts[i].max;
+		found = true;
 	}
 
 	return make_pair(min, max);
@@ -874,106 +1001,144 @@ GridP* GridP::subtract(const GridP* other) const {
 }
 */
 
-double GridP::average() const
+double GridP::average(ExecutionPolicy policy) const
 {
-	double sum = 0;
-	int count = 0;
-  for(size_t r = 0, rs = rows(); r < rs; r++)
-  {
-    for(size_t c = 0, cs = cols(); c < cs; c++)
-    {
-      if(isDataField(r, c))
-      {
-				sum += dataAt(r, c);
-				++count;
-			}
+	vector<pair<double, size_t> > parts(rowBlockCount(rows(), cols()));
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t block, size_t r0, size_t r1)
+	{
+		double sum = 0;
+		size_t count = 0;
+		for(size_t r = r0; r < r1; r++)
+		{
+			double s;
+			size_t n;
+			maskedSum(mask->row(r), cs, _grid->feld[r], s, n);
+			sum += s;
+			count += n;
 		}
+		parts[block] = make_pair(sum, count);
+	});
+
+	double sum = 0;
+	size_t count = 0;
+	for(size_t i = 0; i < parts.size(); i++)
+	{
+		sum += parts[i].first;
+		count += parts[i].second;
 	}
 	return sum / double(count);
 }
 
 GridP* GridP::transformInPlace(std::function<float(float)> transformFunction)
 {
-  for(size_t r = 0, rs = rows(); r < rs; r++)
-    for(size_t c = 0, cs = cols(); c < cs; c++)
-      if(isDataField(r, c))
-        setDataAt(r, c, transformFunction(dataAt(r, c)));
-	return this;
+	return transformInPlace<std::function<float(float)>&>(transformFunction);
 }
 
 GridP* GridP::transformP(std::function<float(float)> transformFunction) const
 {
-	GridP* res = clone();
-  res->transformInPlace(transformFunction);
-	return res;
+	return transformP<std::function<float(float)>&>(transformFunction);
 }
 
-GridP* GridP::invert(float value)
+GridP* GridP::invert(float value, ExecutionPolicy policy)
 {
-  for(size_t r = 0, rs = rows(); r < rs; r++)
-  {
-    for(size_t c = 0, cs = cols(); c < cs; c++)
-    {
-      if(isNoDataField(r, c))
-        setDataAt(r, c, value);
-      else
-        setNoDataValueAt(r, c);
-    }
-  }
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	grid* g = mutableGrid();
+	float nd = float(noDataValue());
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+		{
+			const uint64_t* words = mask->row(r);
+			float* row = g->feld[r];
+			for(size_t c = 0; c < cs; c++)
+				row[c] = (words[c >> 6] >> (c & 63)) & 1 ? nd : value;
+		}
+	});
 	return this;
 }
 
-GridP* GridP::setFieldsTo(const GridP* other, bool keepNoData)
+GridP* GridP::setFieldsTo(const GridP* other, bool keepNoData, ExecutionPolicy policy)
 {
   if(!isCompatible(other))
 		return this;
 
-  for(size_t r = 0, rs = other->rows(); r < rs; r++)
-  {
-    for(size_t c = 0, cs = other->cols(); c < cs; c++)
-    {
-      if(isNoDataField(r, c) && keepNoData)
-        continue;
-      setDataAt(r, c, other->dataAt(r, c));
-    }
-  }
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	grid* g = mutableGrid();
+	const grid* og = other->gridPtr();
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+		{
+			const uint64_t* words = mask->row(r);
+			float* row = g->feld[r];
+			const float* orow = og->feld[r];
+			for(size_t c = 0; c < cs; c++)
+				row[c] = keepNoData && !((words[c >> 6] >> (c & 63)) & 1) ? row[c] : orow[c];
+		}
+	});
 
 	return this;
 }
 
-GridP* GridP::maskOut(const GridP* maskGrid, float byValueInMaskGrid, bool keep)
+GridP* GridP::maskOut(const GridP* maskGrid, float byValueInMaskGrid, bool keep,
+										 ExecutionPolicy policy)
 {
   bool discard = !keep;
 
   if(!isCompatible(maskGrid))
 		return this;
 
-  for(size_t r = 0, rs = maskGrid->rows(); r < rs; r++)
-  {
-    for(size_t c = 0, cs = maskGrid->cols(); c < cs; c++)
-    {
-      bool found = fuzzyCompare(maskGrid->dataAt(r, c), byValueInMaskGrid);
-      if((found && discard) || (keep && !found))
-				setNoDataValueAt(r, c);
-    }
-  }
+	grid* g = mutableGrid();
+	const grid* mg = maskGrid->gridPtr();
+	float nd = float(noDataValue());
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+		{
+			float* row = g->feld[r];
+			const float* mrow = mg->feld[r];
+			for(size_t c = 0; c < cs; c++)
+			{
+				bool found = fuzzyCompare(mrow[c], byValueInMaskGrid);
+				if((found && discard) || (keep && !found))
+					row[c] = nd;
+			}
+		}
+	});
 
 	return this;
 }
 
 GridP* GridP::maskTo(const GridP* maskGrid, float matchMaskValueTo,
-									 float newValue, bool keepNoData)
+										float newValue, bool keepNoData, ExecutionPolicy policy)
 {
 	bool replaceNoData = !keepNoData;
 
 	if(!isCompatible(maskGrid))
 		return this;
 
-  for(size_t r = 0, rs = maskGrid->rows(); r < rs; r++)
-    for(size_t c = 0, cs = maskGrid->cols(); c < cs; c++)
-			if((isDataField(r, c) || replaceNoData)
-					&& fuzzyCompare(maskGrid->dataAt(r, c), matchMaskValueTo))
-				setDataAt(r, c, newValue);
+	std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+	grid* g = mutableGrid();
+	const grid* mg = maskGrid->gridPtr();
+	size_t cs = cols();
+	forRowBlocks(rows(), cs, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+		{
+			const uint64_t* words = mask->row(r);
+			float* row = g->feld[r];
+			const float* mrow = mg->feld[r];
+			for(size_t c = 0; c < cs; c++)
+				if((replaceNoData || (words[c >> 6] >> (c & 63)) & 1)
+					 && fuzzyCompare(mrow[c], matchMaskValueTo))
+					row[c] = newValue;
+		}
+	});
 
 	return this;
 }
@@ -998,7 +1163,7 @@ GridP* GridP::adjustToP(GridMetaData gmd) const
   {
     if(cs % mcs == 0)
     {
-			transSelf = GridPPtr(new GridP(gridPtr()->downscale(cs / mcs),
+			transSelf = GridPPtr(new GridP(const_cast<grid*>(gridPtr())->downscale(cs / mcs),
 																		 coordinateSystem()));
       self = transSelf.get();
     }
@@ -1009,7 +1174,7 @@ GridP* GridP::adjustToP(GridMetaData gmd) const
   {
     if(mcs % cs == 0)
     {
-			transSelf = GridPPtr(new GridP(gridPtr()->upscale(mcs / cs),
+			transSelf = GridPPtr(new GridP(const_cast<grid*>(gridPtr())->upscale(mcs / cs),
 																		 coordinateSystem()));
       self = transSelf.get();
     }
@@ -1068,7 +1233,12 @@ GridP* GridProxy::gridPtr()
     lock_guard<mutex> lock(_lockable);
     if(!g)
     {
-			if(!pathToHdf.empty())
+			//mapping the binary file is cheaper than any copy of it
+			if(binary)
+				g = GridPPtr(new GridP(datasetName, GridP::BINARY,
+															 pathToGrid + "/" + fileName,
+															 coordinateSystem));
+			else if(!pathToHdf.empty())
 				g = GridPPtr(new GridP(datasetName, GridP::HDF,
 															 pathToHdf + "/" + hdfFileName,
 															 coordinateSystem));
@@ -1089,6 +1259,55 @@ GridPPtr GridProxy::gridPPtr()
 	return g;
 }
 
+GridPPtr GridProxy::subgridPPtr(const SubData& window)
+{
+  //an empty window (e.g. no intersection) selects nothing, don't load anything for it
+  if(!window.isValid())
+    return GridPPtr();
+
+  GridPPtr loaded;
+  {
+    lock_guard<mutex> lock(_lockable);
+    loaded = g;
+  }
+
+#ifndef NO_HDF5
+  //read just the window, the proxy keeps not loaded (no lock needed, nothing is shared)
+  if(!loaded && !binary && !pathToHdf.empty())
+  {
+    GridPPtr sub(new GridP(new grid(100), coordinateSystem));
+    sub->setDatasetName(datasetName);
+    if(sub->readHdf(pathToHdf + "/" + hdfFileName, datasetName, window) == 0)
+      return sub;
+    //the window couldn't be read, the full load below reports the error
+  }
+#endif
+
+  //ascii grids can't be read partially, binary ones are just mapped
+  if(!loaded)
+    loaded = gridPPtr();
+  //e.g. the grid couldn't be loaded at all
+  if(window.row + window.rows > loaded->rows() || window.col + window.cols > loaded->cols())
+    return GridPPtr();
+  return GridPPtr(loaded->subGridClone(window.row, window.col,
+                                       window.rows, window.cols));
+}
+
+void Grids::loadGridProxies(const vector<GridProxyPtr>& gps)
+{
+	vector<TaskFuture<void> > loading;
+	for(GridProxyPtr gp : gps)
+		if(gp->pathToHdf.empty())
+			loading.push_back(defaultThreadPool().async([gp]() { gp->gridPtr(); }));
+
+	for(GridProxyPtr gp : gps)
+		if(!gp->pathToHdf.empty())
+			gp->gridPtr();
+
+	for(size_t i = 0; i < loading.size(); i++)
+		loading[i].get();
+}
+
 void GridProxy::resetToLoadFromAscii(const string& ptg)
 {
 	pathToHdf = "";
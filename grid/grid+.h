@@ -26,12 +26,20 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #endif
 
 #include <vector>
+#include <algorithm>
+#include <atomic>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <mutex>
+#include <sstream>
+#include <type_traits>
 
 #include "grid.h"
+#include "ascii-grid-io.h"
+#include "grid-t.h"
+#include "nodata-mask.h"
+#include "common/thread-pool.h"
 #include "tools/coord-trans.h"
 #include "tools/algorithms.h"
 #include "tools/datastructures.h"
@@ -191,6 +199,9 @@ namespace Grids
 	std::pair<Row, Col> rowColInGrid(const GridMetaData& gmd,
 		const Tools::RectCoord& c);
 
+	//! rows/cols of the grid described by gmd covered by rect r (same rules as GridP::rc2rowCol)
+	SubData subDataInGrid(const GridMetaData& gmd, const RCRect& r);
+
 	//----------------------------------------------------------------------------
 
   typedef std::shared_ptr<grid> GridPtr;
@@ -199,11 +210,45 @@ namespace Grids
 
   typedef std::shared_ptr<GridP> GridPPtr;
 
+	template<class E>
+	struct GridExpr;
+
+	/*!
+	 * number of rows worked on in one block by the bulk operations,
+	 * depends only on the width of the grid, so reductions combining the
+	 * block results in order give the same result for every policy
+	 */
+	inline std::size_t rowsPerBlock(std::size_t cols)
+	{
+		return std::max<std::size_t>(1, (1 << 16) / std::max<std::size_t>(1, cols));
+	}
+
+	inline std::size_t rowBlockCount(std::size_t rows, std::size_t cols)
+	{
+		return (rows + rowsPerBlock(cols) - 1) / rowsPerBlock(cols);
+	}
+
+	/*!
+	 * call f(block, firstRow, endRow) for the blocks of rows of a rows x cols grid,
+	 * in parallel on the library thread pool unless policy is sequential
+	 */
+	template<class F>
+	void forRowBlocks(std::size_t rows, std::size_t cols, Tools::ExecutionPolicy policy, F f)
+	{
+		std::size_t rpb = rowsPerBlock(cols), blocks = rowBlockCount(rows, cols);
+		auto block = [&](std::size_t b) { f(b, b*rpb, std::min(rows, (b + 1)*rpb)); };
+		if(!Tools::isParallel(policy) || blocks < 2)
+			for(std::size_t b = 0; b < blocks; b++)
+				block(b);
+		else
+			Tools::defaultThreadPool().parallelFor(blocks, block);
+	}
+
 	//!grid+ class
 	class GridP
 	{
 	public:
-		enum FileType { HDF, ASCII };
+		enum FileType { HDF, ASCII, BINARY };
 
     GridP(Tools::CoordinateSystem cs = Tools::CoordinateSystem());// = Tools::GK5_EPSG31469);
 
@@ -221,16 +266,20 @@ namespace Grids
 
     GridP(grid* wrapThisGrid, Tools::CoordinateSystem cs);// = Tools::GK5_EPSG31469);
 
-		//! copy constructor
+		//! copy constructor, the cells are shared until one of both writes
 		GridP(const GridP& other);
 
+		GridP(GridP&& other);
+
 		virtual ~GridP();
 
 		/**
-		* assignment
+		* assignment, the cells are shared until one of both writes
 		*/
 		GridP& operator=(const GridP& other);
 
+		GridP& operator=(GridP&& other);
+
 		/**
 		* conversion copy constructor
 		*/
@@ -238,9 +287,32 @@ namespace Grids
 
     GridP(grid const *const other, Tools::CoordinateSystem cs);// = Tools::GK5_EPSG31469);
 
+		//! float copy of a typed grid (explicit, as it widens uint8/int16 grids)
+		template<typename T>
+		explicit GridP(const GridT<T>& other, Tools::CoordinateSystem cs,
+									 const std::string& datasetName = std::string())
+			: _grid(GridPtr(other.toGrid())),
+				_datasetName(datasetName),
+				_coordinateSystem(cs) {}
+
+		//! typed copy, values are rounded for integral T, no data cells get noDataValue
+		template<typename T>
+		GridT<T> toGridT(T noDataValue = GridValueTraits<T>::defaultNoData()) const
+		{
+			return GridT<T>(*_grid, noDataValue);
+		}
+
 		//! copies other
 		GridP& operator=(const grid& other);
 
+		//! evaluate a grid expression (e.g. a*b + c*d) in one pass into the new grid
+		template<class E>
+		GridP(const GridExpr<E>& expression);
+
+		//! evaluate expression into this grid, which may be part of it
+		template<class E>
+		GridP& operator=(const GridExpr<E>& expression);
+
 		//! copies other
 		GridP & operator=(grid const *const other) { return (*this) = *other; }
 
@@ -252,7 +324,9 @@ namespace Grids
 		}
 
 #ifndef NO_HDF5
-    int readHdf(const std::string& pathToHdfFile, const std::string& datasetName);
+    //! read the dataset, if window is valid only this part of the stored grid
+    int readHdf(const std::string& pathToHdfFile, const std::string& datasetName,
+                const SubData& window = SubData());
 
     bool writeHdf(const std::string& pathToHdfFile,
                   const std::string& datasetName,
@@ -261,15 +335,30 @@ namespace Grids
                   time_t t);
 #endif
 
-		template<typename ValueType>
-		void writeAscii(const std::string& pathToAsciiFile) const;
+		/*!
+		 * write as ESRI ASCII grid, values are cast to ValueType
+		 * @param precision digits after the decimal point for floating point
+		 * ValueTypes, AsciiGridFormat::shortest for the shortest exact representation
+		 */
+		template<typename ValueType = float>
+		void writeAscii(const std::string& pathToAsciiFile, int precision = 6) const;
+
+		//! write as native binary grid (binary-grid.h), keeps the coordinate system
+		bool writeBinary(const std::string& pathToBinaryFile) const;
 
 		//! create clone of part of the grid
     GridP* subGridClone(std::size_t top, std::size_t left, std::size_t rows, std::size_t cols) const;
 
-		//! create exact copy of the grid
+		GridPPtr subGridClonePtr(std::size_t top, std::size_t left, std::size_t rows, std::size_t cols) const
+		{
+			return GridPPtr(subGridClone(top, left, rows, cols));
+		}
+
+		//! create exact copy of the grid (shares the cells until written)
 		GridP* clone() const { return new GridP(*this); }
 
+		GridPPtr clonePtr() const { return std::make_shared<GridP>(*this); }
+
 		//! create a structural copy, but set all fields to given emptyValue
 		GridP* emptyClone(bool keepNoData = true) const
 		{
@@ -278,6 +367,16 @@ namespace Grids
 
 		GridP* fillClone(double fillValue, bool keepNoData = true) const;
 
+		GridPPtr emptyClonePtr(bool keepNoData = true) const
+		{
+			return GridPPtr(emptyClone(keepNoData));
+		}
+
+		GridPPtr fillClonePtr(double fillValue, bool keepNoData = true) const
+		{
+			return GridPPtr(fillClone(fillValue, keepNoData));
+		}
+
 		void setDescriptiveLabel(const std::string& label)
 		{
 			_descriptiveLabel = label;
@@ -312,7 +411,8 @@ namespace Grids
 			frequency(bool includeNoDataValues, std::function<GridValueType(double)> roundGridValueF, 
 			std::function<PercentageType(double)> roundPercentageValueF) const;
 
-		GridP* setAllFieldsTo(double newValue, bool keepNoData = true);
+		GridP* setAllFieldsTo(double newValue, bool keepNoData = true,
+													Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
 
 		template<typename Collection>
 		GridP* setAllFieldsWithinTo(Collection matchValues, float toNewValue, bool includeNoData = false)
@@ -332,7 +432,8 @@ namespace Grids
 
 		GridP* setAllFieldsWithoutTo(float withoutValue, float toNewValue, bool includeNoData = false);
 
-		GridP* setFieldsTo(const GridP* other, bool keepNoData = true);
+		GridP* setFieldsTo(const GridP* other, bool keepNoData = true,
+											 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
 
 		template<typename ReturnType>
     ReturnType dataAtRT(std::size_t row, std::size_t col) const
@@ -346,11 +447,20 @@ namespace Grids
 
     GridP* setDataAt(std::size_t row, std::size_t col, float value)
 		{
+			detach();
 			_grid->feld[row][col] = value;
+			if(_noDataMask && !_noDataMask->empty())
+				_noDataMask->set(row, col, !isNoDataValue(value, noDataValue()));
 			return this;
 		}
 
-    float* operator[](std::size_t row){ return _grid->feld[row]; }
+		//! writable row, a kept no data mask has to be rebuilt afterwards
+    float* operator[](std::size_t row)
+		{
+			detach();
+			invalidateNoDataMask();
+			return _grid->feld[row];
+		}
 
 		GridP* setDataAt(Tools::RectCoord rcc, float value);
 
@@ -366,12 +476,40 @@ namespace Grids
 
     bool isNoDataField(std::size_t row, std::size_t col) const
 		{
-			return int(dataAt(row, col)) == noDataValue();
+			return isNoDataValue(dataAt(row, col), noDataValue());
 		}
 
 		bool isNoDataField(Tools::RectCoord rcc) const
 		{
-			return int(dataAt(rcc)) == noDataValue();
+			return isNoDataValue(dataAt(rcc), noDataValue());
+		}
+
+		/*!
+		 * keep a validity bitmask up to date in setDataAt/setNoDataValueAt, so
+		 * the bulk operations don't have to rebuild it every time;
+		 * writes through mutableGrid()/operator[] make it rebuild on next use
+		 */
+		void keepNoDataMask(bool keep = true);
+
+		//! the kept mask is rebuilt on next use
+		void invalidateNoDataMask()
+		{
+			if(_noDataMask)
+				_noDataMask = std::make_shared<NoDataMask>();
+		}
+
+		/*!
+		 * validity of the cells, the kept one or a freshly built;
+		 * safe to call from several threads on a const GridP
+		 */
+		std::shared_ptr<const NoDataMask> noDataMask(
+				Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const;
+
+		//! the cells have been changed in bulk, mask is their new validity
+		void updateNoDataMask(const NoDataMask& mask)
+		{
+			if(_noDataMask)
+				_noDataMask = std::make_shared<NoDataMask>(mask);
 		}
 
     bool isDataField(std::size_t row, std::size_t col) const
@@ -386,9 +524,35 @@ namespace Grids
 
 		std::string toString() const;
 
-		grid& gridRef() const { return *gridPtr(); }
+		//! read access, the grid may be shared with copies of this GridP
+		const grid& gridRef() const { return *_grid; }
+
+		const grid* gridPtr() const { return _grid.get(); }
+
+		/*!
+		 * write access, the cells are copied first if they have been shared with
+		 * other GridPs and a kept no data mask is rebuilt on next use;
+		 * use the pointer right away, not across copies of this GridP
+		 */
+		grid* mutableGrid()
+		{
+			detach();
+			invalidateNoDataMask();
+			return _grid.get();
+		}
 
-		grid* gridPtr() const { return _grid.get(); }
+		/*!
+		 * copy the cells if they have been shared with another GridP (copy on write),
+		 * decided by a flag set when copying, not by the (racy) use count
+		 */
+		void detach()
+		{
+			if(_grid && _shared.load(std::memory_order_relaxed))
+			{
+				_grid = GridPtr(_grid->grid_copy());
+				_shared.store(false, std::memory_order_relaxed);
+			}
+		}
 
 		std::string datasetName() const { return _datasetName; }
 
@@ -433,12 +597,26 @@ namespace Grids
 
 		bool isCompatible(const GridP* other) const;
 
-		std::pair<double, double> minMax() const;
+		//! min/max of the data cells, the policy only changes the speed
+		std::pair<double, double> minMax(Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const;
 
-		double average() const;
+		/*!
+		 * average of the data cells, the sums of the blocks of rows are added
+		 * in order, so the result is the same for every policy
+		 */
+		double average(Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const;
 
 		GridP* transformInPlace(std::function<float(float)> transformFunction);
 
+		/*!
+		 * apply f to all data cells, no data cells are left as they are (like the
+		 * std::function overload), walking the rows directly so simple lambdas
+		 * are inlined and vectorized
+		 * @param policy parallel policies call f concurrently from several threads
+		 */
+		template<class F>
+		GridP* transformInPlace(F f, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
+
 		GridP* replace(float searchValue, float replaceValue)
 		{
       return transformInPlace([=](float v)
@@ -454,6 +632,20 @@ namespace Grids
 
 		GridP* transformP(std::function<float(float)> transformFunction) const;
 
+		template<class F>
+		GridPPtr transform(F f, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const
+		{
+			return GridPPtr(transformP(f, policy));
+		}
+
+		template<class F>
+		GridP* transformP(F f, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const
+		{
+			GridP* res = clone();
+			res->transformInPlace(f, policy);
+			return res;
+		}
+
     struct Rc2RowColRes
     {
       Rc2RowColRes() : row(-1), col(-1), isRowOutside(true), isColOutside(true) {}
@@ -464,13 +656,13 @@ namespace Grids
     };
     Rc2RowColRes rc2rowCol(Tools::RectCoord rcc) const;
 
-		GridP* invert(float value);
+		GridP* invert(float value, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
 
 		GridP* maskOut(const GridP* maskGrid, float byValueInMaskGrid,
-			bool keepDataAtMatchPoint = true);
+			bool keepDataAtMatchPoint = true, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
 
 		GridP* maskTo(const GridP* maskGrid, float matchMaskValueTo, float newValue,
-			bool keepNoData = true);
+			bool keepNoData = true, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential);
 
 		//! adjust this grid to match the model model, by croping or adding noData
 		GridP* adjustToP(GridMetaData gmd) const;
@@ -484,51 +676,112 @@ namespace Grids
 		std::set<T> uniqueValues(std::function<T(float)> transform =
 				std::function<T(float)>(), bool ignoreNoDataValues = true) const
 		{
-			return mapF<std::set<T>>(transform ? transform : [](float v){ return T(v); },
-															 ignoreNoDataValues);
+			if(transform)
+				return mapF<std::set<T>>(transform, ignoreNoDataValues);
+
+			//sorting the values is much faster than inserting them one by one
+			std::vector<T> vs = mapF<std::vector<T>>([](float v){ return T(v); },
+																							 ignoreNoDataValues);
+			std::sort(vs.begin(), vs.end());
+			return std::set<T>(vs.begin(), std::unique(vs.begin(), vs.end()));
 		}
 
-    template<class Container>
-    Container mapF(std::function<typename Container::value_type(float)> transformFunc,
-									 bool ignoreNoDataValues = true) const
+		template<typename T, class F>
+		std::set<T> uniqueValues(F transform, bool ignoreNoDataValues = true) const
+		{
+			return mapF<std::set<T>>(transform, ignoreNoDataValues);
+		}
+
+		//! mapF for any callable, walks the rows and the no data mask directly
+		template<class Container, class F>
+		Container mapF(F transformFunc, bool ignoreNoDataValues = true) const
+		{
+			return mapIndexedF<Container>([&transformFunc](std::size_t, std::size_t, float v)
+			{
+				return transformFunc(v);
+			}, ignoreNoDataValues);
+		}
+
+		template<class Container, class F>
+		Container mapIndexedF(F rowColTransformFunc, bool ignoreNoDataValues = true) const
 		{
 			Container cont;
-      for(std::size_t r = 0, rs = rows(); r < rs; r++)
+			std::shared_ptr<const NoDataMask> mask;
+			if(ignoreNoDataValues)
+				mask = noDataMask();
+			for(std::size_t r = 0, rs = rows(), cs = cols(); r < rs; r++)
 			{
-        for(std::size_t c = 0, cs = cols(); c < cs; c++)
-				{
-					if(isNoDataField(r, c) && ignoreNoDataValues)
-						continue;
-					cont.insert(cont.end(), transformFunc(dataAt(r, c)));
-				}
+				const float* row = _grid->feld[r];
+				const uint64_t* words = mask ? mask->row(r) : NULL;
+				for(std::size_t c = 0; c < cs; c++)
+					if(!words || (words[c >> 6] >> (c & 63)) & 1)
+						cont.insert(cont.end(), rowColTransformFunc(r, c, row[c]));
 			}
 			return cont;
 		}
 
+    template<class Container>
+    Container mapF(std::function<typename Container::value_type(float)> transformFunc,
+									 bool ignoreNoDataValues = true) const
+		{
+			return mapF<Container, std::function<typename Container::value_type(float)>&>
+				(transformFunc, ignoreNoDataValues);
+		}
+
     template<class Container>
     Container mapIndexedF(std::function<typename Container::value_type(std::size_t, std::size_t, float)> rowColTransformFunc,
                           bool ignoreNoDataValues = true) const
     {
-      Container cont;
-      for(std::size_t r = 0, rs = rows(); r < rs; r++)
-      {
-        for(std::size_t c = 0, cs = cols(); c < cs; c++)
-        {
-          if(isNoDataField(r, c) && ignoreNoDataValues)
-            continue;
-          cont.insert(cont.end(), rowColTransformFunc(r, c, dataAt(r, c)));
-        }
-      }
-      return cont;
+      return mapIndexedF<Container, std::function<typename Container::value_type(std::size_t, std::size_t, float)>&>
+        (rowColTransformFunc, ignoreNoDataValues);
     }
 
 		template<typename T>
 		T foldF(T init, std::function<T(T, float)> foldFunc) const
+		{
+			return foldF<T, std::function<T(T, float)>&>(init, foldFunc);
+		}
+
+		/*!
+		 * fold all cells (no data too) row by row, every block of rows
+		 * (see rowsPerBlock) starts with init and the block results are combined
+		 * in order with combineFunc(left, right), so the result doesn't depend
+		 * on the policy
+		 */
+		template<typename T, class F, class C>
+		T foldF(T init, F foldFunc, C combineFunc,
+						Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential) const
+		{
+			std::size_t rs = rows(), cs = cols();
+			std::vector<T> parts(std::max<std::size_t>(1, rowBlockCount(rs, cs)), init);
+			forRowBlocks(rs, cs, policy, [&](std::size_t block, std::size_t r0, std::size_t r1)
+			{
+				T res = init;
+				for(std::size_t r = r0; r < r1; r++)
+				{
+					const float* row = _grid->feld[r];
+					for(std::size_t c = 0; c < cs; c++)
+						res = foldFunc(res, row[c]);
+				}
+				parts[block] = res;
+			});
+			T res = parts[0];
+			for(std::size_t i = 1; i < parts.size(); i++)
+				res = combineFunc(res, parts[i]);
+			return res;
+		}
+
+		//! fold all cells (no data too) row by row in the calling thread
+		template<typename T, class F>
+		T foldF(T init, F foldFunc) const
 		{
 			T res = init;
-      for(std::size_t r = 0, rs = rows(); r < rs; r++)
-        for(std::size_t c = 0, cs = cols(); c < cs; c++)
-					res = foldFunc(res, dataAt(r, c));
+			for(std::size_t r = 0, rs = rows(), cs = cols(); r < rs; r++)
+			{
+				const float* row = _grid->feld[r];
+				for(std::size_t c = 0; c < cs; c++)
+					res = foldFunc(res, row[c]);
+			}
 			return res;
 		}
 
@@ -549,51 +802,78 @@ namespace Grids
 		std::string _unit;
 		std::function<std::string(double)> _displayValueTransformFunction;
 		Tools::CoordinateSystem _coordinateSystem;
+		mutable std::shared_ptr<NoDataMask> _noDataMask;
+		//! guards filling in the kept mask from const noDataMask()
+		mutable std::mutex _noDataMaskMutex;
+		//! the cells are or have been shared with a copy, write only after detach()
+		mutable std::atomic<bool> _shared{false};
+
+		template<class E>
+		void evaluate(const E& expression);
 	};
 
 	template<class CollectionOfGrids>
-	GridP* averageP(const CollectionOfGrids& gridps)
+	GridP* averageP(const CollectionOfGrids& gridps, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential)
 	{
 		if (gridps.empty())
 			return new GridP();
 
     std::size_t size = gridps.size();
 		GridP* res = (*(gridps.begin()))->fillClone(0.0);
-    for(std::size_t r = 0, rs = res->rows(); r < rs; r++)
+
+		//valid where all grids are valid, the sums are done branch free for all cells
+		NoDataMask mask(*res->noDataMask(policy));
+		for(typename CollectionOfGrids::value_type g : gridps)
+			mask &= *g->noDataMask(policy);
+
+		float nd = float(res->noDataValue());
+		grid* rg = res->mutableGrid();
+		std::size_t cs = res->cols();
+		forRowBlocks(res->rows(), cs, policy, [&](std::size_t, std::size_t r0, std::size_t r1)
 		{
-      for(std::size_t c = 0, cs = res->cols(); c < cs; c++)
+			std::vector<float> acc(cs);
+			for(std::size_t r = r0; r < r1; r++)
 			{
-				if(res->isDataField(r, c))
+				std::fill(acc.begin(), acc.end(), 0.0f);
+				for(typename CollectionOfGrids::value_type g : gridps)
 				{
-          for(typename CollectionOfGrids::value_type g : gridps)
-					{
-						if(g->isNoDataField(r, c))
-						{
-							res->setNoDataValueAt(r, c);
-							break;
-						}
-            res->setDataAt(r, c, float(res->dataAt(r, c) + (g->dataAt(r, c) / float(size))));
-					}
+					const float* gr = g->gridPtr()->feld[r];
+					for(std::size_t c = 0; c < cs; c++)
+						acc[c] = float(acc[c] + (gr[c] / float(size)));
 				}
+				const float* a = acc.data();
+				maskedApply(mask.row(r), cs, rg->feld[r], nd,
+										[a](std::size_t c) { return a[c]; });
 			}
-		}
+		});
+		res->updateNoDataMask(mask);
 
 		return res;
 	}
 
 	template<class CollectionOfGrids>
-	GridPPtr average(const CollectionOfGrids& gridps)
+	GridPPtr average(const CollectionOfGrids& gridps, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential)
 	{
-		return GridPPtr(averageP(gridps));
+		return GridPPtr(averageP(gridps, policy));
 	}
 
+	//! left = op(left, value) for the cells with data, no data cells are left as they are
 	template<class OP>
-	GridP& inPlaceScalarMatrixOp(GridP& left, float value, OP op)
+	GridP& inPlaceScalarMatrixOp(GridP& left, float value, OP op, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential)
 	{
-    for (std::size_t r = 0, rs = left.rows(); r < rs; r++)
-      for (std::size_t c = 0, cs = left.cols(); c < cs; c++)
-				if (left.isDataField(r, c))
-					left.setDataAt(r, c, op(left.dataAt(r, c), value));
+		std::shared_ptr<const NoDataMask> mask = left.noDataMask(policy);
+		grid* lg = left.mutableGrid();
+		std::size_t cs = left.cols();
+		forRowBlocks(left.rows(), cs, policy, [&](std::size_t, std::size_t r0, std::size_t r1)
+		{
+			for(std::size_t r = r0; r < r1; r++)
+			{
+				float* l = lg->feld[r];
+				maskedUpdate(mask->row(r), cs, l,
+										 [l, value, &op](std::size_t c) { return op(l[c], value); });
+			}
+		});
+		left.updateNoDataMask(*mask);
 		return left;
 	}
 
@@ -602,20 +882,28 @@ namespace Grids
 		return inPlaceScalarMatrixOp(left, value, std::multiplies<float>());
 	}
 
+	//! left = op(left, right) where both have data, else left's no data value
 	template<class OP>
-	GridP& inPlaceScalarMatrixOp(GridP& left, const GridP& right, OP op)
+	GridP& inPlaceScalarMatrixOp(GridP& left, const GridP& right, OP op, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential)
 	{
 		assert(left.isCompatible(&right));
-    for (std::size_t r = 0, rs = left.rows(); r < rs; r++)
+		NoDataMask mask(*left.noDataMask(policy));
+		mask &= *right.noDataMask(policy);
+		float nd = float(left.noDataValue());
+		grid* lg = left.mutableGrid();
+		const grid* rg = right.gridPtr();
+		std::size_t cs = left.cols();
+		forRowBlocks(left.rows(), cs, policy, [&](std::size_t, std::size_t r0, std::size_t r1)
 		{
-      for (std::size_t c = 0, cs = left.cols(); c < cs; c++)
+			for(std::size_t r = r0; r < r1; r++)
 			{
-				if (left.isDataField(r, c) && right.isDataField(r, c))
-					left.setDataAt(r, c, op(left.dataAt(r, c), right.dataAt(r, c)));
-				else
-					left.setNoDataValueAt(r,c);
+				float* l = lg->feld[r];
+				const float* rr = rg->feld[r];
+				maskedApply(mask.row(r), cs, l, nd,
+										[l, rr, &op](std::size_t c) { return op(l[c], rr[c]); });
 			}
-		}
+		});
+		left.updateNoDataMask(mask);
 		return left;
 	}
 
@@ -629,70 +917,208 @@ namespace Grids
 		return inPlaceScalarMatrixOp(left, right, std::plus<float>());
 	}
 
+	/*!
+	 * cellwise op(left, right) where both have data, else the one with data,
+	 * op is only called for cells where both have data, unless policy is
+	 * parallelUnsequenced
+	 */
 	template<class OP>
-	GridP& merge(const GridP& left, const GridP& right, OP op)
+	GridP merge(const GridP& left, const GridP& right, OP op, Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::sequential)
 	{
 		assert(left.isCompatible(&right));
-		GridP* res = left.clone();
-    for (std::size_t r = 0, rs = res->rows(); r < rs; r++)
+		std::shared_ptr<const NoDataMask> lm = left.noDataMask(policy);
+		std::shared_ptr<const NoDataMask> rm = right.noDataMask(policy);
+		NoDataMask mask(*lm);
+		mask |= *rm;
+
+		GridP res(left);
+		grid* g = res.mutableGrid();
+		const grid* lg = left.gridPtr();
+		const grid* rg = right.gridPtr();
+		float nd = float(res.noDataValue());
+		std::size_t cs = res.cols();
+		bool dense = policy == Tools::ExecutionPolicy::parallelUnsequenced;
+		forRowBlocks(res.rows(), cs, policy, [&](std::size_t, std::size_t r0, std::size_t r1)
 		{
-      for (std::size_t c = 0, cs = res->cols(); c < cs; c++)
+			for(std::size_t r = r0; r < r1; r++)
 			{
-				if(left.isNoDataField(r, c))
+				const uint64_t* lw = lm->row(r);
+				const uint64_t* rw = rm->row(r);
+				const float* l = lg->feld[r];
+				const float* rr = rg->feld[r];
+				float* out = g->feld[r];
+				for(std::size_t c = 0; c < cs; c++)
 				{
-					if(right.isDataField(r, c))
-						res->setDataAt(r, c, right.dataAt(r, c));
-					else
-						res->setNoDataValueAt(r, c);
-				}
-				else
-				{
-					if(right.isNoDataField(r, c))
-						res->setDataAt(r, c, left.dataAt(r, c));
+					bool lv = (lw[c >> 6] >> (c & 63)) & 1, rv = (rw[c >> 6] >> (c & 63)) & 1;
+					if(dense)
+					{
+						float both = op(l[c], rr[c]);
+						out[c] = lv ? (rv ? both : l[c]) : (rv ? rr[c] : nd);
+					}
 					else
-						res->setDataAt(r, c, op(left.dataAt(r, c), right.dataAt(r, c)));
+						out[c] = lv ? (rv ? op(l[c], rr[c]) : l[c]) : (rv ? rr[c] : nd);
 				}
 			}
-		}
-		return *res;
+		});
+		res.updateNoDataMask(mask);
+		return res;
 	}
 
-	template<class OP>
-	GridP& scalarMatrixOp(const GridP& left, const GridP& right, OP op)
+	//----------------------------------------------------------------------------
+	//expression templates for the arithmetic operators
+	//a*b + c*d just builds a small tree of expression objects, which is
+	//evaluated when assigned to a GridP: one loop over the cells, no
+	//intermediate grids, cells where one of the grids is no data become
+	//no data (value of the leftmost grid)
+
+	//! non template base, to recognize expressions
+	struct GridExprBase {};
+
+	template<class E>
+	struct GridExpr : public GridExprBase
 	{
-		assert(left.isCompatible(&right));
-		GridP* res = left.clone();
-    for (std::size_t r = 0, rs = res->rows(); r < rs; r++)
+		const E& self() const { return static_cast<const E&>(*this); }
+	};
+
+	//! a grid in an expression
+	class GridExprLeaf : public GridExpr<GridExprLeaf>
+	{
+	public:
+		explicit GridExprLeaf(const GridP& g) : _g(&g), _feld(g.gridPtr()->feld) {}
+
+		//! grid which determines size, position and no data value of the result
+		const GridP& shape() const { return *_g; }
+
+		float value(std::size_t r, std::size_t c) const { return _feld[r][c]; }
+
+		void andNoDataMask(NoDataMask& mask) const { mask &= *_g->noDataMask(); }
+
+	private:
+		const GridP* _g;
+		float** _feld;
+	};
+
+	//! left op right
+	template<class L, class R, class OP>
+	class GridExprBinary : public GridExpr<GridExprBinary<L, R, OP> >
+	{
+	public:
+		GridExprBinary(const L& left, const R& right, OP op)
+			: _left(left), _right(right), _op(op)
 		{
-      for (std::size_t c = 0, cs = res->cols(); c < cs; c++)
-			{
-				if (left.isDataField(r, c) && right.isDataField(r, c))
-					res->setDataAt(r, c, op(left.dataAt(r, c), right.dataAt(r, c)));
-				else
-					res->setNoDataValueAt(r, c);
-			}
+			assert(left.shape().isCompatible(&right.shape()));
+		}
+
+		const GridP& shape() const { return _left.shape(); }
+
+		float value(std::size_t r, std::size_t c) const
+		{
+			return _op(_left.value(r, c), _right.value(r, c));
+		}
+
+		void andNoDataMask(NoDataMask& mask) const
+		{
+			_left.andNoDataMask(mask);
+			_right.andNoDataMask(mask);
 		}
-		return *res;
-	}
 
-	inline GridP& operator*(const GridP& left, const GridP& right)
+	private:
+		L _left;
+		R _right;
+		OP _op;
+	};
+
+	//! expr op scalar or, if ScalarLeft, scalar op expr
+	template<class E, class OP, bool ScalarLeft>
+	class GridExprScalar : public GridExpr<GridExprScalar<E, OP, ScalarLeft> >
 	{
-		return scalarMatrixOp(left, right, std::multiplies<float>());
+	public:
+		GridExprScalar(const E& expression, float scalar, OP op)
+			: _e(expression), _scalar(scalar), _op(op) {}
+
+		const GridP& shape() const { return _e.shape(); }
+
+		float value(std::size_t r, std::size_t c) const
+		{
+			return ScalarLeft ? _op(_scalar, _e.value(r, c)) : _op(_e.value(r, c), _scalar);
+		}
+
+		void andNoDataMask(NoDataMask& mask) const { _e.andNoDataMask(mask); }
+
+	private:
+		E _e;
+		float _scalar;
+		OP _op;
+	};
+
+	//! GridP and expressions can be operands, GridPs are wrapped into leafs
+	template<class T>
+	struct GridOperand
+	{
+		static const bool isOperand = std::is_base_of<GridExprBase, T>::value;
+		typedef T type;
+		static const T& get(const T& e) { return e; }
+	};
+
+	template<>
+	struct GridOperand<GridP>
+	{
+		static const bool isOperand = true;
+		typedef GridExprLeaf type;
+		static GridExprLeaf get(const GridP& g) { return GridExprLeaf(g); }
+	};
+
+#define GRIDP_EXPR_OPERATOR(OPERATOR, FUNCTOR) \
+	template<class L, class R> \
+	typename std::enable_if<GridOperand<L>::isOperand && GridOperand<R>::isOperand, \
+		GridExprBinary<typename GridOperand<L>::type, typename GridOperand<R>::type, FUNCTOR > >::type \
+	OPERATOR(const L& left, const R& right) \
+	{ \
+		return GridExprBinary<typename GridOperand<L>::type, typename GridOperand<R>::type, FUNCTOR > \
+			(GridOperand<L>::get(left), GridOperand<R>::get(right), FUNCTOR()); \
+	} \
+	template<class L> \
+	typename std::enable_if<GridOperand<L>::isOperand, \
+		GridExprScalar<typename GridOperand<L>::type, FUNCTOR, false> >::type \
+	OPERATOR(const L& left, float right) \
+	{ \
+		return GridExprScalar<typename GridOperand<L>::type, FUNCTOR, false> \
+			(GridOperand<L>::get(left), right, FUNCTOR()); \
+	} \
+	template<class R> \
+	typename std::enable_if<GridOperand<R>::isOperand, \
+		GridExprScalar<typename GridOperand<R>::type, FUNCTOR, true> >::type \
+	OPERATOR(float left, const R& right) \
+	{ \
+		return GridExprScalar<typename GridOperand<R>::type, FUNCTOR, true> \
+			(GridOperand<R>::get(right), left, FUNCTOR()); \
 	}
 
-	inline GridP& operator-(const GridP& left, const GridP& right)
+	GRIDP_EXPR_OPERATOR(operator+, std::plus<float>)
+	GRIDP_EXPR_OPERATOR(operator-, std::minus<float>)
+	GRIDP_EXPR_OPERATOR(operator*, std::multiplies<float>)
+	GRIDP_EXPR_OPERATOR(operator/, std::divides<float>)
+
+#undef GRIDP_EXPR_OPERATOR
+
+	template<class E>
+	GridP& operator+=(GridP& left, const GridExpr<E>& right)
 	{
-		return scalarMatrixOp(left, right, std::minus<float>());
+		return left = left + right.self();
 	}
 
-	inline GridP& operator+(const GridP& left, const GridP& right)
+	template<class E>
+	GridP& operator*=(GridP& left, const GridExpr<E>& right)
 	{
-		return scalarMatrixOp(left, right, std::plus<float>());
+		return left = left * right.self();
 	}
 
-	inline GridP& operator/(const GridP& left, const GridP& right)
+	//! result of left op right for all cells (no data if one of them is no data)
+	template<class OP>
+	GridP scalarMatrixOp(const GridP& left, const GridP& right, OP op)
 	{
-		return scalarMatrixOp(left, right, std::divides<float>());
+		return GridP(GridExprBinary<GridExprLeaf, GridExprLeaf, OP>
+								 (GridExprLeaf(left), GridExprLeaf(right), op));
 	}
 
 	inline std::vector<double> allDataAsLinearVector(const GridP* g)
@@ -741,13 +1167,15 @@ namespace Grids
 		enum State { eNew, eChanged, eNormal };
 
     GridProxy(Tools::CoordinateSystem cs)// = Tools::GK5_EPSG31469)
-			: modificationTime(0), state(eNormal), coordinateSystem(cs) { }
+			: modificationTime(0), state(eNormal), coordinateSystem(cs), binary(false) { }
+
+		//! @param binaryGrid fn is a binary grid, it's mapped and never goes into the hdf store
 		GridProxy(Tools::CoordinateSystem cs,
 			const std::string& dsn, const std::string& fn,
-			const std::string& ptgrid, time_t modTime = 0)
+			const std::string& ptgrid, time_t modTime = 0, bool binaryGrid = false)
 			: datasetName(dsn), fileName(fn), pathToGrid(ptgrid),
 			modificationTime(modTime), state(eNew),
-			coordinateSystem(cs)
+			coordinateSystem(cs), binary(binaryGrid)
 		{ }
 
 		GridProxy(Tools::CoordinateSystem cs,
@@ -756,7 +1184,7 @@ namespace Grids
 			time_t modTime, State s = eNormal)
 			: datasetName(dsn), fileName(fn), pathToHdf(pthdf),
 			hdfFileName(hfn), modificationTime(modTime), state(s),
-			coordinateSystem(cs)
+			coordinateSystem(cs), binary(false)
 		{}
 
 		~GridProxy(){}
@@ -771,6 +1199,14 @@ namespace Grids
 
 		GridPPtr gridPPtr();
 
+		/*!
+		 * part of the grid, read from hdf on its own if the full grid isn't loaded
+		 * (if that fails the full grid is loaded and cut)
+		 * @return empty pointer if the window is empty (!window.isValid()) or
+		 * not inside the grid (e.g. the grid couldn't be loaded)
+		 */
+		GridPPtr subgridPPtr(const SubData& window);
+
 		//! resets gridproxy which in the end (without references to it) deletes possibly loaded grid
 		void reset(){ g.reset(); }
 
@@ -788,6 +1224,7 @@ namespace Grids
 		time_t modificationTime;
 		State state;
 		Tools::CoordinateSystem coordinateSystem;
+		bool binary; //!< binary grid, loading just maps the file
 	protected:
 		GridPPtr g;
     std::mutex _lockable;
@@ -795,6 +1232,13 @@ namespace Grids
 
   typedef std::shared_ptr<GridProxy> GridProxyPtr;
 
+	/*!
+	 * load the grids of all proxies, ASCII and binary grids in parallel on
+	 * the library thread pool, HDF5 ones one after the other in the calling
+	 * thread (the hdf5 library isn't thread safe)
+	 */
+	void loadGridProxies(const std::vector<GridProxyPtr>& gps);
+
 	//----------------------------------------------------------------------------
 
 #ifndef NO_HDF5
@@ -804,30 +1248,93 @@ namespace Grids
 
 	//------------------------------------------------------------------------------
 	//template implementations
-	//------------------------------------------------------------------------------
 
-	template<typename VT>
-	void GridP::writeAscii(const std::string& pathToAsciiFile) const
+	template<class F>
+	GridP* GridP::transformInPlace(F f, Tools::ExecutionPolicy policy)
 	{
-		std::ofstream fout(pathToAsciiFile);
+		std::shared_ptr<const NoDataMask> mask = noDataMask(policy);
+		grid* g = mutableGrid();
+		std::size_t cs = cols();
+		forRowBlocks(rows(), cs, policy, [&](std::size_t, std::size_t r0, std::size_t r1)
+		{
+			for(std::size_t r = r0; r < r1; r++)
+			{
+				float* row = g->feld[r];
+				maskedUpdate(mask->row(r), cs, row, [row, &f](std::size_t c) { return f(row[c]); });
+			}
+		});
+		return this;
+	}
 
-		Tools::RectCoord rc = lowerLeftCorner();
-		fout << std::fixed <<
-			"ncols         " << cols() << endl <<
-			"nrows         " << rows() << endl <<
-			"xllcorner     " << rc.r << endl <<
-			"yllcorner     " << rc.h << endl <<
-			"cellsize      " << static_cast<VT>(cellSize()) << endl <<
-			"NODATA_value  " << static_cast<VT>(noDataValue()) << endl;
+	template<class E>
+	GridP::GridP(const GridExpr<E>& expression)
+		: _datasetName(expression.self().shape().datasetName()),
+			_descriptiveLabel(expression.self().shape()._descriptiveLabel),
+			_unit(expression.self().shape().unit()),
+			_coordinateSystem(expression.self().shape().coordinateSystem())
+	{
+		evaluate(expression.self());
+	}
+
+	template<class E>
+	GridP& GridP::operator=(const GridExpr<E>& expression)
+	{
+		evaluate(expression.self());
+		return *this;
+	}
 
-    for(std::size_t r = 0, rs = rows(); r < rs; r++)
+	template<class E>
+	void GridP::evaluate(const E& e)
+	{
+		const GridP& shape = e.shape();
+		std::size_t nrows = shape.rows(), ncols = shape.cols();
+		NoDataMask mask(nrows, ncols, true);
+		e.andNoDataMask(mask);
+
+		//cell wise, so this grid can be part of the expression (then it has the right size)
+		const grid* sg = shape.gridPtr();
+		//all cells are overwritten, so shared cells don't need to be copied,
+		//the expression may still read the old ones
+		GridPtr old = _grid;
+		if(!_grid || _shared.load(std::memory_order_relaxed)
+			 || _grid->nrows != nrows || _grid->ncols != ncols)
 		{
-      for(std::size_t c = 0, cs = cols(); c < cs; c++)
-				fout << static_cast<VT>(dataAt(r, c)) << " ";
-			fout << endl;
+			grid* g = new grid(100);
+			g->allocate(nrows, ncols);
+			_grid = GridPtr(g);
+			_shared.store(false, std::memory_order_relaxed);
 		}
+		_grid->xcorner = sg->xcorner;
+		_grid->ycorner = sg->ycorner;
+		_grid->csize = sg->csize;
+		_grid->nodata = sg->nodata;
+
+		float nd = float(_grid->nodata);
+		for(std::size_t r = 0; r < nrows; r++)
+			maskedApply(mask.row(r), ncols, _grid->feld[r], nd,
+									[&e, r](std::size_t c) { return e.value(r, c); });
+
+		invalidateNoDataMask();
+		updateNoDataMask(mask);
+	}
+	//------------------------------------------------------------------------------
 
-		fout.close();
+	template<typename VT>
+	void GridP::writeAscii(const std::string& pathToAsciiFile, int precision) const
+	{
+		std::ostringstream header;
+
+		Tools::RectCoord rc = lowerLeftCorner();
+		header << std::fixed <<
+			"ncols         " << cols() << "\n" <<
+			"nrows         " << rows() << "\n" <<
+			"xllcorner     " << rc.r << "\n" <<
+			"yllcorner     " << rc.h << "\n" <<
+			"cellsize      " << static_cast<VT>(cellSize()) << "\n" <<
+			"NODATA_value  " << static_cast<VT>(noDataValue()) << "\n";
+
+		writeAsciiGrid(pathToAsciiFile, header.str(), _grid->feld, rows(), cols(),
+		               AsciiGridFormat(precision, std::is_integral<VT>::value));
 	}
 
 	template<typename ValueType>
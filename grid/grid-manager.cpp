@@ -18,6 +18,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include <sstream>
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <dirent.h>
@@ -34,6 +35,7 @@ Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
 #include "tools/read-ini.h"
 #include "tools/helper.h"
 #include "grid+.h"
+#include "binary-grid.h"
 
 using namespace Grids;
 using namespace std;
@@ -424,10 +426,11 @@ void GridManager::init(const Path& userSubPath)
 		//	gridsInDir = true;
 		//} else
 		if(dname[0] != '.' && (dname.size() <= 4 ||
-													 dname.rfind(".asc") != dname.length() - 4))
+													 dname.rfind(".asc") != dname.length() - 4)
+			 && !isBinaryGridFile(pathToGrids + "/" + dname))
 		{
 			//filter out files starting with . and all files ending in .asc
-			//so we basically should get folders
+			//and binary grids, so we basically should get folders
 			string folderName(ep->d_name);
 			string pathToFolder =
 				(userSubPath.empty() ? string("") : userSubPath + "/") + folderName;
@@ -971,7 +974,7 @@ GridPPtr GridManager::gridFor(const string& regionName,
           for(GridProxyPtr gp : gps)
           {
 						if(gp->datasetName == datasetName)
-              return createSubgrid(gp->gridPPtr(), subgridMetaData);
+              return createSubgrid(gp, gmd, subgridMetaData);
 					}
 				}
 			}
@@ -990,13 +993,8 @@ GridPPtr GridManager::createSubgrid(GridPPtr g, GridMetaData subgridMetaData,
   if(subgridMetaData.isValid() && gmd != subgridMetaData)
   {
 		RCRect r = gmd.rcRect().intersected(subgridMetaData.rcRect());
-    auto tlRowCol = g->rc2rowCol(r.tl);
-    auto brRowCol = g->rc2rowCol(r.br);
-    int top = tlRowCol.row;
-    int left = tlRowCol.col;
-    int rows = brRowCol.row - tlRowCol.row;
-    int cols = brRowCol.col - tlRowCol.col;
-		res = GridPPtr(g->subGridClone(top, left, rows, cols));
+		SubData w = subDataInGrid(gmd, r);
+		res = GridPPtr(g->subGridClone(w.row, w.col, w.rows, w.cols));
   }
   else
   {
@@ -1006,6 +1004,16 @@ GridPPtr GridManager::createSubgrid(GridPPtr g, GridMetaData subgridMetaData,
 	return res;
 }
 
+GridPPtr GridManager::createSubgrid(GridProxyPtr gp, const GridMetaData& gmd,
+                                    GridMetaData subgridMetaData)
+{
+  if(!subgridMetaData.isValid() || gmd == subgridMetaData)
+    return gp->gridPPtr();
+
+	RCRect r = gmd.rcRect().intersected(subgridMetaData.rcRect());
+	return gp->subgridPPtr(subDataInGrid(gmd, r));
+}
+
 vector<GridPPtr> GridManager::gridsFor(const string& regionName,
                                        set<string> datasetNames,
 																			 const Path& userSubPath,
@@ -1026,14 +1034,26 @@ vector<GridPPtr> GridManager::gridsFor(const string& regionName,
 				GMD2GPS::const_iterator ci2 = ci->second.find(gmd);
         if(ci2 != ci->second.end())
         {
-					const GridProxies& gps = ci2->second;
-          for(GridProxyPtr gp : gps)
+					GridProxies selected;
+          for(GridProxyPtr gp : ci2->second)
           {
             //in case of empty dataset names we interpret this as return all grids
             if(datasetNames.find(gp->datasetName) != datasetNames.end() ||
                datasetNames.empty())
-              res.push_back(createSubgrid(gp->gridPPtr(), subgridMetaData));
+              selected.push_back(gp);
 					}
+
+					//full grids are needed, so load them all at once
+					if(!subgridMetaData.isValid() || gmd == subgridMetaData)
+						loadGridProxies(selected);
+
+          for(GridProxyPtr gp : selected)
+          {
+            //grids without a part inside subgridMetaData are left out
+            GridPPtr sg = createSubgrid(gp, gmd, subgridMetaData);
+            if(sg)
+              res.push_back(sg);
+          }
 				}
 			}
 			break;
@@ -1099,9 +1119,11 @@ void GridManager::checkAndUpdateHdfStore(const Path& userSubPath)
 	while((ep = readdir(dp)))
 	{
 		//filter out files starting with . and all files have to end with .asc
+		//or be binary grids (recognized by their header, not the name)
 		string dname(ep->d_name);
-    if(dname.size() > 4 && dname[0] != '.' &&
-       dname.rfind(".asc") == dname.length()-4)
+    if(dname.size() > 0 && dname[0] != '.' &&
+       ((dname.size() > 4 && dname.rfind(".asc") == dname.length()-4)
+        || isBinaryGridFile(pathToAsciiGrids + "/" + dname)))
     {
 			string gridFileName(ep->d_name);
 			string pathToGridFile = pathToAsciiGrids + "/" + gridFileName;
@@ -1168,6 +1190,7 @@ GridManager::addNewGridProxy(const Path& userSubPath,
   if(!cs2.isValid() && fileNameCS.isValid())
     cs2 = fileNameCS;
 
+  bool binary = isBinaryGridFile(pathToGridFile);
   GridMetaData gmd = extractMetadataFromGrid(pathToGridFile, cs2);
 	gmd.regionName = extractRegionName(gridFileName);
 //  if(gmd.regionName.substr(0, 6) == "brazil")
@@ -1178,7 +1201,8 @@ GridManager::addNewGridProxy(const Path& userSubPath,
 	if(gmd.isValid())
   {
 		GridProxyPtr gp = GridProxyPtr(new GridProxy(gmd.coordinateSystem,
-																								 dsn, gridFileName, ptg, modTime));
+																								 dsn, gridFileName, ptg, modTime,
+																								 binary));
 
 		//cout << "gp: " << gp->toString() << endl;
 		//if this is a completely new gmd, then there will be no hdf-name in the map
@@ -1195,8 +1219,35 @@ GridManager::addNewGridProxy(const Path& userSubPath,
 GridMetaData GridManager::
 extractMetadataFromGrid(const string& pathToGridFile, CoordinateSystem cs) const
 {
-	ifstream fin(pathToGridFile.c_str());
 	GridMetaData gmd(cs);
+
+	//binary grids have everything in their header, without a coordinate system
+	//from outside the one stored in the header is used
+	if(isBinaryGridFile(pathToGridFile))
+	{
+		BinaryGridHeader h;
+		string error;
+		if(!readBinaryGridHeader(pathToGridFile, h, &error))
+		{
+			cout << "ignoring binary grid: " << pathToGridFile << " (" << error << ")" << endl;
+			return gmd;
+		}
+		gmd.ncols = int(h.ncols);
+		gmd.nrows = int(h.nrows);
+		gmd.xllcorner = int(h.xllcorner);
+		gmd.yllcorner = int(h.yllcorner);
+		gmd.cellsize = int(h.cellsize);
+		gmd.nodata = int(h.nodata);
+		if(!cs.isValid())
+			gmd.coordinateSystem =
+				shortStringToCoordinateSystem(string(h.coordinateSystem,
+																						 strnlen(h.coordinateSystem,
+																										 sizeof(h.coordinateSystem))),
+																			cs);
+		return gmd;
+	}
+
+	ifstream fin(pathToGridFile.c_str());
   if(fin)
   {
 		string temp;
@@ -1250,6 +1301,13 @@ void GridManager::updateHdfStore(const Path& userSubPath,
   {
 		GridProxies toBeDeletedFromHDF;
 		GridProxies& gps = p.second;
+		//binary grids are mapped from where they are, they never go into the
+		//hdf store, so take them out while the store is updated
+		GridProxies::iterator bi =
+			stable_partition(gps.begin(), gps.end(),
+											 [](GridProxyPtr gp){ return !gp->binary; });
+		GridProxies binaries(bi, gps.end());
+		gps.erase(bi, gps.end());
 //		cout << "region in userSubPath: " << userSubPath << " with gmd: " << p.first.toString() << endl;
 		GridProxies onlyAppends;
 		bool update = false; //is a grid new or has changed ?
@@ -1316,11 +1374,7 @@ void GridManager::updateHdfStore(const Path& userSubPath,
 				if(onlyAppends.size() == gps.size()){ //all are new
 					//reach for the underlying grid of every proxy in order to load it
 					//and be able to store it anew in the hdf-file
-					//for_each(gps.begin(), gps.end(), [](GridProxyPtr gp){ gp->gridPtr(); });
-          for(GridProxyPtr gp : gps)
-					{
-					  gp->gridPtr();
-					}
+					loadGridProxies(gps);
 
 					ostringstream s; s << ++hdfIdCount(userSubPath) << ".h5";
 					//try to delete the new file first, so we
@@ -1336,11 +1390,7 @@ void GridManager::updateHdfStore(const Path& userSubPath,
       {
 				//reach for the underlying grid of every proxy in order to load it
 				//and be able to store it anew in the hdf-file
-				//for_each(gps.begin(), gps.end(), [](GridProxyPtr gp){ gp->gridPtr(); });
-        for(GridProxyPtr gp : gps)
-				{
-				  gp->gridPtr();
-				}
+				loadGridProxies(gps);
 
 				if(remove((pathToHdfs + "/" + hdfFileName).c_str()) != 0)
 				{
@@ -1374,6 +1424,8 @@ void GridManager::updateHdfStore(const Path& userSubPath,
 //							 [](GridProxyPtr gp){ cout << endl << gp->toString(); });
 //			cout << "--------------------------" << endl;
 		}
+
+		gps.insert(gps.end(), binaries.begin(), binaries.end());
 	}
 
 	if(somethingChanged)
@@ -1678,7 +1730,8 @@ void GridManager::writeGrid2HdfMappingFile(const Path& userSubPath)
         {
 					//cout << "gfn: " << gp->fileName
 					//	<< " hfn: " << gp->hdfFileName << endl;
-					fout << gp->fileName << " = " << gp->hdfFileName << endl;
+					if(!gp->binary)
+						fout << gp->fileName << " = " << gp->hdfFileName << endl;
 				}
 			}
 		}
@@ -453,12 +453,24 @@ namespace Grids
 		GridMetaData gridMetaDataForRegionName(const std::string& regionName,
 																					 const Path& userSubPath = "general");
 
+		/*!
+		 * grid of dataset datasetName in region regionName
+		 * @param subgridMetaData if valid only the part of the grid inside it
+		 * @return empty pointer if there is no such grid, subgridMetaData
+		 * doesn't cover at least one full row and column of it or the grid
+		 * can't be read
+		 */
 		GridPPtr gridFor(const std::string& regionName,
 										 const std::string& datasetName,
 										 const Path& userSubPath = "general",
 										 int cellSize = 100,
 										 GridMetaData subgridMetaData = GridMetaData());
 
+		/*!
+		 * like gridFor for several datasets (all if datasetNames is empty),
+		 * grids gridFor would return an empty pointer for are left out, so the
+		 * result never contains empty pointers but can be shorter than datasetNames
+		 */
 		std::vector<GridPPtr> gridsFor(const std::string& regionName,
                                    std::set<std::string> datasetNames = std::set<std::string>(),
 																	 const Path& userSubPath = "general",
@@ -563,6 +575,13 @@ namespace Grids
 		GridPPtr createSubgrid(GridPPtr g, GridMetaData subgridMetaData,
 													 bool alwaysClone = false);
 
+		/*!
+		 * like above, but reads only the needed part if the proxy's grid isn't loaded
+		 * @return empty pointer if the window in the grid is empty
+		 */
+		GridPPtr createSubgrid(GridProxyPtr gp, const GridMetaData& gmd,
+		                       GridMetaData subgridMetaData);
+
 	private: //state
 		Env _env;
 
@@ -0,0 +1,670 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef GRID_T_H_
+#define GRID_T_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <stdint.h>
+
+#include "grid.h"
+#include "ascii-grid-io.h"
+#include "binary-grid.h"
+#include "mapped-file.h"
+#include "nodata-mask.h"
+
+/*
+Grids whose cell type is chosen at construction. grid/GridP store every
+raster as float, which is four times the memory class grids (cluster ids,
+flow directions 1..128, soil codes) need. GridT keeps its type in memory and
+on disk; the algorithms working on float grids get an explicit copy via
+toGrid() or GridP(const GridT<T>&, ...).
+*/
+
+namespace Grids
+{
+	//! properties of the possible cell types of GridT
+	template<typename T>
+	struct GridValueTraits;
+
+	template<>
+	struct GridValueTraits<uint8_t>
+	{
+		static BinaryGridType binaryType() { return eBinaryUInt8; }
+#ifndef NO_HDF5
+		static hid_t hdfType() { return H5T_NATIVE_UINT8; }
+#endif
+		static uint8_t defaultNoData() { return 255; }
+		//! read ASCII values with the exact double parser
+		static bool parseAsDouble() { return false; }
+	};
+
+	template<>
+	struct GridValueTraits<int16_t>
+	{
+		static BinaryGridType binaryType() { return eBinaryInt16; }
+#ifndef NO_HDF5
+		static hid_t hdfType() { return H5T_NATIVE_INT16; }
+#endif
+		static int16_t defaultNoData() { return -9999; }
+		static bool parseAsDouble() { return false; }
+	};
+
+	template<>
+	struct GridValueTraits<int32_t>
+	{
+		static BinaryGridType binaryType() { return eBinaryInt32; }
+#ifndef NO_HDF5
+		static hid_t hdfType() { return H5T_NATIVE_INT32; }
+#endif
+		static int32_t defaultNoData() { return -9999; }
+		static bool parseAsDouble() { return true; }
+	};
+
+	template<>
+	struct GridValueTraits<float>
+	{
+		static BinaryGridType binaryType() { return eBinaryFloat32; }
+#ifndef NO_HDF5
+		static hid_t hdfType() { return H5T_NATIVE_FLOAT; }
+#endif
+		static float defaultNoData() { return -9999; }
+		static bool parseAsDouble() { return false; }
+	};
+
+	template<>
+	struct GridValueTraits<double>
+	{
+		static BinaryGridType binaryType() { return eBinaryFloat64; }
+#ifndef NO_HDF5
+		static hid_t hdfType() { return H5T_NATIVE_DOUBLE; }
+#endif
+		static double defaultNoData() { return -9999; }
+		static bool parseAsDouble() { return true; }
+	};
+
+	/*!
+	 * convert value to T, integral types are rounded to the nearest
+	 * integer and clamped to the range of T
+	 */
+	template<typename T>
+	T gridValueCast(double value)
+	{
+		if(!std::numeric_limits<T>::is_integer)
+			return T(value);
+		if(value != value)
+			return T(0);
+		double r = std::floor(value + 0.5);
+		if(r <= double(std::numeric_limits<T>::min()))
+			return std::numeric_limits<T>::min();
+		if(r >= double(std::numeric_limits<T>::max()))
+			return std::numeric_limits<T>::max();
+		return T(r);
+	}
+
+	//----------------------------------------------------------------------------
+
+	//! grid with cells of type T (uint8_t, int16_t, int32_t, float, double)
+	template<typename T>
+	class GridT
+	{
+	public:
+		typedef T value_type;
+
+		GridT()
+			: _nrows(0), _ncols(0), _xllcorner(0), _yllcorner(0), _cellSize(0),
+				_noDataValue(GridValueTraits<T>::defaultNoData()) {}
+
+		//! new grid initialized to noDataValue
+		GridT(std::size_t nrows, std::size_t ncols, double cellSize,
+					double xllcorner, double yllcorner,
+					T noDataValue = GridValueTraits<T>::defaultNoData())
+			: _nrows(nrows), _ncols(ncols), _xllcorner(xllcorner), _yllcorner(yllcorner),
+				_cellSize(cellSize), _noDataValue(noDataValue), _data(nrows*ncols, noDataValue) {}
+
+		/*!
+		 * explicit conversion of a float grid, the no data cells (int(v) == g.nodata)
+		 * get noDataValue, other cells never become noDataValue by the conversion
+		 */
+		explicit GridT(const grid& g, T noDataValue = GridValueTraits<T>::defaultNoData());
+
+		//! float copy for the algorithms of grid/GridP (caller owns it)
+		grid* toGrid() const;
+
+		//! copy with cells converted to U
+		template<typename U>
+		GridT<U> convert(U noDataValue = GridValueTraits<U>::defaultNoData()) const;
+
+		bool isValid() const { return _nrows > 0 && _ncols > 0; }
+
+		std::size_t rows() const { return _nrows; }
+		std::size_t cols() const { return _ncols; }
+		std::size_t size() const { return _data.size(); }
+		double xllcorner() const { return _xllcorner; }
+		double yllcorner() const { return _yllcorner; }
+		double cellSize() const { return _cellSize; }
+		T noDataValue() const { return _noDataValue; }
+
+		void setCorner(double xllcorner, double yllcorner)
+		{
+			_xllcorner = xllcorner;
+			_yllcorner = yllcorner;
+		}
+		void setCellSize(double cellSize) { _cellSize = cellSize; }
+		void setNoDataValue(T value) { _noDataValue = value; }
+
+		bool isNoDataValue(T value) const { return value == _noDataValue; }
+
+		//! first cell of row 0, rows are contiguous
+		T* data() { return _data.empty() ? NULL : &_data[0]; }
+		const T* data() const { return _data.empty() ? NULL : &_data[0]; }
+
+		T* row(std::size_t r) { return &_data[r*_ncols]; }
+		const T* row(std::size_t r) const { return &_data[r*_ncols]; }
+
+		T& at(std::size_t r, std::size_t c) { return _data[r*_ncols + c]; }
+		T at(std::size_t r, std::size_t c) const { return _data[r*_ncols + c]; }
+
+		//! number of cells per value
+		std::map<T, std::size_t> frequency(bool includeNoDataValues = false) const;
+
+		std::set<T> uniqueValues(bool includeNoDataValues = false) const;
+
+		/*!
+		 * read ESRI ASCII grid, returns AsciiGridResult
+		 * if T can't hold the file's nodata (e.g. -9999 into uint8_t) the nodata
+		 * value becomes GridValueTraits<T>::defaultNoData(), other values are
+		 * rounded/clamped but never turned into nodata (same for readBinary/readHdf)
+		 */
+		int readAscii(const std::string& pathToFile);
+
+		/*!
+		 * write as ESRI ASCII grid, integral types are written as integers
+		 * @param precision for float/double as AsciiGridFormat::precision
+		 */
+		bool writeAscii(const std::string& pathToFile,
+										int precision = AsciiGridFormat::shortest) const;
+
+		//! read binary grid (any stored type is converted to T), see readBinaryGrid
+		int readBinary(const std::string& pathToFile, std::string* coordinateSystemShort = NULL);
+
+		//! write binary grid with cells of type T
+		bool writeBinary(const std::string& pathToFile,
+										 const std::string& coordinateSystemShort = std::string()) const;
+
+#ifndef NO_HDF5
+		//! read the dataset, hdf converts the stored type to T
+		int readHdf(const std::string& pathToHdfFile, const std::string& datasetName,
+								std::string* coordinateSystemShort = NULL);
+
+		//! write dataset with cells of type T and the attributes of GridP::writeHdf
+		bool writeHdf(const std::string& pathToHdfFile, const std::string& datasetName,
+									const std::string& coordinateSystemShort,
+									const std::string& regionName = std::string(),
+									time_t t = time(NULL)) const;
+#endif
+
+	private:
+		bool resize(std::size_t nrows, std::size_t ncols);
+
+		std::size_t _nrows, _ncols;
+		double _xllcorner, _yllcorner;
+		double _cellSize;
+		T _noDataValue;
+		std::vector<T> _data;
+	};
+
+	typedef GridT<uint8_t> GridU8;
+	typedef GridT<int16_t> GridI16;
+	typedef GridT<int32_t> GridI32;
+	typedef GridT<float> GridF;
+	typedef GridT<double> GridD;
+
+	//----------------------------------------------------------------------------
+	//template implementations
+
+	namespace GridTDetail
+	{
+		/*!
+		 * nodata value of T for a file's nodata: the file's value if T holds it
+		 * exactly, else the type's default (e.g. -9999 read into uint8_t)
+		 */
+		template<typename T>
+		T noDataFor(double fileNoData)
+		{
+			T v = gridValueCast<T>(fileNoData);
+			return !std::numeric_limits<T>::is_integer || double(v) == fileNoData
+				? v : GridValueTraits<T>::defaultNoData();
+		}
+
+		/*!
+		 * convert a raw file value, the file's nodata is compared before the cast,
+		 * other values are cast and moved off noData if rounding/clamping hit it
+		 */
+		template<typename T>
+		T cellValue(double raw, double fileNoData, T noData)
+		{
+			if(raw == fileNoData)
+				return noData;
+			T v = gridValueCast<T>(raw);
+			if(!std::numeric_limits<T>::is_integer || v != noData)
+				return v;
+			if(noData == std::numeric_limits<T>::max())
+				return T(noData - 1);
+			if(noData == std::numeric_limits<T>::min())
+				return T(noData + 1);
+			return raw < double(noData) ? T(noData - 1) : T(noData + 1);
+		}
+
+		//! parse one value at p (no leading whitespace) with the ascii grid parser
+		inline const char* parseRaw(const char* p, const char* end, double& value, bool exact)
+		{
+			if(exact)
+				return parseAsciiDouble(p, end, value);
+			float v;
+			p = parseAsciiFloat(p, end, v);
+			value = v;
+			return p;
+		}
+
+		inline std::size_t formatValue(char* out, float value, AsciiGridFormat format)
+		{
+			return formatAsciiValue(out, value, format);
+		}
+
+		inline std::size_t formatValue(char* out, double value, AsciiGridFormat format)
+		{
+			//out has room for 64 chars
+			int n = format.precision == AsciiGridFormat::shortest
+				? snprintf(out, 64, "%.17g", value)
+				: snprintf(out, 64, "%.*f", format.precision, value);
+			return n < 0 ? 0 : std::min(std::size_t(n), std::size_t(63));
+		}
+
+		template<typename Integral>
+		std::size_t formatValue(char* out, Integral value, AsciiGridFormat)
+		{
+			char buf[16];
+			std::size_t n = 0;
+			long long v = value;
+			bool neg = v < 0;
+			unsigned long long u = neg ? 0ULL - (unsigned long long)v : (unsigned long long)v;
+			do { buf[n++] = char('0' + u % 10); u /= 10; } while(u);
+			std::size_t len = 0;
+			if(neg)
+				out[len++] = '-';
+			while(n)
+				out[len++] = buf[--n];
+			return len;
+		}
+
+		template<typename To, typename From>
+		void convertCells(const char* from, std::size_t n, To* to, double fileNoData, To noData)
+		{
+			const From* f = reinterpret_cast<const From*>(from);
+			//compare in the precision the cells are stored in
+			if(!std::numeric_limits<From>::is_integer)
+				fileNoData = double(From(fileNoData));
+			for(std::size_t i = 0; i < n; i++)
+				to[i] = cellValue<To>(double(f[i]), fileNoData, noData);
+		}
+	}
+
+	template<typename T>
+	bool GridT<T>::resize(std::size_t nrows, std::size_t ncols)
+	{
+		try
+		{
+			std::vector<T>(nrows*ncols).swap(_data);
+		}
+		catch(std::bad_alloc&)
+		{
+			std::cerr << "error (GridT): no sufficient memory for "
+								<< nrows << "x" << ncols << " grid" << std::endl;
+			_nrows = _ncols = 0;
+			return false;
+		}
+		_nrows = nrows;
+		_ncols = ncols;
+		return true;
+	}
+
+	template<typename T>
+	GridT<T>::GridT(const grid& g, T noDataValue)
+		: _nrows(0), _ncols(0), _xllcorner(g.xcorner), _yllcorner(g.ycorner),
+			_cellSize(g.csize), _noDataValue(noDataValue)
+	{
+		if(!resize(g.nrows, g.ncols))
+			return;
+		for(std::size_t i = 0; i < _nrows; i++)
+		{
+			const float* from = g.feld[i];
+			T* to = row(i);
+			for(std::size_t j = 0; j < _ncols; j++)
+				to[j] = Grids::isNoDataValue(from[j], g.nodata)
+					? noDataValue : GridTDetail::cellValue<T>(from[j], g.nodata, noDataValue);
+		}
+	}
+
+	template<typename T>
+	grid* GridT<T>::toGrid() const
+	{
+		grid* g = new grid(100);
+		g->xcorner = _xllcorner;
+		g->ycorner = _yllcorner;
+		g->csize = float(_cellSize);
+		g->nodata = int(_noDataValue);
+		if(!g->allocate(_nrows, _ncols))
+			return g;
+		for(std::size_t i = 0; i < _nrows; i++)
+		{
+			const T* from = row(i);
+			float* to = g->feld[i];
+			for(std::size_t j = 0; j < _ncols; j++)
+				to[j] = from[j] == _noDataValue ? float(g->nodata) : float(from[j]);
+		}
+		return g;
+	}
+
+	template<typename T>
+	template<typename U>
+	GridT<U> GridT<T>::convert(U noDataValue) const
+	{
+		GridT<U> g(_nrows, _ncols, _cellSize, _xllcorner, _yllcorner, noDataValue);
+		const T* from = data();
+		U* to = g.data();
+		for(std::size_t k = 0, n = size(); k < n; k++)
+			to[k] = from[k] == _noDataValue ? noDataValue : gridValueCast<U>(double(from[k]));
+		return g;
+	}
+
+	template<typename T>
+	std::map<T, std::size_t> GridT<T>::frequency(bool includeNoDataValues) const
+	{
+		std::map<T, std::size_t> res;
+		const T* d = data();
+		std::size_t n = size();
+		if(std::numeric_limits<T>::is_integer && sizeof(T) <= 2)
+		{
+			//small value range, count into a table instead of the map
+			const std::size_t offset = std::numeric_limits<T>::is_signed ? std::size_t(1) << (8*sizeof(T) - 1) : 0;
+			std::vector<std::size_t> counts(std::size_t(1) << (8*sizeof(T)), 0);
+			for(std::size_t k = 0; k < n; k++)
+				counts[std::size_t(long(d[k]) + long(offset))]++;
+			for(std::size_t i = 0; i < counts.size(); i++)
+				if(counts[i] > 0)
+					res[T(long(i) - long(offset))] = counts[i];
+		}
+		else
+		{
+			for(std::size_t k = 0; k < n; k++)
+				res[d[k]]++;
+		}
+		if(!includeNoDataValues)
+			res.erase(_noDataValue);
+		return res;
+	}
+
+	template<typename T>
+	std::set<T> GridT<T>::uniqueValues(bool includeNoDataValues) const
+	{
+		std::map<T, std::size_t> f = frequency(includeNoDataValues);
+		std::set<T> res;
+		for(typename std::map<T, std::size_t>::const_iterator ci = f.begin(); ci != f.end(); ++ci)
+			res.insert(res.end(), ci->first);
+		return res;
+	}
+
+	template<typename T>
+	int GridT<T>::readAscii(const std::string& pathToFile)
+	{
+		MappedFile file(pathToFile);
+		if(!file.isOpen())
+		{
+			std::cerr << "error (readAscii): can not open inputfile: " << pathToFile << std::endl;
+			return eAsciiGridCantOpen;
+		}
+
+		const char* p = file.data();
+		const char* end = p + file.size();
+		AsciiGridHeader h;
+		std::string error;
+		if(!parseAsciiGridHeader(p, end, h, error))
+		{
+			std::cerr << "error (readAscii): " << error << ": " << pathToFile << std::endl;
+			return eAsciiGridBadHeader;
+		}
+		if(!resize(h.nrows, h.ncols))
+			return eAsciiGridNoMemory;
+		_xllcorner = h.xllcorner;
+		_yllcorner = h.yllcorner;
+		_cellSize = h.cellsize;
+		_noDataValue = GridTDetail::noDataFor<T>(h.nodata);
+
+		//the file's nodata as parsed in the same precision as the cells
+		const bool exact = GridValueTraits<T>::parseAsDouble();
+		const double fileNoData = exact ? h.nodata : double(float(h.nodata));
+		T* d = data();
+		for(std::size_t k = 0, n = size(); k < n; k++)
+		{
+			double v;
+			p = skipAsciiSpace(p, end);
+			p = p < end ? GridTDetail::parseRaw(p, end, v, exact) : NULL;
+			if(p)
+				d[k] = GridTDetail::cellValue<T>(v, fileNoData, _noDataValue);
+			else
+			{
+				std::cerr << "error (readAscii): invalid or missing value " << k
+									<< ": " << pathToFile << std::endl;
+				return eAsciiGridBadData;
+			}
+		}
+		return eAsciiGridOk;
+	}
+
+	template<typename T>
+	bool GridT<T>::writeAscii(const std::string& pathToFile, int precision) const
+	{
+		FILE* fp = fopen(pathToFile.c_str(), "w");
+		if(!fp)
+		{
+			std::cerr << "error (writeAscii): can not open outputfile: " << pathToFile << std::endl;
+			return false;
+		}
+
+		AsciiGridHeader h;
+		h.ncols = _ncols;
+		h.nrows = _nrows;
+		h.xllcorner = _xllcorner;
+		h.yllcorner = _yllcorner;
+		h.cellsize = _cellSize;
+		h.nodata = double(_noDataValue);
+		std::string header = formatAsciiGridHeader(h);
+		bool ok = fwrite(header.data(), 1, header.size(), fp) == header.size();
+
+		AsciiGridFormat format(precision, std::numeric_limits<T>::is_integer);
+		std::vector<char> buf(_ncols*64 + 1);
+		for(std::size_t i = 0; ok && i < _nrows; i++)
+		{
+			const T* r = row(i);
+			std::size_t len = 0;
+			for(std::size_t j = 0; j < _ncols; j++)
+			{
+				if(j > 0)
+					buf[len++] = ' ';
+				len += GridTDetail::formatValue(&buf[len], r[j], format);
+			}
+			buf[len++] = '\n';
+			ok = fwrite(&buf[0], 1, len, fp) == len;
+		}
+		if(fclose(fp) != 0)
+			ok = false;
+		if(!ok)
+			std::cerr << "error (writeAscii): could not write: " << pathToFile << std::endl;
+		return ok;
+	}
+
+	template<typename T>
+	int GridT<T>::readBinary(const std::string& pathToFile, std::string* coordinateSystemShort)
+	{
+		MappedFile file(pathToFile);
+		BinaryGridHeader h;
+		std::string error;
+		const char* cells = binaryGridCells(file, h, error);
+		if(!cells)
+		{
+			std::cerr << "error (readBinary): " << error << ": " << pathToFile << std::endl;
+			return file.isOpen() ? eAsciiGridBadHeader : eAsciiGridCantOpen;
+		}
+		if(!resize(std::size_t(h.nrows), std::size_t(h.ncols)))
+			return eAsciiGridNoMemory;
+		_xllcorner = h.xllcorner;
+		_yllcorner = h.yllcorner;
+		_cellSize = h.cellsize;
+		_noDataValue = GridTDetail::noDataFor<T>(h.nodata);
+		if(coordinateSystemShort)
+			*coordinateSystemShort = std::string(h.coordinateSystem,
+																					 strnlen(h.coordinateSystem, sizeof(h.coordinateSystem)));
+
+		T* d = data();
+		std::size_t n = size();
+		if(h.dataType == uint32_t(GridValueTraits<T>::binaryType())
+			 && (!std::numeric_limits<T>::is_integer || double(_noDataValue) == h.nodata))
+		{
+			if(n > 0)
+				memcpy(d, cells, n*sizeof(T));
+			return eAsciiGridOk;
+		}
+		switch(h.dataType)
+		{
+		case eBinaryFloat32: GridTDetail::convertCells<T, float>(cells, n, d, h.nodata, _noDataValue); break;
+		case eBinaryFloat64: GridTDetail::convertCells<T, double>(cells, n, d, h.nodata, _noDataValue); break;
+		case eBinaryInt32: GridTDetail::convertCells<T, int32_t>(cells, n, d, h.nodata, _noDataValue); break;
+		case eBinaryInt16: GridTDetail::convertCells<T, int16_t>(cells, n, d, h.nodata, _noDataValue); break;
+		case eBinaryUInt8: GridTDetail::convertCells<T, uint8_t>(cells, n, d, h.nodata, _noDataValue); break;
+		}
+		return eAsciiGridOk;
+	}
+
+	template<typename T>
+	bool GridT<T>::writeBinary(const std::string& pathToFile,
+														 const std::string& coordinateSystemShort) const
+	{
+		BinaryGridHeader h;
+		initBinaryGridHeader(h, GridValueTraits<T>::binaryType());
+		h.ncols = _ncols;
+		h.nrows = _nrows;
+		h.xllcorner = _xllcorner;
+		h.yllcorner = _yllcorner;
+		h.cellsize = _cellSize;
+		h.nodata = double(_noDataValue);
+		strncpy(h.coordinateSystem, coordinateSystemShort.c_str(), sizeof(h.coordinateSystem) - 1);
+		return writeBinaryGridData(pathToFile, h, data());
+	}
+
+#ifndef NO_HDF5
+	template<typename T>
+	int GridT<T>::readHdf(const std::string& pathToHdfFile, const std::string& datasetName,
+												std::string* coordinateSystemShort)
+	{
+		hdf5 hd;
+		if(hd.open_f(pathToHdfFile.c_str()) != 0)
+		{
+			std::cerr << "error (readHdf): can not open hdf_file: " << pathToHdfFile << std::endl;
+			return -1;
+		}
+		if(hd.open_d(datasetName.c_str()) != 0)
+		{
+			std::cerr << "error (readHdf): can not open dataset: " << datasetName << std::endl;
+			return -2;
+		}
+		std::size_t nrows = hd.get_i_attribute("nrows");
+		std::size_t ncols = hd.get_i_attribute("ncols");
+		if(!resize(nrows, ncols))
+			return -3;
+		int fileNoData = hd.get_i_attribute("nodata");
+		_noDataValue = GridTDetail::noDataFor<T>(fileNoData);
+		_xllcorner = hd.get_d_attribute("xllcorner");
+		_yllcorner = hd.get_d_attribute("yllcorner");
+		_cellSize = hd.get_f_attribute("cell-size");
+		if(coordinateSystemShort)
+		{
+			char* cs = hd.get_s_attribute("coordinate-system");
+			*coordinateSystemShort = cs ? cs : "";
+			free(cs);
+		}
+		if(size() == 0)
+			return 0;
+		if(double(_noDataValue) == fileNoData)
+		{
+			if(hd.read_feld(datasetName.c_str(), GridValueTraits<T>::hdfType(), data(), size()) != 0)
+			{
+				std::cerr << "error (readHdf): can not read dataset: " << datasetName << std::endl;
+				return -2;
+			}
+			return 0;
+		}
+
+		//T can't hold the file's nodata, read raw values to tell them apart
+		std::vector<double> raw(size());
+		if(hd.read_feld(datasetName.c_str(), H5T_NATIVE_DOUBLE, &raw[0], raw.size()) != 0)
+		{
+			std::cerr << "error (readHdf): can not read dataset: " << datasetName << std::endl;
+			return -2;
+		}
+		GridTDetail::convertCells<T, double>(reinterpret_cast<const char*>(&raw[0]), raw.size(),
+																				 data(), fileNoData, _noDataValue);
+		return 0;
+	}
+
+	template<typename T>
+	bool GridT<T>::writeHdf(const std::string& pathToHdfFile, const std::string& datasetName,
+													const std::string& coordinateSystemShort,
+													const std::string& regionName, time_t t) const
+	{
+		hdf5 hd;
+		if(hd.open_f(pathToHdfFile.c_str()) != 0)
+			hd.create_f(pathToHdfFile.c_str());
+		if(hd.open_d(datasetName.c_str()) == 0)
+			return false;
+		hd.write_feld(datasetName.c_str(), GridValueTraits<T>::hdfType(), data(),
+									int(_nrows), int(_ncols));
+		hd.write_s_attribute("coordinate-system", coordinateSystemShort.c_str());
+		hd.write_s_attribute("region-name", regionName.c_str());
+		hd.write_l_attribute("time", t);
+		hd.write_d_attribute("xllcorner", _xllcorner);
+		hd.write_d_attribute("yllcorner", _yllcorner);
+		hd.write_f_attribute("cell-size", float(_cellSize));
+		hd.write_i_attribute("nodata", int(_noDataValue));
+		hd.write_i_attribute("ncols", int(_ncols));
+		hd.write_i_attribute("nrows", int(_nrows));
+		return true;
+	}
+#endif
+}
+
+#endif
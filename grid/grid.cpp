@@ -26,6 +26,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdio>
 #include <cstring>
+#ifdef WIN32
+#include <malloc.h>
+#endif
 //#include <gsl/gsl_linalg.h>
 //#include <gsl/gsl_vector.h>
 //#include <gsl/gsl_matrix.h>
@@ -34,6 +37,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "platform.h"
 #include "grid.h"
+#include "ascii-grid-io.h"
+#include "binary-grid.h"
+#include "nodata-mask.h"
+#include "neighbourhood.h"
+#include "distance-transform.h"
+#include "viewshed.h"
+#include "hydrology.h"
+#include "components.h"
+#include "point-index.h"
+#include "common/thread-pool.h"
 
 using namespace std;
 using namespace Grids;
@@ -83,7 +96,7 @@ using namespace Grids;
 #define THRESH 100 // Minima of class member
 #define BINS 10
 
-#define MAXSTACK 100000000  // max stacksize for flood fill
+#define MAXSTACK 100000000  // max stacksize for stack2i (veraltet)
 
 #define OD 0
 #define N 1
@@ -101,6 +114,8 @@ using namespace Grids;
 
 #define HIST 20           // fractal
 
+#define FELD_ALIGN 64     // alignment of grid::block (one cache line)
+
 typedef map<int,int> mapType;
 typedef mapType::value_type ValuePair;
 typedef map<int,double> doubleMap;
@@ -114,10 +129,34 @@ int dcompare(const void* e1, const void* e2)
 }
 
 
+// aligned block for grid::feld, released with free_feld_block
+static float* alloc_feld_block(size_t n)
+{
+	void* p=NULL;
+#ifdef WIN32
+	p=_aligned_malloc(n*sizeof(float),FELD_ALIGN);
+#else
+	if(posix_memalign(&p,FELD_ALIGN,n*sizeof(float))!=0) p=NULL;
+#endif
+	return (float*)p;
+}
+
+static void free_feld_block(float* p)
+{
+#ifdef WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
 grid::grid(int rg)
 {
 	rgr = rg;       // setze Rastergroesse
 	feld=(float**)NULL;
+	block=(float*)NULL;
+	block_free=NULL;
+	block_owner=NULL;
 	has_nodata = UNKNOWN;
   nrows = 0;
   ncols = 0;
@@ -128,38 +167,90 @@ grid::grid(int rows, int cols)
 	rgr = 1;       // setze Rastergroesse
 	has_nodata = UNKNOWN;
 	variance1=variance2=covariance=0.0;
-	nrows=rows;
-	ncols=cols;
 	csize=1.0;
 	nodata=-9999;
 	xcorner=ycorner=0.0;
-	feld= new float*[nrows];
-	//   cerr << nrows << " " << ncols << " feld=" << feld << endl;
-	if(feld==NULL)
-		cerr << "no sufficient memory" << endl;
-	for(int i=0; i<nrows; i++){
-		if((feld[i]= new float[ncols])==NULL){
-			cerr << "no sufficient memory" << endl;
-		}
-		//	cerr << "feld[" << i << "]=" << feld[i] << endl;
-	}
+	feld=(float**)NULL;
+	block=(float*)NULL;
+	block_free=NULL;
+	block_owner=NULL;
+	allocate(rows,cols);
 	time_t now = time(NULL);
 	srand(now);
-	for(int i=0; i<rows; i++){
-		for(int j=0; j<cols; j++){
-			feld[i][j]=nodata;
-		}
-	}
+	for(size_t k=0; k<nrows*ncols; k++)
+		block[k]=nodata;
 }
 
 grid::~grid()       // Freigabe inneres Feld
+{
+	release();
+}
+
+bool grid::allocate(size_t rows, size_t cols)
+{
+	release();
+	nrows=rows;
+	ncols=cols;
+	if(nrows==0 || ncols==0) return true;
+	block=alloc_feld_block(nrows*stride());
+	feld=new float*[nrows];
+	if(block==NULL){
+		cerr << "error (allocate): no sufficient memory for "
+		     << nrows << "x" << ncols << " grid" << endl;
+		delete [] feld;
+		feld=(float**)NULL;
+		nrows=ncols=0;
+		return false;
+	}
+	for(size_t i=0; i<nrows; i++)
+		feld[i]=block+i*stride();
+	return true;
+}
+
+bool grid::attach(float* data, size_t rows, size_t cols,
+                  void (*free_fn)(void*), void* owner)
+{
+	release();
+	nrows=rows;
+	ncols=cols;
+	block=data;
+	block_free=free_fn;
+	block_owner=owner;
+	if(nrows==0 || ncols==0) return true;
+	feld=new float*[nrows];
+	for(size_t i=0; i<nrows; i++)
+		feld[i]=block+i*stride();
+	return true;
+}
+
+void grid::release()
 {
 	if(feld!=(float**)NULL){
-		for(int i=0; i<nrows; i++){
-			delete [] feld[i];
-		}
+		// rows set up from outside with new float[] are still owned row-wise
+		if(block==(float*)NULL)
+			for(size_t i=0; i<nrows; i++)
+				delete [] feld[i];
 		delete [] feld;
 	}
+	if(block_free!=NULL)
+		block_free(block_owner);
+	else if(block!=(float*)NULL)
+		free_feld_block(block);
+	feld=(float**)NULL;
+	block=(float*)NULL;
+	block_free=NULL;
+	block_owner=NULL;
+}
+
+grid* Grids::gridLike(const grid& g)
+{
+	grid* gx = new grid(int(g.csize));
+	gx->xcorner = g.xcorner;
+	gx->ycorner = g.ycorner;
+	gx->csize = g.csize;
+	gx->nodata = g.nodata;
+	gx->allocate(g.nrows, g.ncols);
+	return gx;
 }
 
 grid* Grids::read_xyz(const char* name,grid* g1)
@@ -253,112 +344,30 @@ grid* Grids::read_xyz(const char* name,grid* g1)
 
 int grid::read_ascii(const char* name)
 {
-	char buf[255];
-	float val1;
-	ifstream file1(name);
-	if(!file1){
-		cerr << "error (read_ascii): can not open inputfile: " << name << endl;
-		file1.close();
-		return(-1);
-	}
-	if(feld!=(float**)NULL){
-		for(int i=0; i<nrows; i++){
-			delete [] feld[i];
-		}
-	}
-	file1 >> buf >> ncols;
-	if(strncmp(buf,"ncols",5)!=0){
-		cerr << "error (read_ascii): not an ASCII-Grid: " << name << endl;
-		file1.close();
-		return(-2);
-	}
-	file1 >> buf >> nrows;
-	file1 >> buf >> xcorner;
-	file1 >> buf >> ycorner;
-	file1 >> buf >> csize;
-	file1 >> buf >> nodata;
-	// allocate memory
-	if(nrows <= 0 || ncols <= 0) return -2;
-	feld= new float*[nrows];
-	for(int i=0; i<nrows; i++){
-		if((feld[i]= new float[ncols])==NULL){
-			cerr << "error (read_ascii): no sufficient memory" << endl;
-		}
-	}
-	// read_in
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			file1 >> val1;
-			feld[i][j]=val1;
-		}
-	}
-	file1.close();
-	return 0;
+	return readAsciiGrid(name,*this,false);
 }
 
 int grid::read_ascii_inv(const char* name)
 {
-	char buf[255];
-	float val1;
-	ifstream file1(name);
-	if(!file1){
-		cerr << "errot (read_ascii): can not open inputfile: " << name << endl;
-		return(-1);
-	}
-	if(feld!=(float**)NULL){
-		for(int i=0; i<nrows; i++){
-			delete [] feld[i];
-		}
-	}
-	file1 >> buf >> ncols;
-	if(strncmp(buf,"ncols",5)!=0){
-		cerr << "error (read_ascii): not a ASCII-Grid: " << name << endl;
-		return(-2);
-	}
-	file1 >> buf >> nrows;
-	file1 >> buf >> xcorner;
-	file1 >> buf >> ycorner;
-	file1 >> buf >> csize;
-	file1 >> buf >> nodata;
-	// allocate memory
-	if(nrows <= 0 || ncols <= 0) return -2;
-	feld= new float*[nrows];
-	for(int i=0; i<nrows; i++){
-		if((feld[i]= new float[ncols])==NULL){
-			cerr << "error (read_ascii): no sufficient memory" << endl;
-		}
-	}
-	// read_in
-	for(int i=nrows-1; i>=0; i--){
-		for(int j=ncols-1; j>=0; j--){
-			file1 >> val1;
-			feld[i][j]=val1;
-		}
-	}
-	file1.close();
-	return 0;
+	return readAsciiGrid(name,*this,true); // y=nrows-y, x=ncols-x
 }
 
 grid* grid::grid_copy()
 {
 	grid* gx = new grid((int)csize);
-	gx->ncols = ncols;
-	gx->nrows = nrows;
 	gx->xcorner = xcorner;
 	gx->ycorner = ycorner;
 	gx->csize = csize;
 	gx->nodata = nodata;
-	gx->feld = new float*[gx->nrows];
-	for(int i=0; i<gx->nrows; i++){
-		if((gx->feld[i]=new float[gx->ncols])==NULL){
-			cerr << "error (grid_copy): no sufficient memory" << endl;
-		}
-	}
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			gx->feld[i][j] = feld[i][j];
-		}
+	if(!gx->allocate(nrows,ncols)){
+		cerr << "error (grid_copy): no sufficient memory" << endl;
+		return gx;
 	}
+	if(block!=(float*)NULL)
+		memcpy(gx->block,block,nrows*stride()*sizeof(float));
+	else
+		for(size_t i=0; i<nrows; i++)
+			memcpy(gx->feld[i],feld[i],ncols*sizeof(float));
 	return gx;
 }
 
@@ -822,21 +831,40 @@ double grid::variance(int step)
 		fprintf(stderr,"error in variance: length=%d too big\n",length);
 		return -9999;
 	}
-	for(unsigned int i=0; i<length; i++)
-		dfeld[i]=0.0;
 	endi=nrows-step;
 	endj=ncols-step;
 	int step1=step+1;
-	for(int i=0; i<endi; i++){
-		for(int j=0; j<endj; j++){
-			for(int k1=0; k1<step1; k1++){
-				for(int k2=0; k2<step1; k2++){
-					dfeld[i*(ncols-step)+j]+=feld[i+k1][j+k2];
-				}
-			}
-			dfeld[i*(ncols-step)+j]/=((step1)*(step1));
-		}
-	}
+	// Fenstermittel kachelweise parallel aus einer summed-area table der
+	// Kachel (plus step Zeilen/Spalten), die Werte werden wie bisher
+	// ungefiltert (inkl. nodata) gemittelt; die Anzahl der Werte !=0 haelt
+	// Fenster nur aus Nullen exakt 0 (sie zaehlen unten nicht mit)
+	forEachTile(endi,endj,[&](const Tools::Tile& t){
+		int rows=int(t.rows)+step, cols=int(t.cols)+step;
+		size_t stride=cols+1;
+		vector<double> sat((rows+1)*stride,0.0);
+		vector<int> nonzero(sat.size(),0);
+		for(int i=0; i<rows; i++){
+			const float* v=feld[t.row+i]+t.col;
+			size_t k=(i+1)*stride+1;
+			double rs=0.0;
+			int rn=0;
+			for(int j=0; j<cols; j++,k++){
+				rs+=v[j];
+				rn+=v[j]!=0;
+				sat[k]=sat[k-stride]+rs;
+				nonzero[k]=nonzero[k-stride]+rn;
+			}
+		}
+		for(int i=0; i<int(t.rows); i++){
+			size_t a=i*stride, b=(i+step1)*stride;
+			for(int j=0; j<int(t.cols); j++,a++,b++){
+				double d=0.0;
+				if(nonzero[b+step1]-nonzero[b]-nonzero[a+step1]+nonzero[a]>0)
+					d=sat[b+step1]-sat[b]-sat[a+step1]+sat[a];
+				dfeld[(t.row+i)*(ncols-step)+t.col+j]=d/((step1)*(step1));
+			}
+		}
+	});
 	// calculate the variance
 	for(unsigned int i=0; i<length; i++){
 		dmean+=dfeld[i];
@@ -855,29 +883,23 @@ grid* grid::sobol()
 {
 	grid* gx;
 	gx=grid_copy();
-	double  n,m;
-	for(int i=1; i<nrows-1; i++){
-		for(int j=1; j<ncols-1; j++){
-			gx->feld[i][j]=gx->nodata;
-			if(int(feld[i][j])!=nodata){
-				if(int(feld[i-1][j-1])!=nodata &&
-						int(feld[i][j-1])!=nodata &&
-						int(feld[i+1][j-1])!=nodata &&
-						int(feld[i-1][j])!=nodata &&
-						int(feld[i][j])!=nodata &&
-						int(feld[i+1][j])!=nodata &&
-						int(feld[i-1][j+1])!=nodata &&
-						int(feld[i][j+1])!=nodata &&
-						int(feld[i+1][j+1])!=nodata){
-					n= feld[i-1][j+1]+2*feld[i][j+1]+feld[i+1][j+1]
-					                                           -feld[i-1][j-1]-2*feld[i][j-1]-feld[i+1][j-1];
-					m=feld[i+1][j-1]+2*feld[i+1][j]+feld[i+1][j+1]+
-							-feld[i-1][j-1]-2*feld[i-1][j]+feld[i-1][j+1];
-					gx->feld[i][j]=(float)(fabs(n)+fabs(m));
-				}
-			}
-		}
-	}
+	neighbourhoodMap(*this,*gx,1,0.0f,[&](const NeighbourhoodTile& t,int i,int j)->float{
+		// der Rand bleibt wie im Original
+		if(i==0 || j==0 || i==nrows-1 || j==ncols-1)
+			return gx->feld[i][j];
+		// alle 9 Zellen muessen gueltig sein
+		const float* o0=t.valid(i-1,j-1);
+		const float* o1=t.valid(i,j-1);
+		const float* o2=t.valid(i+1,j-1);
+		if(o0[0]+o0[1]+o0[2]+o1[0]+o1[1]+o1[2]+o2[0]+o2[1]+o2[2]<9)
+			return float(gx->nodata);
+		double n,m;
+		n= t.value(i-1,j+1)+2*t.value(i,j+1)+t.value(i+1,j+1)
+				-t.value(i-1,j-1)-2*t.value(i,j-1)-t.value(i+1,j-1);
+		m=t.value(i+1,j-1)+2*t.value(i+1,j)+t.value(i+1,j+1)+
+				-t.value(i-1,j-1)-2*t.value(i-1,j)+t.value(i-1,j+1);
+		return (float)(fabs(n)+fabs(m));
+	});
 	return gx;
 }
 
@@ -885,28 +907,21 @@ grid* grid::laplace()
 {
 	grid* gx;
 	gx=grid_copy();
-	//double  n,m;
-	for(int i=1; i<nrows-1; i++){
-		for(int j=1; j<ncols-1; j++){
-			gx->feld[i][j]=gx->nodata;
-			if(int(feld[i][j])!=nodata){
-				if(int(feld[i-1][j-1])!=nodata &&
-						int(feld[i][j-1])!=nodata &&
-						int(feld[i+1][j-1])!=nodata &&
-						int(feld[i-1][j])!=nodata &&
-						int(feld[i][j])!=nodata &&
-						int(feld[i+1][j])!=nodata &&
-						int(feld[i-1][j+1])!=nodata &&
-						int(feld[i][j+1])!=nodata &&
-						int(feld[i+1][j+1])!=nodata){
-					gx->feld[i][j]=-feld[i-1][j-1]-feld[i-1][j]-
-							feld[i-1][j+1]-feld[i][j-1]+8*feld[i][j]-
-							feld[i][j+1]-feld[i+1][j-1]-
-							feld[i+1][j]-feld[i+1][j+1];
-				}
-			}
-		}
-	}
+	neighbourhoodMap(*this,*gx,1,0.0f,[&](const NeighbourhoodTile& t,int i,int j)->float{
+		// der Rand bleibt wie im Original
+		if(i==0 || j==0 || i==nrows-1 || j==ncols-1)
+			return gx->feld[i][j];
+		// alle 9 Zellen muessen gueltig sein
+		const float* o0=t.valid(i-1,j-1);
+		const float* o1=t.valid(i,j-1);
+		const float* o2=t.valid(i+1,j-1);
+		if(o0[0]+o0[1]+o0[2]+o1[0]+o1[1]+o1[2]+o2[0]+o2[1]+o2[2]<9)
+			return float(gx->nodata);
+		return -t.value(i-1,j-1)-t.value(i-1,j)-
+				t.value(i-1,j+1)-t.value(i,j-1)+8*t.value(i,j)-
+				t.value(i,j+1)-t.value(i+1,j-1)-
+				t.value(i+1,j)-t.value(i+1,j+1);
+	});
 	return gx;
 }
 
@@ -914,34 +929,26 @@ grid* grid::edge()
 {
 	grid* gx;
 	gx=grid_copy();
-	//const float sq2=sqrt(2.0);
-	for(int i=1; i<nrows-1; i++){
-		for(int j=1; j<ncols-1; j++){
-			gx->feld[i][j]=gx->nodata;
-			if(int(feld[i][j])!=nodata){
-				if(int(feld[i-1][j-1])!=nodata &&
-						int(feld[i][j-1])!=nodata &&
-						int(feld[i+1][j-1])!=nodata &&
-						int(feld[i-1][j])!=nodata &&
-						int(feld[i][j])!=nodata &&
-						int(feld[i+1][j])!=nodata &&
-						int(feld[i-1][j+1])!=nodata &&
-						int(feld[i][j+1])!=nodata &&
-						int(feld[i+1][j+1])!=nodata){
-					gx->feld[i][j]=
-							-2.0/8*feld[i-1][j-1]
-							                 -2.0/8*feld[i][j-1]
-							                                -2.0/8*feld[i+1][j-1]
-							                                                 -2.0/8*feld[i-1][j]
-							                                                                  +3.0*feld[i][j]
-							                                                                               -2.0/8*feld[i+1][j]
-							                                                                                                -2.0/8*feld[i-1][j+1]
-							                                                                                                                 -2.0/8*feld[i][j+1]
-							                                                                                                                                -2.0/8*feld[i+1][j+1];
-				}
-			}
-		}
-	}
+	neighbourhoodMap(*this,*gx,1,0.0f,[&](const NeighbourhoodTile& t,int i,int j)->float{
+		// der Rand bleibt wie im Original
+		if(i==0 || j==0 || i==nrows-1 || j==ncols-1)
+			return gx->feld[i][j];
+		// alle 9 Zellen muessen gueltig sein
+		const float* o0=t.valid(i-1,j-1);
+		const float* o1=t.valid(i,j-1);
+		const float* o2=t.valid(i+1,j-1);
+		if(o0[0]+o0[1]+o0[2]+o1[0]+o1[1]+o1[2]+o2[0]+o2[1]+o2[2]<9)
+			return float(gx->nodata);
+		return -2.0/8*t.value(i-1,j-1)
+				-2.0/8*t.value(i,j-1)
+				-2.0/8*t.value(i+1,j-1)
+				-2.0/8*t.value(i-1,j)
+				+3.0*t.value(i,j)
+				-2.0/8*t.value(i+1,j)
+				-2.0/8*t.value(i-1,j+1)
+				-2.0/8*t.value(i,j+1)
+				-2.0/8*t.value(i+1,j+1);
+	});
 	return gx;
 }
 
@@ -1076,18 +1083,14 @@ grid* grid::n2()
 	if(dy<0)dy=0;
 	fprintf(stderr,"n2: k=%d dx=%d dy=%d\n",k,dx,dy);
 	grid* gx=new grid((int)csize);
-	gx->ncols=k;
-	gx->nrows=k;
 	gx->csize=csize;
 	gx->nodata=nodata;
 	gx->xcorner=xcorner+dx*csize;
 	gx->ycorner=ycorner+(nrows-dy)*csize;
 	// allocate memory
-	gx->feld = new float*[k];
-	for(int i=0; i<k; i++){
-		if((gx->feld[i]=new float[k])==NULL){
-			cerr << "error (grid::select): no sufficient memory" << endl;
-		}
+	if(!gx->allocate(k,k)){
+		cerr << "error (grid::n2): no sufficient memory" << endl;
+		return gx;
 	}
 	// fill the new grid
 	for(int i=0; i<k; i++)
@@ -2303,16 +2306,10 @@ grid* grid::rotate(int beta1)
 		gx->nodata=nodata;
 		gx->xcorner = ycorner;
 		gx->ycorner = xcorner;
-		gx->ncols=nrows;
-		gx->nrows=ncols;
 		gx->csize = csize;
-		gx->feld=new float*[gx->nrows];
-		for(int i=0; i<gx->nrows; i++){
-			gx->feld[i]=new float[gx->ncols];
-			if(gx->feld[i]==0){
-				fprintf(stderr,"error in rotate: no space on device\n");
-				return 0;
-			}
+		if(!gx->allocate(ncols,nrows)){
+			fprintf(stderr,"error in rotate: no space on device\n");
+			return 0;
 		}
 		for(int i=0; i<nrows; i++)
 			for(int j=0; j<ncols; j++)
@@ -2323,16 +2320,10 @@ grid* grid::rotate(int beta1)
 		gx->nodata=nodata;
 		gx->xcorner = ycorner;
 		gx->ycorner = xcorner;
-		gx->ncols=nrows;
-		gx->nrows=ncols;
 		gx->csize = csize;
-		gx->feld=new float*[gx->nrows];
-		for(int i=0; i<gx->nrows; i++){
-			gx->feld[i]=new float[gx->ncols];
-			if(gx->feld[i]==0){
-				fprintf(stderr,"error in rotate: no space on device\n");
-				return 0;
-			}
+		if(!gx->allocate(ncols,nrows)){
+			fprintf(stderr,"error in rotate: no space on device\n");
+			return 0;
 		}
 		for(int i=0; i<nrows; i++)
 			for(int j=0; j<ncols; j++)
@@ -2343,16 +2334,10 @@ grid* grid::rotate(int beta1)
 		gx->nodata=nodata;
 		gx->xcorner = ycorner;
 		gx->ycorner = xcorner;
-		gx->ncols=ncols;
-		gx->nrows=nrows;
 		gx->csize = csize;
-		gx->feld=new float*[gx->nrows];
-		for(int i=0; i<gx->nrows; i++){
-			gx->feld[i]=new float[gx->ncols];
-			if(gx->feld[i]==0){
-				fprintf(stderr,"error in rotate: no space on device\n");
-				return 0;
-			}
+		if(!gx->allocate(nrows,ncols)){
+			fprintf(stderr,"error in rotate: no space on device\n");
+			return 0;
 		}
 		for(int i=0; i<nrows; i++)
 			for(int j=0; j<ncols; j++)
@@ -2383,17 +2368,12 @@ grid* grid::rotate(int beta1)
 	fprintf(stderr,"P1 %f %f\nP2 %f %f\nP3 %f %f\nP4 %f %f\n",
 	        a.a,a.b,b.a,b.b,c.a,c.b,d.a,d.b);
 	fprintf(stderr,"nrows=%d ncols=%d\n",n_ncols,n_nrows);
-	gx->feld= new float*[n_nrows];
-	for(int i=0; i<n_nrows; i++){
-		if((gx->feld[i]= new float[n_ncols])==NULL){
-			cerr << "error (read_ascii): no sufficient memory" << endl;
-		}
+	if(!gx->allocate(n_nrows,n_ncols)){
+		cerr << "error (rotate): no sufficient memory" << endl;
 	}
 	gx->nodata=nodata;
 	gx->xcorner = xcorner;
 	gx->ycorner = ycorner;
-	gx->ncols=n_ncols;
-	gx->nrows=n_nrows;
 	gx->csize = csize;
 	for(int i=0; i<n_nrows; i++){
 		for(int j=0; j<n_ncols; j++){
@@ -2507,39 +2487,15 @@ grid* grid::cluster2value(grid* vgrid)
 
 // some erosion algorithms
 
-void grid::w_fill()
+// fuellt alle (auch verschachtelte und flache) Senken in einem Durchgang
+// (priority flood, hydrology.h), mit epsilon>0 bleibt ein Gefaelle zum
+// Auslass, so dass w_flowdirection ueberall eine Richtung findet
+void grid::w_fill(float epsilon)
 {
-	grid* gx=w_focalflow();
-	float val;
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			if(int(feld[i][j])!=nodata){
-				if(gx->feld[i][j]==255){
-					for(int k=0; k<8;k++){
-						val=FLT_MAX;
-						if(i+1<nrows && val>feld[i+1][j])
-							val=feld[i+1][j];
-						if(j+1<ncols && val>feld[i][j+1])
-							val=feld[i][j+1];
-						if(i-1>=0 && val>feld[i-1][j])
-							val=feld[i-1][j];
-						if(j-1>=0 && val>feld[i][j-1])
-							val=feld[i][j-1];
-						if(i+1<nrows && j+1<ncols && val>feld[i+1][j+1])
-							val=feld[i+1][j+1];
-						if(i+1<nrows && j-1>=0 && val>feld[i+1][j-1])
-							val=feld[i+1][j-1];
-						if(i-1>=0 && j+1<ncols && val>feld[i-1][j+1])
-							val=feld[i-1][j+1];
-						if(i-1>=0 && j-1>=0 && val>feld[i-1][j-1])
-							val=feld[i-1][j-1];
-					}
-					feld[i][j]=val;
-				}
-			}
-		}
-	}
-	delete gx;
+	if(epsilon>0)
+		fillDepressions(*this,epsilon);
+	else
+		fillDepressionsTiled(*this);
 }
 
 grid* grid::w_focalflow()
@@ -2572,7 +2528,7 @@ grid* grid::w_focalflow()
 }
 
 
-// simple function for stack manipulation
+// simple function for stack manipulation (veraltet, siehe grid.h)
 stack2i::stack2i( int l)
 {
 	if(l<0 || l> MAXSTACK) return;
@@ -2625,7 +2581,6 @@ void stack2i::emptyStack()
 
 grid* grid::flood_fill(grid* gx, int x, int y, float val)
 {
-	fprintf(stderr,"flood_fill: %d %d %f\n",x,y,val);
 	if(x<0 || y<0 || x>=ncols || y>=nrows){
 		fprintf(stderr,"error in flood_fill: x=%d y=%d out of range\n",x,y);
 		return (grid*)0;
@@ -2634,44 +2589,25 @@ grid* grid::flood_fill(grid* gx, int x, int y, float val)
 		fprintf(stderr,"error in flood_fill: val=%f must be >0\n",val);
 		return (grid*)0;
 	}
-	// grid* gx=grid_copy();
-	stack2i *s=new stack2i(MAXSTACK);
-	if(s==0) return (grid*) 0;
-	s->emptyStack();
+	// Zellen < Startwert+val, die in gx noch nicht -1 sind, das mit (x,y)
+	// zusammenhaengende Gebiet wird in gx auf -1 gesetzt
 	float ground=feld[y][x];
-	if(!(s->push(x,y))) return (grid*) 0;
-	while(s->pop(x,y)){
-		gx->feld[y][x]=-1;
-		if(x+1<ncols && gx->feld[y][x+1]!=-1 && feld[y][x+1]<ground+val){
-			if(!(s->push)(x+1,y)) return (grid*)0;
-		}
-		if(x-1>=0 && gx->feld[y][x-1]!=-1 && feld[y][x-1]<ground+val){
-			if(!(s->push(x-1,y))) return (grid*)0;
-		}
-		if(y+1<nrows && gx->feld[y+1][x]!=-1 && feld[y+1][x]<ground+val){
-			if(!(s->push(x,y+1))) return (grid*)0;
-		}
-		if(y-1>=0 && gx->feld[y-1][x]!=-1 && feld[y-1][x]<ground+val){
-			if(!(s->push(x,y-1))) return (grid*)0;
-		}
-		if(x+1<ncols && y+1<nrows && gx->feld[y+1][x+1]!=-1 &&
-				feld[y+1][x+1]<ground+val){
-			if(!(s->push(x+1,y+1))) return (grid*)0;
-		}
-		if(x-1>=0 && y+1<nrows && gx->feld[y+1][x-1]!=-1 &&
-				feld[y+1][x-1]<ground+val){
-			if(!(s->push(x-1,y+1))) return (grid*)0;
-		}
-		if(x+1<ncols && y-1>=0 && gx->feld[y-1][x+1]!=-1 &&
-				feld[y-1][x+1]<ground+val){
-			if(!(s->push(x+1,y-1))) return (grid*)0;
+	vector<unsigned char> mask(nrows*ncols);
+	for(int i=0; i<nrows; i++){
+		for(int j=0; j<ncols; j++){
+			mask[i*ncols+j]=!isNoDataValue(feld[i][j],nodata) &&
+					feld[i][j]<ground+val && gx->feld[i][j]!=-1;
 		}
-		if(x-1>=0 && y-1>=0 && gx->feld[y-1][x-1]!=-1 &&
-				feld[y-1][x-1]<ground+val){
-			if(!(s->push(x-1,y-1))) return (grid*)0;
+	}
+	mask[y*ncols+x]=1;
+	vector<int> labels;
+	labelComponents(nrows,ncols,mask,NULL,eConnect8,labels);
+	int l=labels[y*ncols+x];
+	for(int i=0; i<nrows; i++){
+		for(int j=0; j<ncols; j++){
+			if(labels[i*ncols+j]==l) gx->feld[i][j]=-1;
 		}
 	}
-	delete s;
 	return gx;
 }
 
@@ -2829,12 +2765,14 @@ float grid::moore(int a, int b, int r, int PARA)
 		return res;
 	}
 	if(PARA==CIRCLE){
+		// Zeilenabschnitte des Kreises um (a,b): |j|<=sqrt(r*r-i*i)
 		for(int i=-r; i<=r; i++){
-			for(int j=-r; j<=r; j++){
-				if(a+i>=0 && b+j>=0
-						&& i+a<nrows  && j+b<ncols
-						&& int(feld[i+a][j+b])!=nodata
-						&& ((i-r)*(i-r)+(j-r)*(j-r))<=r2)
+			if(a+i<0 || a+i>=int(nrows))
+				continue;
+			int w=int(sqrt(r2-i*i));
+			int j0=max(-w,-b), j1=min(w,int(ncols)-1-b);
+			for(int j=j0; j<=j1; j++){
+				if(int(feld[i+a][j+b])!=nodata)
 					res+=feld[i+a][j+b];
 			}
 		}
@@ -2844,46 +2782,36 @@ float grid::moore(int a, int b, int r, int PARA)
 	return res;
 }
 
+// Summe der gueltigen Werte im Moore-Fenster mit Radius r um (i,j),
+// wie moore(i,j,r,MOORE), aber aus der summed-area table der Kachel
+static float moore_sum(const SummedAreaTile& s, int i, int j, int r)
+{
+	return float(s.sums(i,j,r).total());
+}
+
 void grid::nachbarmatrix(grid* g1, int r, float thres)
 {
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			if(this->moore(i,j,r,MOORE)>thres)g1->feld[i][j]=1.0;
-			else g1->feld[i][j]=0.0;
-		}
-	}
+	summedAreaMap(*this,*g1,r,false,[&](const SummedAreaTile& s,int i,int j){
+		return moore_sum(s,i,j,r)>thres ? 1.0f : 0.0f;
+	});
 }
 
 void grid::naehematrix(grid* g1, int r, float thres)
 {
-	int k;
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			g1->feld[i][j]=9999;
-		}
-	}
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			k=1;
-			while(k<=r){
-				if(this->moore(i,j,k,MOORE)>thres){
-					g1->feld[i][j]=k;
-					break;
-				}
-				k++;
-			}
-		}
-	}
+	summedAreaMap(*this,*g1,r,false,[&](const SummedAreaTile& s,int i,int j){
+		for(int k=1; k<=r; k++)
+			if(moore_sum(s,i,j,k)>thres)
+				return float(k);
+		return 9999.0f;
+	});
 }
 
 void grid::kompaktheit(grid* g1, int r)
 {
 	float teiler=(2*r+1)*(2*r+1);
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			g1->feld[i][j]=this->moore(i,j,r,MOORE)/teiler;
-		}
-	}
+	summedAreaMap(*this,*g1,r,false,[&](const SummedAreaTile& s,int i,int j){
+		return moore_sum(s,i,j,r)/teiler;
+	});
 }
 
 void grid::attraktivitaet(grid* g1, int im, int jm, float alpha,
@@ -2937,17 +2865,13 @@ grid* grid::select(int a,int b,int c, int d)
 		return 0;
 	}
 	grid* gx = new grid((int)csize);
-	gx->ncols = c-a;
-	gx->nrows = d-b;
 	gx->xcorner = xcorner+a*csize;
 	gx->ycorner = ycorner+(nrows-d)*csize;
 	gx->csize = csize;
 	gx->nodata = nodata;
-	gx->feld = new float*[gx->nrows];
-	for(int i=0; i<gx->nrows; i++){
-		if((gx->feld[i]=new float[gx->ncols])==NULL){
-			cerr << "error (grid::select): no sufficient memory" << endl;
-		}
+	if(!gx->allocate(d-b,c-a)){
+		cerr << "error (grid::select): no sufficient memory" << endl;
+		return gx;
 	}
 	for(int i=0; i<gx->nrows; i++){
 		for(int j=0; j<gx->ncols; j++){
@@ -2960,20 +2884,12 @@ grid* grid::select(int a,int b,int c, int d)
 #ifndef NO_HDF5
 bool grid::write_hdf(char* fname, char* datasetn, char* autor, char* modell) {
   //cerr << "hdf " << fname << " " << datasetn << endl;
-	float* f1=new float[nrows*ncols];
-	if (f1==NULL) {
-		cerr << "error (write_hdf): no space on device\n";
-		exit(2);
-	}
-	for (int i=0; i<nrows; i++)
-		for (int j=0; j<ncols; j++)
-			f1[i*ncols+j]=feld[i][j];
 	hd=new hdf5;
 	if (hd->open_f(fname)!=0)
 		hd->create_f(fname);
 	bool success = false;
 	if (hd->open_d(datasetn)!=0){
-		hd->write_f_feld(datasetn, f1, nrows, ncols);
+		hd->write_f_feld(datasetn, data(), nrows, ncols);
 		hd->write_s_attribute("Autor", autor);
 		hd->write_s_attribute("Modell", modell);
 		hd->write_l_attribute("time", time(NULL));
@@ -2985,7 +2901,6 @@ bool grid::write_hdf(char* fname, char* datasetn, char* autor, char* modell) {
 		hd->write_i_attribute("nrows", nrows);
 		success = true;
 	}
-	delete[] f1;
 	delete hd;
 	hd = NULL;
 	return success;
@@ -3083,11 +2998,7 @@ int grid::read_hdf(char* fname, char* datasetn)
 		cerr << "error (read_hdf): can not open dataset: " << datasetn << endl;
 		return -2;
 	}
-	if(feld!=(float**)NULL){
-		for(int i=0; i<nrows; i++){
-			delete [] feld[i];
-		}
-	}
+	release();
 	ncols=hd->get_i_attribute("ncols");
 	nrows=hd->get_i_attribute("nrows");
 	nodata=hd->get_i_attribute("nodata");
@@ -3095,24 +3006,32 @@ int grid::read_hdf(char* fname, char* datasetn)
   ycorner=hd->get_d_attribute("yllcorner");
   csize=hd->get_f_attribute("cell-size");
   //cerr << ncols << " " << nrows << " " << csize << endl;
-	hd->read_f_feld(datasetn); // writes to f1 in grid
-	feld=new float*[nrows];
-	for(int i=0; i<nrows; i++){
-		if((feld[i]=new float[ncols])==NULL){
-			cerr << "error (read_hdf): no sufficient memory" << endl;
-		}
-	}
-	// read_in
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			feld[i][j]=hd->f1[i*ncols+j];
-		}
+	if(!allocate(nrows,ncols)){
+		cerr << "error (read_hdf): no sufficient memory" << endl;
+		delete hd;
+		return -3;
+	}
+	// read_in, directly into the grid block
+	if(nrows*ncols>0 && hd->read_f_feld(datasetn,block,nrows*ncols)!=0){
+		cerr << "error (read_hdf): can not read dataset: " << datasetn << endl;
+		delete hd;
+		return -2;
 	}
 	delete hd;
 	return 0;
 }
 #endif //NO_HDF5
 
+int grid::read_binary(const char* fname)
+{
+	return readBinaryGrid(fname, *this);
+}
+
+bool grid::write_binary(const char* fname)
+{
+	return writeBinaryGrid(fname, *this);
+}
+
 float grid::get_xy(int i, int j)
 {
   if(i>=0 && i<nrows && j>=0 && j<ncols)
@@ -3272,18 +3191,14 @@ grid* grid::combine_grid(grid *g1, grid *g2, float (*f)(float,float,float))
 grid* grid::zoom()
 {
 	grid* gxxx = new grid(rgr/2);
-	gxxx->ncols = 2*ncols-1;
-	gxxx->nrows = 2*nrows-1;
 	gxxx->xcorner=xcorner;
 	gxxx->ycorner=ycorner;
 	gxxx->csize=csize/2;
 	gxxx->nodata=nodata;
 	// allocate memory
-	gxxx->feld=new float*[gxxx->nrows];
-	for(int i=0; i<gxxx->nrows; i++){
-		if((gxxx->feld[i]=new float[gxxx->ncols])==NULL){
-			cerr << "error (upscale): no sufficient memory" << endl;
-		}
+	if(!gxxx->allocate(2*nrows-1,2*ncols-1)){
+		cerr << "error (zoom): no sufficient memory" << endl;
+		return gxxx;
 	}
 	has_nodata=NO;
 	for(int i=0; i<nrows; i++)
@@ -3408,18 +3323,14 @@ grid* grid::zoom()
 grid* grid::upscale(int teiler)
 {
 	grid* gxxx = new grid(rgr/teiler);
-	gxxx->ncols = teiler * ncols;
-	gxxx->nrows = teiler * nrows;
 	gxxx->xcorner=xcorner;
 	gxxx->ycorner=ycorner;
 	gxxx->csize=csize/teiler;
 	gxxx->nodata=nodata;
 
-	gxxx->feld= new float*[gxxx->nrows];
-	for(int i=0; i<gxxx->nrows; i++){
-		if((gxxx->feld[i]=new float[gxxx->ncols])==NULL){
-			cerr << "error (upscale): no sufficient memory" << endl;
-		}
+	if(!gxxx->allocate(teiler*nrows,teiler*ncols)){
+		cerr << "error (upscale): no sufficient memory" << endl;
+		return gxxx;
 	}
 	for(int i=0; i<nrows; i++){
 		for(int j=0; j<ncols; j++){
@@ -3442,18 +3353,14 @@ grid* grid::downscale(int multi)
 		return 0;
 	}
 	grid* gxxx = new grid(rgr*multi);
-	gxxx->ncols = ncols/multi;
-	gxxx->nrows = nrows/multi;
 	gxxx->xcorner=xcorner;
 	gxxx->ycorner=ycorner;
 	gxxx->csize=csize*multi;
 	gxxx->nodata=nodata;
 	int flag=0;
-	gxxx->feld=new float*[gxxx->nrows];
-	for(int i=0; i<gxxx->nrows; i++){
-		if((gxxx->feld[i]=new float[gxxx->ncols])==NULL){
-			cerr << "error (downscale): no sufficient memory" << endl;
-		}
+	if(!gxxx->allocate(nrows/multi,ncols/multi)){
+		cerr << "error (downscale): no sufficient memory" << endl;
+		return gxxx;
 	}
 	for(int i=0; i<gxxx->nrows; i++){
 		for(int j=0; j<gxxx->ncols; j++){
@@ -3482,18 +3389,14 @@ grid* grid::downscale_s(int multi)
 		exit(2);
 	}
 	grid* gxxx = new grid(rgr*multi);
-	gxxx->ncols = ncols/multi;
-	gxxx->nrows = nrows/multi;
 	gxxx->xcorner=xcorner;
 	gxxx->ycorner=ycorner;
 	gxxx->csize=csize*multi;
 	gxxx->nodata=nodata;
 	int flag=0;
-	gxxx->feld= new float*[gxxx->nrows];
-	for(int i=0; i<gxxx->nrows; i++){
-		if((gxxx->feld[i]=new float[gxxx->ncols])==NULL){
-			cerr << "error (downscale_s): no sufficient memory" << endl;
-		}
+	if(!gxxx->allocate(nrows/multi,ncols/multi)){
+		cerr << "error (downscale_s): no sufficient memory" << endl;
+		return gxxx;
 	}
 	for(int i=0; i<gxxx->nrows; i++){
 		for(int j=0; j<gxxx->ncols; j++){
@@ -3514,186 +3417,89 @@ grid* grid::downscale_s(int multi)
 }
 
 
+// exakte euklidische Distanztransformation in O(Zellen) statt fuer jede
+// Zelle alle Quellzellen abzusuchen; Zellen ohne Quelle im Grid bleiben
+// wie bisher FLT_MAX (mal csize)
 grid* grid::distance(float val)
 {
-	vector<ipoint*> ivec;
-	vector<ipoint*>::iterator p;
-	double dist;
 	grid* gx=grid_copy();
-	// init gx
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			if(fabs(feld[i][j]-val)<RES)
-				gx->feld[i][j]=0;
-			else
-				gx->feld[i][j]=FLT_MAX;
-		}
-	}
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			if(fabs((double)gx->feld[i][j])<RES){
-				ipoint* fp=new ipoint();
-				fp->x=i;
-				fp->y=j;
-				ivec.push_back(fp);
-			}
-		}
-	}
+	vector<unsigned char> source(size_t(nrows)*ncols);
+	for(int i=0; i<nrows; i++)
+		for(int j=0; j<ncols; j++)
+			source[size_t(i)*ncols+j]=fabs(feld[i][j]-val)<RES;
+	vector<double> dist2;
+	squaredDistanceTransform(nrows,ncols,source,dist2);
 	for(int i=0; i<nrows; i++){
+		const double* d=&dist2[size_t(i)*ncols];
 		for(int j=0; j<ncols; j++){
-			if(fabs((double)gx->feld[i][j])<RES);
-			else{
-				for(p=ivec.begin(); p!=ivec.end(); p++){
-					dist=sqrt((double)(((*p)->x-i)*((*p)->x-i)+
-							((*p)->y-j)*((*p)->y-j)));
-					if(gx->feld[i][j]>dist) gx->feld[i][j]=
-							(float)dist;
-					if(fabs((double)(gx->feld[i][j]-1)) < RES) break;
-				}
-			}
+			float dist=d[j]<DBL_MAX ? (float)sqrt(d[j]) : FLT_MAX;
 			if(feld[i][j]!=nodata)
-				gx->feld[i][j]*=gx->csize;
+				gx->feld[i][j]=dist*gx->csize;
 			else
 				gx->feld[i][j]=nodata;
 		}
 	}
-	for(p=ivec.begin(); p!=ivec.end(); p++){
-		delete (*p);
-	}
 	return gx;
 }
 
-grid* grid::visuability(point* pf)
+grid* grid::allocation(float background)
 {
-	bool flag1=false;
-	bool flag2;
-	//bool flag3;
-	double gamma=12742000.0;
-	double dist1,dist2,dist,s1,s2,sa,h1,h2,m;//,smax;
-	int x1, xw, y1, yw, deltax, deltay, e, xstep, ystep, length1;
-	// init the output
-	grid *v_grid=grid_copy();
+	grid* gx=grid_copy();
+	vector<unsigned char> source(size_t(nrows)*ncols);
+	for(int i=0; i<nrows; i++)
+		for(int j=0; j<ncols; j++)
+			source[size_t(i)*ncols+j]=feld[i][j]!=nodata && !(fabs(feld[i][j]-background)<RES);
+	vector<double> dist2;
+	vector<ptrdiff_t> nearest;
+	squaredDistanceTransform(nrows,ncols,source,dist2,&nearest);
 	for(int i=0; i<nrows; i++){
+		const ptrdiff_t* n=&nearest[size_t(i)*ncols];
 		for(int j=0; j<ncols; j++){
-			v_grid->feld[i][j]=-1.0;
+			if(feld[i][j]!=nodata && n[j]>=0)
+				gx->feld[i][j]=feld[n[j]/ncols][n[j]%ncols];
+			else
+				gx->feld[i][j]=nodata;
 		}
 	}
-	cerr << "visuability called: " << pf->length << endl;
-	for(int k=0; k<pf->length; k++){
-		cerr << pf->feld[k][0] << " " << pf->feld[k][1]
-		                                             << " " << pf->feld[k][2] << endl;
-	}
+	return gx;
+}
 
+// Sichtbarkeit von den Punkten aus (x, y, Hoehe ueber Grund), die
+// Beobachter werden parallel berechnet (viewshed.h), Ergebnis ist die
+// Entfernung zum naechsten Beobachter, der die Zelle sieht, sonst -1
+grid* grid::visuability(point* pf, int algorithm)
+{
+	vector<ViewshedObserver> observers;
 	for(int k=0; k<pf->length; k++){
-		xw=(int)((pf->feld[k][0]-xcorner)/csize);
-		yw=(nrows-1)-(int)((pf->feld[k][1]-ycorner)/csize);
-		cerr << "xw: " << xw << " yw: " << yw << " high: "
-		<< pf->feld[k][2]+feld[yw][xw] << endl;
-		for(int i=0; i<nrows; i++){
-			for(int j=0; j<ncols; j++){
-				if(feld[i][j]!=nodata){ // nodata are not allowed
-					dist=sqrt(double((xw-j)*(xw-j)+(yw-i)*(yw-i)))*csize;
-					dist2=sqrt(2.0*6371000*(pf->feld[k][2]+feld[yw][xw]));
-					dist1=sqrt(2.0*6371000*feld[i][j]);
-					if(dist1+dist2>dist){
-						// calc line beween Px and Pw
-						x1=j;
-						y1=i;
-						deltax=xw-x1;
-						deltay=yw-y1;
-						ystep=1;
-						xstep=1;
-						flag2=false;
-						if(deltax<0){
-							deltax*=-1;xstep*=-1;
-						}
-						if(deltay<0){
-							deltay*=-1;ystep*=-1;
-						}
-						if(deltay>deltax){
-							int t;
-							t=deltax;
-							deltax=deltay;
-							deltay=t;
-							flag2=true;
-						}
-						length1=deltax-1;
-						e=deltay;
-						flag1=false;
-						s1=(dist1*dist)/(dist1+dist2);
-						s2=(dist2*dist)/(dist1+dist2);
-						h1=(s1*s1)/gamma;
-						h2=(s2*s2)/gamma;
-						m=(((pf->feld[k][2]+feld[yw][xw]-h2)-feld[i][j]-h1))/dist;
-						// 		    cerr << i << " " << j << " "
-						// 			 << h1 << " " << h2 << " " << m << " " << dist << endl;
-						for(int x=0; x<length1; x++){
-							e+=deltay;
-							if(flag2==false) x1+=xstep;
-							else y1+=ystep;
-							if(e>=deltax){
-								e-=deltax;
-								if(flag2==false) y1+=ystep;
-								else x1+=xstep;
-							}
-							// distance between P0 and Px
-							sa=sqrt(double(((j-x1)*(j-x1)+(i-y1)*(i-y1))))*csize;
-							if(m*sa+feld[i][j]<feld[y1][x1]){
-								flag1=true;
-								break;
-							}
-						}
-						if(flag1==false)
-							if(v_grid->feld[i][j]<0 || v_grid->feld[i][j]>sa)
-								v_grid->feld[i][j]=sa;
-					}
-				}
-				else v_grid->feld[i][j]=nodata;
-			}
-
-		}
+		int xw=(int)((pf->feld[k][0]-xcorner)/csize);
+		int yw=(nrows-1)-(int)((pf->feld[k][1]-ycorner)/csize);
+		observers.push_back(ViewshedObserver(yw,xw,pf->feld[k][2]));
 	}
-	return v_grid;
+	return viewshedDistance(*this,observers,ViewshedOptions(ViewshedAlgorithm(algorithm)));
 }
 
-void grid::write_ascii(char* name)
+// header lines of write_ascii and write_ascii_inv
+static string ascii_header(const grid* g)
 {
-	FILE *fp1;
-	fp1 = fopen(name,"w");
+	AsciiGridHeader h;
+	h.ncols=g->ncols;
+	h.nrows=g->nrows;
+	h.xllcorner=g->xcorner;
+	h.yllcorner=g->ycorner;
+	h.cellsize=g->csize;
+	h.nodata=g->nodata;
+	return formatAsciiGridHeader(h);
+}
 
-	fprintf(fp1,"ncols         %d\n",ncols);
-	fprintf(fp1,"nrows         %d\n",nrows);
-	fprintf(fp1,"xllcorner     %f\n",xcorner);
-	fprintf(fp1,"yllcorner     %f\n",ycorner);
-	fprintf(fp1,"cellsize      %5.1f\n",csize);
-	fprintf(fp1,"NODATA_value  %d\n",nodata);
-	// write out
-	for(int i=0; i<nrows; i++){
-		for(int j=0; j<ncols; j++){
-			fprintf(fp1,"%4.3f ",feld[i][j]);
-		}
-		fprintf(fp1,"\n");
-	}
-	fclose(fp1);
+void grid::write_ascii(char* name,int precision)
+{
+	// write out, rows are formatted in parallel
+	writeAsciiGrid(name,ascii_header(this),feld,nrows,ncols,AsciiGridFormat(precision));
 }
-void grid::write_ascii_inv(char* name)
+void grid::write_ascii_inv(char* name,int precision)
 {
-	FILE *fp1;
-	fp1 = fopen(name,"w");
-	fprintf(fp1,"ncols         %d\n",ncols);
-	fprintf(fp1,"nrows         %d\n",nrows);
-	fprintf(fp1,"xllcorner     %f\n",xcorner);
-	fprintf(fp1,"yllcorner     %f\n",ycorner);
-	fprintf(fp1,"cellsize      %5.1f\n",csize);
-	fprintf(fp1,"NODATA_value  %d\n",nodata);
-	// write out
-	for(int i=nrows-1; i>=0; i--){
-		for(int j=0; j<ncols; j++){
-			fprintf(fp1,"%4.3f ",feld[i][j]);
-		}
-		fprintf(fp1,"\n");
-	}
-	fclose(fp1);
+	// write out, last row first
+	writeAsciiGrid(name,ascii_header(this),feld,nrows,ncols,AsciiGridFormat(precision),true);
 }
 
 void grid::write_pnm(char* name, int farbe)
@@ -4276,8 +4082,6 @@ grid* point::p2g(grid* gx, double r)
 
 grid* point::p2g_shepard(grid* gx,double R, double mu)
 {
-	double l,val;
-	unsigned count=0;
 	fprintf(stderr,"point to grid using shepard: R=%lf mu=%lf\n",R,mu);
 	if(R>sqrt((gx->nrows*gx->csize)*(gx->nrows*gx->csize)+
 	          (gx->ncols*gx->csize)*(gx->ncols*gx->csize))/2){
@@ -4288,81 +4092,78 @@ grid* point::p2g_shepard(grid* gx,double R, double mu)
 		fprintf(stderr,"mu=%lf must be in [2..6]\n",mu);
 		return (grid*)0;
 	}
+	// nur die Punkte im Grid, je Zelle nur die im Umkreis R (PointIndex)
+	vector<int> inside;
+	for(int k=0; k<length; k++){
+		if(feld[k][0]>=gx->xcorner &&
+				feld[k][0]<gx->xcorner+gx->csize*gx->ncols &&
+				feld[k][1]>=gx->ycorner &&
+				feld[k][1]<gx->ycorner+gx->csize*gx->nrows)
+			inside.push_back(k);
+	}
+	PointIndex index(feld,inside);
+	int imu=int(mu);
+	bool integral=imu==mu;
+	double R2=R*R*(1+1e-12);
 	grid* nx=gx->grid_copy();
-	for(int i=0; i<nx->nrows; i++)
-		for(int j=0; j<nx->ncols; j++)
-			if(nx->feld[i][j]!=nx->nodata)
-				nx->feld[i][j]=0;
-	for(int i=0; i<nx->nrows; i++){
+	Tools::defaultThreadPool().parallelFor(nx->nrows,[&](size_t row){
+		int i=int(row);
+		double y=nx->ycorner+nx->csize*i;
 		for(int j=0; j<nx->ncols; j++){
+			double x=nx->xcorner+nx->csize*j;
 			double r=0;
 			double rall=0;
-			count=0;
-			for(int k=0; k<length; k++){
-				if(feld[k][0]>=nx->xcorner &&
-						feld[k][0]<nx->xcorner+gx->csize*gx->ncols &&
-						feld[k][1]>=nx->ycorner &&
-						feld[k][1]<nx->ycorner+nx->csize*gx->nrows){
-					count++;
-					l=sqrt((nx->xcorner+nx->csize*j-feld[k][0])*
-					       (nx->xcorner+nx->csize*j-feld[k][0])+
-					       (nx->ycorner+nx->csize*i-feld[k][1])*
-					       (nx->ycorner+nx->csize*i-feld[k][1]));
-					if(l<R){
-						l=1-l/R;
+			index.forEachNear(x,y,R,[&](int k){
+				double d2=(x-feld[k][0])*(x-feld[k][0])+(y-feld[k][1])*(y-feld[k][1]);
+				if(d2>R2) return; // Ecken des Quadrats um (x,y)
+				double l=sqrt(d2);
+				if(l<R){
+					l=1-l/R;
+					double val=l;
+					if(integral)
+						for(int m=1; m<imu; m++) val*=l;
+					else
 						val=pow(l,mu);
-						rall+=val;
-						r+=val*feld[k][2];}
+					rall+=val;
+					r+=val*feld[k][2];
 				}
-			}
+			});
 			if(gx->feld[nx->nrows-1-i][j]!=gx->nodata && r!=0 && rall!=0)
 				nx->feld[nx->nrows-1-i][j]=r/rall;
 			else
 				nx->feld[nx->nrows-1-i][j]=nx->nodata;
 		}
-	}
-	fprintf(stderr,"p2g_shepard: %d points are used\n",count);
+	});
+	fprintf(stderr,"p2g_shepard: %d points are used\n",int(inside.size()));
 	return nx;
 }
 
 
 grid* point::p2g_voronoi(grid* gx)
 {
-	double l,val;
-	unsigned count=0;
+	// Wert des naechsten Punktes im Grid (PointIndex)
+	vector<int> inside;
+	for(int k=0; k<length; k++){
+		if(feld[k][0]>=gx->xcorner &&
+				feld[k][0]<gx->xcorner+gx->csize*gx->ncols &&
+				feld[k][1]>=gx->ycorner &&
+				feld[k][1]<gx->ycorner+gx->csize*gx->nrows)
+			inside.push_back(k);
+	}
+	PointIndex index(feld,inside);
 	grid* nx=gx->grid_copy();
-	for(int i=0; i<nx->nrows; i++)
-		for(int j=0; j<nx->ncols; j++)
-			if(nx->feld[i][j]!=nx->nodata)
-				nx->feld[i][j]=0;
-	for(int i=0; i<nx->nrows; i++){
+	Tools::defaultThreadPool().parallelFor(nx->nrows,[&](size_t row){
+		int i=int(row);
+		double y=nx->ycorner+nx->csize*(nx->nrows-i-1);
 		for(int j=0; j<nx->ncols; j++){
-			count=0;
-			val=FLT_MAX;
-			for(int k=0; k<length; k++){
-				if(feld[k][0]>=nx->xcorner &&
-						feld[k][0]<nx->xcorner+gx->csize*gx->ncols &&
-						feld[k][1]>=nx->ycorner &&
-						feld[k][1]<nx->ycorner+nx->csize*gx->nrows){
-					l=sqrt((nx->xcorner+nx->csize*j-feld[k][0])*
-					       (nx->xcorner+nx->csize*j-feld[k][0])+
-					       (nx->ycorner+nx->csize*(nx->nrows-i-1)
-					      		 -feld[k][1])*
-					      		 (nx->ycorner+nx->csize*(nx->nrows-i-1)
-					      				 -feld[k][1]));
-					if(val>l){
-						val=l;
-						count=k;
-					}
-				}
-			}
-			if(gx->feld[i][j]!=gx->nodata)
-				nx->feld[i][j]=feld[count][2];
+			int k=gx->feld[i][j]!=gx->nodata ? index.nearest(nx->xcorner+nx->csize*j,y) : -1;
+			if(k>=0)
+				nx->feld[i][j]=feld[k][2];
 			else
 				nx->feld[i][j]=nx->nodata;
 		}
-	}
-	fprintf(stderr,"p2g_voronoi: %d points are used\n",count);
+	});
+	fprintf(stderr,"p2g_voronoi: %d points are used\n",int(inside.size()));
 	return nx;
 }
 
@@ -5556,18 +5357,13 @@ void cluster::save_hasse(char *fname,int flag)
 grid* cluster::get_cluster()
 {
 	grid* gx = new grid((int)csize);
-	gx->ncols = ncols;
-	gx->nrows = nrows;
 	gx->xcorner = xcorner;
 	gx->ycorner = ycorner;
 	gx->csize = csize;
 	gx->nodata = nodata;
-	gx->feld = (float**) new float*[gx->nrows];
-	for(int i=0; i<gx->nrows; i++){
-		if((gx->feld[i]=new float[gx->ncols])==NULL){
-			cerr << "error (get_cluster): no sufficient memory" << endl;
-			exit(2);
-		}
+	if(!gx->allocate(nrows,ncols)){
+		cerr << "error (get_cluster): no sufficient memory" << endl;
+		exit(2);
 	}
 	for(int i=0; i<nrows; i++){
 		for(int j=0; j<ncols; j++){
@@ -5873,32 +5669,35 @@ region::~region()
 	}
 }
 
+// Maske der Region als 0/1 Gewichte (calc_count), nodata Zellen werden
+// in der Kachel zu 0, die innere Schleife kommt so ohne Verzweigungen aus
+void region::window_weights(vector<float>& w)
+{
+	w.resize(nrows*ncols);
+	for(int i=0; i<nrows; i++)
+		for(int j=0; j<ncols; j++)
+			w[i*ncols+j]=maske[i][j]>0 ? 1.0f : 0.0f;
+}
+
+// Summe, Mittel und Standardabweichung aus den summed-area tables der
+// Kacheln, die Maske ist in Rechtecke zerlegt (MOORE ein Rechteck, CIRCLE
+// Zeilenabschnitte), der Aufwand pro Zelle haengt nicht von der Flaeche ab
+//
+// Ergebnisse weichen von der urspruenglichen Version ab:
+// calc_sum: die Maske ist auch am Rand auf die Zelle zentriert (vorher
+//   maske[i-ax][j-ay], am oberen/linken Rand verschoben, betrifft CIRCLE,
+//   MOORE1, MOORE2), die Summe der ersten Zelle ist nicht mehr uninitialisiert
+// calc_std: Mittel und Anzahl nur ueber die Zellen der Maske (vorher zaehlten
+//   alle gueltigen Zellen des Quadrats), die Abweichungen ueber das ganze
+//   Fenster (vorher ohne letzte Zeile/Spalte, i<ex, j<ey), Maske wie bei
+//   calc_sum zentriert und ohne Zugriffe ausserhalb (maske[..][j-spalte-radius]);
+//   damit aendern sich auch bei MOORE fast alle Zellen
 void region::calc_sum(grid* g1, grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,erg;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata)
-						erg+=(maske[i-ax][j-ay]>0) ? val : 0;
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=0.0;
-		}
-	}
+	vector<WindowRect> rects=windowRects(maske,radius);
+	summedAreaMap(*g1,*ng,radius,false,[&](const SummedAreaTile& s,int zeile,int spalte){
+		return float(s.sums(zeile,spalte,rects).total());
+	},true);
 }
 
 double region::apen(vector<double> test, int mm, double r)
@@ -5944,8 +5743,6 @@ double region::apen(vector<double> test, int mm, double r)
 
 void region::calc_apen(grid* g1, grid* ng, int m)
 {
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,erg;
 	double sd,mean;
 	// calculate the standard deviation sd of the input grid
 	sd=mean=0.0;
@@ -5969,138 +5766,68 @@ void region::calc_apen(grid* g1, grid* ng, int m)
 	}
 	sd/=(count-1);
 	sd=sqrt(sd);
-	// calc apen in maks
-	vector<double> test(ncols*nrows);
-	count=0;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			count=0;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata)
-						test[count]=(double)val;
-					else
-						test[count]=mean;
-					count++;
-				}
-			}
-			erg=apen(test,m,0.2*sd);
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=0.0;
+	// calc apen in maks, nodata als Mittelwert
+	neighbourhoodMap(*g1,*ng,radius,float(mean),[&](const NeighbourhoodTile& t,int zeile,int spalte){
+		NeighbourhoodWindow f=t.window(zeile,spalte,radius);
+		vector<double> test;
+		for(int i=f.r0; i<=f.r1; i++){
+			const float* v=t.values(i,f.c0);
+			test.insert(test.end(),v,v+f.c1-f.c0+1);
 		}
-	}
+		return float(apen(test,m,0.2*sd));
+	},true);
 }
 
 void region::calc_hist(grid* g1, grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,erg=1.0;
-	mapType diversity;
-	mapType::iterator i_div;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			diversity.clear();
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						if(diversity.end()==diversity.find((int)val)){
-							diversity.insert(ValuePair((int)val,1));
-							// erg+=(maske[i-ax][j-ay]>0) ? 1 : 0;
-							erg+=1;
-						}
-					}
+	// 1 + Anzahl verschiedener (ganzzahliger) Werte im Fenster
+	forEachNeighbourhoodTile(*g1,radius,0.0f,[&](const NeighbourhoodTile& t){
+		vector<int> diversity;
+		for(int zeile=t.row(); zeile<t.endRow(); zeile++){
+			for(int spalte=t.col(); spalte<t.endCol(); spalte++){
+				if(ng->feld[zeile][spalte]==ng->nodata)
+					continue;
+				NeighbourhoodWindow f=t.window(zeile,spalte,radius);
+				diversity.clear();
+				for(int i=f.r0; i<=f.r1; i++){
+					const float* v=t.values(i,f.c0);
+					const float* o=t.valid(i,f.c0);
+					for(int j=0; j<=f.c1-f.c0; j++)
+						if(o[j]>0)
+							diversity.push_back((int)v[j]);
 				}
+				sort(diversity.begin(),diversity.end());
+				ng->feld[zeile][spalte]=
+						1.0f+float(unique(diversity.begin(),diversity.end())-diversity.begin());
 			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=1.0;
 		}
-	}
+	});
 }
 
 void region::calc_count(grid* g1, grid* ng, int value)
 {
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,erg;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata && (int)val==value)
-						erg+=
-								(maske[i-zeile+radius][j-spalte+radius]>0)
-								? val : 0;
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=0.0;
+	vector<float> w;
+	window_weights(w);
+	neighbourhoodMap(*g1,*ng,radius,0.0f,[&](const NeighbourhoodTile& t,int zeile,int spalte){
+		NeighbourhoodWindow f=t.window(zeile,spalte,radius);
+		float erg=0.0;
+		for(int i=f.r0; i<=f.r1; i++){
+			const float* v=t.values(i,f.c0);
+			const float* m=&w[(i-zeile+radius)*ncols+f.c0-spalte+radius];
+			for(int j=0; j<=f.c1-f.c0; j++)
+				erg+=(int(v[j])==value) ? m[j]*v[j] : 0.0f;
 		}
-	}
+		return erg;
+	},true);
 }
 
 void region::calc_mean(grid* g1,grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte,count=0;
-	float val,erg;
-	erg=0.0;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						if(maske[i-zeile+radius][j-spalte+radius]>0){
-							erg+=g1->feld[i][j];
-							count++;
-						}
-					}
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata){
-				if(count!=0)ng->feld[zeile][spalte]=erg/count;
-				else ng->feld[zeile][spalte]=0.0;
-			}
-			count=0;
-			erg=0.0;
-		}
-	}
+	vector<WindowRect> rects=windowRects(maske,radius);
+	summedAreaMap(*g1,*ng,radius,false,[&](const SummedAreaTile& s,int zeile,int spalte){
+		WindowSums w=s.sums(zeile,spalte,rects);
+		return w.count!=0 ? float(w.mean()) : 0.0f;
+	},true);
 }
 
 int Grids::compare(const void* e1, const void* e2)
@@ -6112,150 +5839,47 @@ int Grids::compare(const void* e1, const void* e2)
 
 void region::calc_median(grid* g1, grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte,count=0;
-	float val,erg;
-	float* vec=new float[4*(radius+1)*(radius+1)];
-	for(int k=0; k<4*(radius+1)*(radius+1); k++)
-		vec[k]=0.0;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						vec[count++]=
-								(maske[i-zeile+radius][j-spalte+radius]>0)
-								? val : 0;
-					}
-				}
-			}
-			qsort((void*)vec,(size_t)count,sizeof(float),compare);
-			if(ng->feld[zeile][spalte]!=ng->nodata){
-				if(count%2==0)
-					ng->feld[zeile][spalte]=0.5*(vec[count/2]+vec[count/2-1]);
-				else
-					ng->feld[zeile][spalte]=vec[count/2];
-			}
-			count=0;
-			erg=0.0;
-		}
-	}
-	delete [] vec;
+	calc_percentile(g1,ng,0.5);
+}
+
+// Perzentil der gueltigen Werte in der Maske ueber ein Histogramm der
+// Raenge, das zeilenweise ueber die Kachel geschoben wird
+void region::calc_percentile(grid* g1, grid* ng, double p)
+{
+	vector<WindowRect> rects=windowRects(maske,radius);
+	forEachNeighbourhoodTile(*g1,radius,0.0f,[&](const NeighbourhoodTile& t){
+		windowPercentile(t,rects,p,*ng,true);
+	});
 }
 
 void region::calc_std(grid* g1,grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte,count=0;
-	float val,erg,mean;
-	erg=0.0;
-	mean=0.0;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						mean+=(maske[i-zeile+radius][j-spalte-radius]>0)
-			    		? val : 0;
-						count++;
-					}
-				}
-			}
-			if(count!=0) mean/=count;
-			else mean=0;
-			for(int i=ax; i<ex; i++){
-				for(int j=ay; j<ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata)
-						erg+=(maske[i-ax][j-ay]>0) ?
-								(val-mean)*(val-mean) : 0;
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=sqrt(erg/(count-1));
-			mean=0.0;
-			count=0;
-			erg=0.0;
-		}
-	}
-}
-
-void  region::calc_min(grid* g1,grid* ng)
-{
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,zwsp,erg=FLT_MAX;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						zwsp = (maske[i-zeile+radius][j-spalte+radius]>0)
-			    		? val : FLT_MAX;
-						erg = (erg < zwsp) ? erg : zwsp;
-					}
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=FLT_MAX;
-		}
-	}
+	vector<WindowRect> rects=windowRects(maske,radius);
+	summedAreaMap(*g1,*ng,radius,true,[&](const SummedAreaTile& s,int zeile,int spalte){
+		WindowSums w=s.sums(zeile,spalte,rects);
+		// wie bisher 0/-1 fuer leere Fenster, Rundung nicht negativ werden lassen
+		double erg=w.count!=0 ? w.squaredDeviations() : 0.0;
+		if(erg<0) erg=0;
+		return float(sqrt(erg/(w.count-1)));
+	},true);
+}
+
+// Minimum/Maximum mit laufenden Extrema (van Herk/Gil-Werman) je Rechteck
+// der Maske, nodata zaehlt nicht, leere Fenster ergeben +-FLT_MAX
+void region::calc_min(grid* g1,grid* ng)
+{
+	vector<WindowRect> rects=windowRects(maske,radius);
+	forEachNeighbourhoodTile(*g1,radius,FLT_MAX,[&](const NeighbourhoodTile& t){
+		windowExtremum(t,rects,false,*ng,true);
+	});
 }
 
 void region::calc_max(grid* g1, grid* ng)
 {
-	int ax,ay,ex,ey,zeile,spalte;
-	float val,zwsp,erg=-FLT_MAX;
-	for(zeile=0; zeile<g1->nrows; zeile++){
-		ax=zeile-radius;
-		if(ax<0) ax=0;
-		ex=zeile+radius;
-		if(ex>=g1->nrows) ex=g1->nrows-1;
-		for(spalte=0; spalte<g1->ncols; spalte++){
-			ay=spalte-radius;
-			if(ay<0) ay=0;
-			ey=spalte+radius;
-			if(ey>=g1->ncols)ey=g1->ncols-1;
-			for(int i=ax; i<=ex; i++){
-				for(int j=ay; j<=ey; j++){
-					val = g1->feld[i][j];
-					if(int(val)!=g1->nodata){
-						zwsp = (maske[i-zeile+radius][j-spalte+radius]>0)
-			    		? val : 0;
-						erg = (erg > zwsp) ? erg : zwsp;
-					}
-				}
-			}
-			if(ng->feld[zeile][spalte]!=ng->nodata)
-				ng->feld[zeile][spalte]=erg;
-			erg=-FLT_MAX;
-		}
-	}
+	vector<WindowRect> rects=windowRects(maske,radius);
+	forEachNeighbourhoodTile(*g1,radius,-FLT_MAX,[&](const NeighbourhoodTile& t){
+		windowExtremum(t,rects,true,*ng,true);
+	});
 }
 
 // Interpolations 21.10.2002
@@ -6282,54 +5906,53 @@ grid* grid::shepard(int c, int r, int R, float mu)
 	}
 	cerr << "shepard: " << gridmean << endl;
 	grid* gx = new grid((int)csize);
-	gx->ncols = c;
-	gx->nrows = r;
 	gx->xcorner = xcorner;
 	gx->ycorner = ycorner;
 	gx->csize = csize*sqrt((double((nrows*ncols))/(c*r)));
 	gx->nodata = nodata;
-	gx->feld = (float**) new float*[gx->nrows];
-	for(int i=0; i<gx->nrows; i++){
-		if((gx->feld[i]=new float[gx->ncols])==NULL){
-			cerr << "error (grid::shepard): no sufficient memory" << endl;
-		}
+	if(!gx->allocate(r,c)){
+		cerr << "error (grid::shepard): no sufficient memory" << endl;
+		return gx;
 	}
-	float wxy, wz, dist, radius, phi;//, sci;
-	int lx,ly;
-	float dly,dlx;
+	float radius;
 	int fx,fy;
 	fx=c/ncols;
 	fy=r/nrows;
 	radius=sqrt((double)(R+1)*(R+1)+(R+1)*(R+1));
 	cerr << " radius: " << radius
 	<< " R: " << R << " mu: " << mu << endl;
-	for(int i=0; i<gx->nrows; i++){
-		for(int j=0; j<gx->ncols; j++){
-			wxy=wz=0.0;
-			lx=(int)i/fy;
-			ly=(int)j/fx;
-			dlx=(float)(i%fy)/fy;
-			dly=(float)(j%fx)/fx;
-			// cerr << "dlx " << dlx << " dly: " << dly << endl;
-			for(int k=-R; k<=R; k++){
-				for(int l=-R; l<=R; l++){
-					dist=sqrt((k-dlx)*(k-dlx)+(l-dly)*(l-dly));
-					if(dist<radius)phi=1.0-dist/radius;
-					if(lx+k>=0 && lx+k<nrows && ly+l>=0
-							&& ly+l<ncols && phi>0){
-						if(int(feld[lx+k][ly+l])!=nodata){
-							wz+=pow(phi,mu)*feld[lx+k][ly+l];
-							wxy+=pow(phi,mu);
+	// kachelweise ueber das Zielgrid
+	forEachTile(gx->nrows,gx->ncols,[&](const Tools::Tile& t){
+		float wxy, wz, dist, phi=0;
+		int lx,ly;
+		float dly,dlx;
+		for(int i=int(t.row); i<int(t.row+t.rows); i++){
+			for(int j=int(t.col); j<int(t.col+t.cols); j++){
+				wxy=wz=0.0;
+				lx=(int)i/fy;
+				ly=(int)j/fx;
+				dlx=(float)(i%fy)/fy;
+				dly=(float)(j%fx)/fx;
+				for(int k=-R; k<=R; k++){
+					for(int l=-R; l<=R; l++){
+						dist=sqrt((k-dlx)*(k-dlx)+(l-dly)*(l-dly));
+						if(dist<radius)phi=1.0-dist/radius;
+						if(lx+k>=0 && lx+k<nrows && ly+l>=0
+								&& ly+l<ncols && phi>0){
+							if(int(feld[lx+k][ly+l])!=nodata){
+								wz+=pow(phi,mu)*feld[lx+k][ly+l];
+								wxy+=pow(phi,mu);
+							}
 						}
 					}
 				}
+				if(wz>0 && wxy>0)
+					gx->feld[i][j]=wz/wxy;
+				else
+					gx->feld[i][j]=nodata;
 			}
-			if(wz>0 && wxy>0)
-				gx->feld[i][j]=wz/wxy;
-			else
-				gx->feld[i][j]=nodata;
 		}
-	}
+	});
 	return gx;
 }
 
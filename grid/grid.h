@@ -91,10 +91,18 @@ namespace Grids
 		static std::list<std::string> allDatasetNames(const char* fileName);
 
 		// data read/write
+		// Felder werden als 2-D Datasets [NX][NY] geschrieben, gechunkt und
+		// mit shuffle+deflate gepackt; 1-D Datasets alter Files bleiben lesbar
+		void set_chunking(int,int,int);                   // chunk rows,cols,deflate 0..9 (0: off)
 		void write_i_feld(const char*,int*,int,int);      // name,feld[NX*NY],NX,NY
 		void write_f_feld(const char*,float*,int,int);
 		int* read_i_feld(const char*);
 		float* read_f_feld(const char*);
+		int read_f_feld(const char*,float*,size_t);       // name,target[N],N (no copy)
+		int read_f_feld(const char*,float*,size_t,size_t,size_t,size_t,size_t);
+		                          // name,target[ROWS*COLS],TOP,LEFT,ROWS,COLS,NCOLS (window)
+		void write_feld(const char*,hid_t,const void*,int,int);  // name,memtype,feld,NX,NY
+		int read_feld(const char*,hid_t,void*,size_t);    // name,memtype,target[N],N (converted)
 		// attributes
 		int write_s_attribute(const char*,const char*);         // attribute_name,data
 		int write_f_attribute(const char*,float);
@@ -110,7 +118,9 @@ namespace Grids
 		int* i1;
 		float* f1;
 	protected:
+		hid_t create_plist(int,int);
 		hid_t file, dataset;
+		int chunk_rows, chunk_cols, deflate;
 	};
 #endif
 #endif //NO_HDF5
@@ -153,17 +163,31 @@ namespace Grids
 		grid(int,int);          // Rand_grid of size nrows, ncols
 		~grid();
 
+		// Speicherverwaltung fuer feld: alle Zeilen liegen in einem
+		// zusammenhaengenden, 64-Byte ausgerichteten Block (row-major),
+		// feld[i] zeigt auf den Anfang der Zeile i in diesem Block
+		bool allocate(size_t,size_t); // nrows, ncols (values undefined)
+		// fremder Block (z.B. gemappte Datei), release() ruft free_fn(owner)
+		bool attach(float*,size_t,size_t,void (*free_fn)(void*),void* owner);
+		void release();              // frees feld and block
+		float* data() { return block; }             // first element of row 0
+		const float* data() const { return block; }
+		size_t stride() const { return ncols; }     // elements between rows
+
 		// read in points an put it in the grid
 		int read_ascii(const char*);   // ASCII-Grid name
 		int read_ascii_inv(const char*);   // ASCII-Grid name
-		void write_ascii(char*);   // ASCII-Grid name
-		void write_ascii_inv(char*);   // ASCII-Grid name y=nrows-y
+		void write_ascii(char*,int precision=3);   // ASCII-Grid name, digits (-1: shortest)
+		void write_ascii_inv(char*,int precision=3);   // ASCII-Grid name y=nrows-y
 #ifndef NO_HDF5
 		bool write_hdf(char*,char*,char*,char*);
 		// hdf-File_name, datasetname, Autor, Modell
 		int read_hdf(char*,char*);
 #endif
 		// hdf-File_name, datasetname
+		// native binary grid (binary-grid.h), the data is mapped, not read
+		int read_binary(const char*);   // file name
+		bool write_binary(const char*); // file name
 		void write_pnm(char*,int); // filename, (0,1) 0=bw 1=f
 		void write_pnm_inv(char*,int); // filename, (0,1) 0=bw 1=f
 		void write_pnm_b(char*,int); // filename, (0,1) 0=bw 1=f
@@ -204,7 +228,7 @@ namespace Grids
 		void attraktivitaet(grid*,int,int,float,float,float);
 		// im,jm (Mittelpunkt) alpha,sigma,gamma
 		// some algorithms for erosionsmodelling
-		void w_fill();         // fills sink cells in the grid
+		void w_fill(float epsilon=0); // fills all depressions, epsilon>0 keeps a gradient
 		grid* w_focalflow();   // calculates a possible in flowdirection
 		grid* w_d8();     // calc flow from dir and elevation
 		// e:1 se:2 s:4 sw:8 w:16 nw:32 n:64 ne:128
@@ -224,6 +248,7 @@ namespace Grids
 		grid* combine_grid(grid*,float (*f)(float,float));
 		grid* combine_grid(grid*,grid*,float (*f)(float,float,float));
 		grid* distance(float); // distance grid to a selected value
+		grid* allocation(float); // value of the nearest cell !=background (and !=nodata)
 		grid* difference(grid*); // difference between two grids
 		grid* sobol();         // some filter algorithm
 		grid* edge();          // edge detection algoritm
@@ -242,10 +267,9 @@ namespace Grids
 		//grid* convolution(int); // convoultion of a grid with a gaussian bell shape
 		//grid* akf();           // auto corelation function of a grid
 		grid* rotate(int);   // rotation of a grid with angle ß
-		grid* visuability(point*);
-		grid* flood_fill(grid*,int,int,float);
+		grid* visuability(point*,int algorithm=0); // viewshed of the points, 0 exact, 1 R2, 2 XDraw (viewshed.h)
+		grid* flood_fill(grid*,int,int,float); // region < start+val around (x,y) gets -1 in gx (components.h)
 //		grid* tree_grid(float); // tree mosaic algorithm
-		// flood fill algorithm wit stack
 		grid* delta_diff(grid *g1); // fabs(gx-g1)/gx
 		point *sample(int number, int flag); // generates a sample
 		// altes Grid=combine_grid(grid,selector,flag)
@@ -256,7 +280,10 @@ namespace Grids
 		float obv,ebv,sigmabv;
 		float variance1,variance2,covariance;
 		int minx,miny,maxx,maxy; // Ergebnisse stat Koordinaten
-		float **feld;           // Feld[nrows][ncols]
+		float **feld;           // Feld[nrows][ncols], Zeilenindex in block
+		float *block;           // Feld als ein Block nrows*stride()
+		void (*block_free)(void*); // != NULL: block gehoert block_owner
+		void *block_owner;
 		int has_nodata;         // yes=1 no=0 unknown=-1
 		int nodata;
 		int rgr;                // Rastergroesse
@@ -270,6 +297,11 @@ namespace Grids
 		bool variance_flag;
 	};
 
+	// leeres grid mit dem Header von g (Groesse, Lage, Zellgroesse, nodata; Werte undefiniert)
+	grid* gridLike(const grid& g);
+
+	// veraltet: wird von flood_fill nicht mehr benutzt (components.h),
+	// bleibt vorerst fuer externe Nutzer und wird spaeter entfernt
 	class stack2i{
 	public:
 		stack2i(int);
@@ -430,7 +462,8 @@ namespace Grids
 		void calc_count(grid*,grid*,int); // counts if val==value
 		void calc_sum(grid*,grid*);       // grid:=sum(grid & mask)
 		void calc_mean(grid*,grid*);      // grid:=mean(grid & mask)
-		void calc_median(grid*,grid*);    // grid:=mean(grid & mask)
+		void calc_median(grid*,grid*);    // grid:=median(grid & mask)
+		void calc_percentile(grid*,grid*,double); // grid:=percentile(grid & mask), p=0..1
 		void calc_std(grid*,grid*);       // grid:=std(grid & mask)
 		void calc_min(grid*,grid*);       // grid:=min(grid & mask)
 		void calc_max(grid*,grid*);       // grid:=max(grid & mask)
@@ -440,6 +473,7 @@ namespace Grids
 		int** maske;
 		int radius, ncols, nrows;
 		double apen(std::vector<double>,int,double); // apen(pattern,m,r)
+		void window_weights(std::vector<float>&);     // maske as 0/1, row-major
 	};
 
 
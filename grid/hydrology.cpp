@@ -0,0 +1,809 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "hydrology.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	const int dRow[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+	const int dCol[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+
+	//! cell in the priority queue, lowest first, then the first pushed
+	struct FloodCell
+	{
+		FloodCell(float z, size_t order, int row, int col)
+			: z(z), order(order), row(row), col(col) {}
+
+		bool operator>(const FloodCell& other) const
+		{
+			return z > other.z || (z == other.z && order > other.order);
+		}
+
+		float z;
+		size_t order;
+		int row, col;
+	};
+
+	typedef priority_queue<FloodCell, vector<FloodCell>, greater<FloodCell> > FloodQueue;
+
+	/*!
+	 * priority flood over the cells [r0, r1) x [c0, c1) of dem from the
+	 * already pushed seeds, closed(r, c) marks the cells of the area which are
+	 * reached or no data, visit(r, c) is called for every cell taken from the
+	 * queues, meet(from, to) for neighbours which are closed already (to see
+	 * where floods meet), label(from, to) for the cells reached
+	 */
+	template<class Closed, class Visit, class Meet, class Label>
+	void flood(grid& dem, int r0, int r1, int c0, int c1, float epsilon,
+						 FloodQueue& open, size_t& order,
+						 Closed closed, Visit visit, Meet meet, Label label)
+	{
+		queue<pair<int, int> > pit;
+		while(!open.empty() || !pit.empty())
+		{
+			int r, c;
+			//the raised cells first, with epsilon they can be higher than the open ones
+			if(!pit.empty()
+				 && (open.empty() || epsilon <= 0
+						 || dem.feld[pit.front().first][pit.front().second] < open.top().z))
+			{
+				r = pit.front().first;
+				c = pit.front().second;
+				pit.pop();
+			}
+			else
+			{
+				r = open.top().row;
+				c = open.top().col;
+				open.pop();
+			}
+			visit(r, c);
+
+			float z = dem.feld[r][c];
+			float level = epsilon > 0 ? max(z + epsilon, nextafterf(z, FLT_MAX)) : z;
+			for(int k = 0; k < 8; k++)
+			{
+				int nr = r + dRow[k], nc = c + dCol[k];
+				if(nr < r0 || nr >= r1 || nc < c0 || nc >= c1)
+					continue;
+				if(closed(nr, nc))
+				{
+					meet(r, c, nr, nc);
+					continue;
+				}
+				label(r, c, nr, nc);
+				float& zn = dem.feld[nr][nc];
+				if(zn <= level)
+				{
+					zn = level;
+					pit.push(make_pair(nr, nc));
+				}
+				else
+					open.push(FloodCell(zn, order++, nr, nc));
+			}
+		}
+	}
+
+	//! lowest elevation water spills over from one label to another, per pair of labels (low, high)
+	typedef unordered_map<uint64_t, float> Spills;
+
+	void addSpill(Spills& spills, int a, int b, float z)
+	{
+		uint64_t key = (uint64_t(min(a, b)) << 32) | uint64_t(max(a, b));
+		Spills::iterator it = spills.find(key);
+		if(it == spills.end())
+			spills.insert(make_pair(key, z));
+		else if(z < it->second)
+			it->second = z;
+	}
+}
+
+void Grids::fillDepressions(grid& dem, float epsilon)
+{
+	int rows = int(dem.nrows), cols = int(dem.ncols);
+	vector<unsigned char> closed(size_t(rows)*cols, 0);
+	auto isNoData = [&](int r, int c) { return isNoDataValue(dem.feld[r][c], dem.nodata); };
+
+	FloodQueue open;
+	size_t order = 0;
+	for(int r = 0; r < rows; r++)
+		for(int c = 0; c < cols; c++)
+		{
+			if(isNoData(r, c))
+			{
+				closed[size_t(r)*cols + c] = 1;
+				continue;
+			}
+			bool outlet = r == 0 || c == 0 || r == rows - 1 || c == cols - 1;
+			for(int k = 0; k < 8 && !outlet; k++)
+				outlet = isNoData(r + dRow[k], c + dCol[k]);
+			if(outlet)
+			{
+				closed[size_t(r)*cols + c] = 1;
+				open.push(FloodCell(dem.feld[r][c], order++, r, c));
+			}
+		}
+
+	flood(dem, 0, rows, 0, cols, epsilon, open, order,
+				[&](int r, int c) { return closed[size_t(r)*cols + c] != 0; },
+				[](int, int) {},
+				[](int, int, int, int) {},
+				[&](int, int, int r, int c) { closed[size_t(r)*cols + c] = 1; });
+}
+
+void Grids::fillDepressionsTiled(grid& dem, int tileSize, Tools::ExecutionPolicy policy)
+{
+	int rows = int(dem.nrows), cols = int(dem.ncols);
+	tileSize = max(tileSize, 2);
+	if(!Tools::isParallel(policy) || (rows <= tileSize && cols <= tileSize))
+	{
+		fillDepressions(dem);
+		return;
+	}
+
+	int tileRows = (rows + tileSize - 1) / tileSize, tileCols = (cols + tileSize - 1) / tileSize;
+	auto tileOf = [&](int r, int c) { return (r / tileSize)*tileCols + c / tileSize; };
+	auto isNoData = [&](int r, int c) { return isNoDataValue(dem.feld[r][c], dem.nodata); };
+
+	//1. fill every tile from its perimeter, a seed not reached from another one
+	//gets a new label, label 0 = the outside of the grid, the labels of a tile
+	//are 1.., unique after adding the tile's offset
+	vector<int> labels(size_t(rows)*cols, 0);
+	vector<int> labelCount(size_t(tileRows)*tileCols, 0);
+	vector<Spills> spills(labelCount.size());
+	Tools::defaultThreadPool().parallelForTiles(rows, cols, tileSize, tileSize, [&](const Tools::Tile& t)
+	{
+		int r0 = int(t.row), r1 = int(t.row + t.rows), c0 = int(t.col), c1 = int(t.col + t.cols);
+		int tile = tileOf(r0, c0), count = 0;
+		Spills& s = spills[tile];
+		//1 = no data, 2 = outlet
+		vector<unsigned char> flags(t.rows*t.cols, 0);
+		auto isClosed = [&](int r, int c)
+		{
+			return labels[size_t(r)*cols + c] != 0 || flags[size_t(r - r0)*t.cols + (c - c0)] == 1;
+		};
+
+		FloodQueue open;
+		size_t order = 0;
+		for(int r = r0; r < r1; r++)
+			for(int c = c0; c < c1; c++)
+			{
+				size_t i = size_t(r - r0)*t.cols + (c - c0);
+				if(isNoData(r, c))
+				{
+					flags[i] = 1;
+					continue;
+				}
+				bool perimeter = r == r0 || c == c0 || r == r1 - 1 || c == c1 - 1;
+				bool outlet = r == 0 || c == 0 || r == rows - 1 || c == cols - 1;
+				//no data in other tiles is looked at in 2.
+				for(int k = 0; k < 8 && !outlet; k++)
+				{
+					int nr = r + dRow[k], nc = c + dCol[k];
+					outlet = nr >= r0 && nr < r1 && nc >= c0 && nc < c1 && isNoData(nr, nc);
+				}
+				if(outlet)
+					flags[i] = 2;
+				if(perimeter || outlet)
+					open.push(FloodCell(dem.feld[r][c], order++, r, c));
+			}
+
+		flood(dem, r0, r1, c0, c1, 0, open, order, isClosed,
+					[&](int r, int c)
+		{
+			int& l = labels[size_t(r)*cols + c];
+			if(l == 0)
+				l = ++count;
+			if(flags[size_t(r - r0)*t.cols + (c - c0)] == 2)
+				addSpill(s, 0, l, dem.feld[r][c]);
+		},
+					[&](int r, int c, int nr, int nc)
+		{
+			int a = labels[size_t(r)*cols + c], b = labels[size_t(nr)*cols + nc];
+			if(b != 0 && a != b)
+				addSpill(s, a, b, max(dem.feld[r][c], dem.feld[nr][nc]));
+		},
+					[&](int r, int c, int nr, int nc)
+		{
+			labels[size_t(nr)*cols + nc] = labels[size_t(r)*cols + c];
+		});
+		labelCount[tile] = count;
+	});
+
+	vector<int> offset(labelCount.size() + 1, 0);
+	for(size_t t = 0; t < labelCount.size(); t++)
+		offset[t + 1] = offset[t] + labelCount[t];
+	auto globalLabel = [&](int r, int c)
+	{
+		int l = labels[size_t(r)*cols + c];
+		return l == 0 ? 0 : offset[tileOf(r, c)] + l;
+	};
+
+	//2. spill graph of all labels: within the tiles and over the tile borders
+	vector<vector<pair<int, float> > > graph(offset.back() + 1);
+	auto connect = [&](int a, int b, float z)
+	{
+		graph[a].push_back(make_pair(b, z));
+		graph[b].push_back(make_pair(a, z));
+	};
+	for(size_t t = 0; t < spills.size(); t++)
+		for(Spills::const_iterator it = spills[t].begin(); it != spills[t].end(); ++it)
+		{
+			int a = int(it->first >> 32), b = int(it->first & 0xffffffff);
+			connect(a == 0 ? 0 : offset[t] + a, offset[t] + b, it->second);
+		}
+	for(int r = 0; r < rows; r++)
+		for(int c = 0; c < cols; c++)
+		{
+			bool perimeter = r % tileSize == 0 || c % tileSize == 0
+											 || r % tileSize == tileSize - 1 || c % tileSize == tileSize - 1;
+			if(!perimeter || isNoData(r, c))
+				continue;
+			int a = globalLabel(r, c);
+			for(int k = 0; k < 8; k++)
+			{
+				int nr = r + dRow[k], nc = c + dCol[k];
+				if(nr < 0 || nr >= rows || nc < 0 || nc >= cols || tileOf(nr, nc) == tileOf(r, c))
+					continue;
+				if(isNoData(nr, nc))
+					connect(a, 0, dem.feld[r][c]);
+				else if(tileOf(nr, nc) > tileOf(r, c))
+					connect(a, globalLabel(nr, nc), max(dem.feld[r][c], dem.feld[nr][nc]));
+			}
+		}
+
+	//3. water level of every label: lowest spill elevation on a path to the outside
+	vector<float> level(graph.size(), FLT_MAX);
+	vector<unsigned char> done(graph.size(), 0);
+	priority_queue<pair<float, int>, vector<pair<float, int> >, greater<pair<float, int> > > pending;
+	level[0] = -FLT_MAX;
+	pending.push(make_pair(level[0], 0));
+	while(!pending.empty())
+	{
+		int a = pending.top().second;
+		pending.pop();
+		if(done[a])
+			continue;
+		done[a] = 1;
+		for(size_t i = 0; i < graph[a].size(); i++)
+		{
+			int b = graph[a][i].first;
+			float z = max(level[a], graph[a][i].second);
+			if(z < level[b])
+			{
+				level[b] = z;
+				pending.push(make_pair(z, b));
+			}
+		}
+	}
+
+	//4. raise the cells to the water level of their label
+	Tools::defaultThreadPool().parallelFor(size_t(rows), [&](size_t r)
+	{
+		for(int c = 0; c < cols; c++)
+		{
+			if(isNoData(int(r), c))
+				continue;
+			float l = level[globalLabel(int(r), c)];
+			if(l != FLT_MAX && dem.feld[r][c] < l)
+				dem.feld[r][c] = l;
+		}
+	});
+}
+
+namespace
+{
+	//! tiles the D8 functions work on in parallel
+	const int d8TileSize = 512;
+
+	//! D8 code -> index into dRow/dCol, -1 if the flow ends
+	int d8Index(float code)
+	{
+		switch(int(code))
+		{
+		case 1: return 0;
+		case 2: return 1;
+		case 4: return 2;
+		case 8: return 3;
+		case 16: return 4;
+		case 32: return 5;
+		case 64: return 6;
+		case 128: return 7;
+		default: return -1;
+		}
+	}
+
+	struct D8Tile
+	{
+		bool contains(int r, int c) const { return r >= r0 && r < r1 && c >= c0 && c < c1; }
+
+		int index, r0, r1, c0, c1;
+	};
+
+	/*!
+	 * the cell (row major index) every cell of a D8 direction grid drains to
+	 * and the tiles it is processed in (one tile if sequential)
+	 */
+	class D8Flow
+	{
+	public:
+		D8Flow(const grid& dir, Tools::ExecutionPolicy policy)
+			: rows(int(dir.nrows)), cols(int(dir.ncols)),
+				receiver(size_t(rows)*cols, -1), valid(receiver.size(), 0),
+				_parallel(Tools::isParallel(policy)),
+				_tileSize(_parallel ? d8TileSize : max(max(rows, cols), 1)),
+				_tileCols((cols + _tileSize - 1) / _tileSize)
+		{
+			forEachRow([&](int r)
+			{
+				for(int c = 0; c < cols; c++)
+				{
+					if(isNoDataValue(dir.feld[r][c], dir.nodata))
+						continue;
+					valid[index(r, c)] = 1;
+					int k = d8Index(dir.feld[r][c]);
+					if(k < 0)
+						continue;
+					int nr = r + dRow[k], nc = c + dCol[k];
+					if(nr >= 0 && nr < rows && nc >= 0 && nc < cols
+						 && !isNoDataValue(dir.feld[nr][nc], dir.nodata))
+						receiver[index(r, c)] = index(nr, nc);
+				}
+			});
+		}
+
+		int index(int r, int c) const { return r*cols + c; }
+
+		size_t tileCount() const
+		{
+			return size_t((rows + _tileSize - 1) / _tileSize)*_tileCols;
+		}
+
+		int tileOf(int i) const
+		{
+			return (i / cols / _tileSize)*_tileCols + i % cols / _tileSize;
+		}
+
+		template<class F>
+		void forEachRow(F f) const
+		{
+			if(_parallel)
+				Tools::defaultThreadPool().parallelFor(size_t(rows), [&](size_t r) { f(int(r)); });
+			else
+				for(int r = 0; r < rows; r++)
+					f(r);
+		}
+
+		//! f(const D8Tile&) for all tiles
+		template<class F>
+		void forEachTile(F f) const
+		{
+			Tools::defaultThreadPool().parallelForTiles(size_t(rows), size_t(cols),
+																									size_t(_tileSize), size_t(_tileSize),
+																									[&](const Tools::Tile& t)
+			{
+				D8Tile tile;
+				tile.r0 = int(t.row);
+				tile.r1 = int(t.row + t.rows);
+				tile.c0 = int(t.col);
+				tile.c1 = int(t.col + t.cols);
+				tile.index = tileOf(index(tile.r0, tile.c0));
+				f(tile);
+			});
+		}
+
+		/*!
+		 * topological order of the valid cells of tile (Kahn: a cell after the
+		 * cells of the tile draining into it), cells on cycles are left out
+		 * @param last if not NULL for the cells of the tile (row major within the
+		 * tile) the last cell of their flow path within the tile, -1 on cycles
+		 */
+		void order(const D8Tile& tile, vector<int>& cells, vector<int>* last = NULL) const
+		{
+			int width = tile.c1 - tile.c0;
+			auto local = [&](int i) { return (i / cols - tile.r0)*width + i % cols - tile.c0; };
+			auto inTile = [&](int i) { return i >= 0 && tile.contains(i / cols, i % cols); };
+
+			vector<unsigned char> pending(size_t(tile.r1 - tile.r0)*width, 0);
+			for(int r = tile.r0; r < tile.r1; r++)
+				for(int c = tile.c0; c < tile.c1; c++)
+				{
+					int j = receiver[index(r, c)];
+					if(inTile(j))
+						pending[local(j)]++;
+				}
+			cells.clear();
+			for(int r = tile.r0; r < tile.r1; r++)
+				for(int c = tile.c0; c < tile.c1; c++)
+					if(valid[index(r, c)] && pending[local(index(r, c))] == 0)
+						cells.push_back(index(r, c));
+			for(size_t k = 0; k < cells.size(); k++)
+			{
+				int j = receiver[cells[k]];
+				if(inTile(j) && --pending[local(j)] == 0)
+					cells.push_back(j);
+			}
+
+			if(!last)
+				return;
+			last->assign(pending.size(), -1);
+			for(size_t k = cells.size(); k-- > 0;)
+			{
+				int i = cells[k], j = receiver[i];
+				(*last)[local(i)] = inTile(j) ? (*last)[local(j)] : i;
+			}
+		}
+
+		/*!
+		 * the last cells within the tile of the flow paths starting at the
+		 * perimeter of tile (where flow from other tiles enters)
+		 */
+		void perimeterLast(const D8Tile& tile, const vector<int>& last,
+											 unordered_map<int, int>& entries) const
+		{
+			int width = tile.c1 - tile.c0;
+			for(int r = tile.r0; r < tile.r1; r++)
+				for(int c = tile.c0; c < tile.c1;
+						c += r == tile.r0 || r == tile.r1 - 1 ? 1 : max(width - 1, 1))
+					if(valid[index(r, c)])
+						entries[index(r, c)] = last[(r - tile.r0)*width + c - tile.c0];
+		}
+
+		//! cell i is the last one of its tile on its flow path, but the path goes on
+		bool isExit(int i) const { return receiver[i] >= 0 && tileOf(receiver[i]) != tileOf(i); }
+
+		int rows, cols;
+		//! row major index of the cell a cell drains to, -1 if its flow ends
+		vector<int> receiver;
+		vector<unsigned char> valid;
+
+	private:
+		bool _parallel;
+		int _tileSize, _tileCols;
+	};
+
+	/*!
+	 * label every valid cell with terminalLabel(i) of the cell i its flow path
+	 * ends in (receiver < 0), 0 if the path runs into a cycle
+	 */
+	template<class Label>
+	grid* labelFlowPaths(const grid& dir, const D8Flow& flow, Label terminalLabel)
+	{
+		//1. last cell of every flow path within its tile
+		vector<int> last(flow.receiver.size(), -1);
+		vector<unordered_map<int, int> > entries(flow.tileCount());
+		flow.forEachTile([&](const D8Tile& tile)
+		{
+			vector<int> cells, tileLast;
+			flow.order(tile, cells, &tileLast);
+			int width = tile.c1 - tile.c0;
+			for(int r = tile.r0; r < tile.r1; r++)
+				for(int c = tile.c0; c < tile.c1; c++)
+					last[flow.index(r, c)] = tileLast[(r - tile.r0)*width + c - tile.c0];
+			flow.perimeterLast(tile, tileLast, entries[tile.index]);
+		});
+
+		//2. follow the exits from tile to tile to the end of their paths,
+		//-2 marks exits on the current path to detect cycles over the tiles
+		unordered_map<int, int> exitEnd;
+		vector<int> path;
+		for(size_t t = 0; t < entries.size(); t++)
+			for(unordered_map<int, int>::const_iterator it = entries[t].begin(); it != entries[t].end(); ++it)
+			{
+				int i = it->second;
+				path.clear();
+				while(i >= 0 && flow.isExit(i))
+				{
+					unordered_map<int, int>::const_iterator known = exitEnd.find(i);
+					if(known != exitEnd.end())
+					{
+						i = known->second == -2 ? -1 : known->second;
+						break;
+					}
+					exitEnd[i] = -2;
+					path.push_back(i);
+					int e = flow.receiver[i];
+					i = entries[flow.tileOf(e)].find(e)->second;
+				}
+				for(size_t k = 0; k < path.size(); k++)
+					exitEnd[path[k]] = i;
+			}
+
+		grid* gx = gridLike(dir);
+		flow.forEachRow([&](int r)
+		{
+			for(int c = 0; c < flow.cols; c++)
+			{
+				int i = flow.index(r, c);
+				if(!flow.valid[i])
+				{
+					gx->feld[r][c] = float(dir.nodata);
+					continue;
+				}
+				int end = last[i];
+				if(end >= 0 && flow.isExit(end))
+					end = exitEnd.find(end)->second;
+				gx->feld[r][c] = end < 0 ? 0 : terminalLabel(end);
+			}
+		});
+		return gx;
+	}
+}
+
+grid* Grids::flowAccumulation(const grid& dir, const grid* weights, Tools::ExecutionPolicy policy)
+{
+	D8Flow flow(dir, policy);
+	int cols = flow.cols;
+	vector<double> acc(flow.receiver.size(), 0);
+	auto ownWeight = [&](int i) -> double
+	{
+		if(!weights)
+			return 1;
+		float w = weights->feld[i / cols][i % cols];
+		return isNoDataValue(w, weights->nodata) ? 0 : w;
+	};
+
+	//1. accumulate within the tiles, cells on cycles within a tile are the ones
+	//left out of its order, they keep their own weight
+	vector<unsigned char> onCycle(flow.receiver.size(), 0);
+	vector<vector<int> > exits(flow.tileCount());
+	vector<unordered_map<int, int> > entries(flow.tileCount());
+	flow.forEachTile([&](const D8Tile& tile)
+	{
+		for(int r = tile.r0; r < tile.r1; r++)
+			for(int c = tile.c0; c < tile.c1; c++)
+			{
+				int i = flow.index(r, c);
+				if(flow.valid[i])
+				{
+					acc[i] = ownWeight(i);
+					onCycle[i] = 1;
+				}
+			}
+		vector<int> cells, last;
+		flow.order(tile, cells, &last);
+		for(size_t k = 0; k < cells.size(); k++)
+			onCycle[cells[k]] = 0;
+		for(size_t k = 0; k < cells.size(); k++)
+		{
+			int i = cells[k], j = flow.receiver[i];
+			if(j < 0)
+				continue;
+			if(!tile.contains(j / cols, j % cols))
+				exits[tile.index].push_back(i);
+			else if(!onCycle[j])
+				acc[j] += acc[i];
+		}
+		flow.perimeterLast(tile, last, entries[tile.index]);
+	});
+
+	//2. the flow between the tiles: the flow leaving an exit enters another
+	//tile and on its path there reaches another exit, so the exits are taken
+	//in topological order too
+	vector<int> exitCells;
+	unordered_map<int, int> exitIds;
+	for(size_t t = 0; t < exits.size(); t++)
+		for(size_t k = 0; k < exits[t].size(); k++)
+		{
+			exitIds[exits[t][k]] = int(exitCells.size());
+			exitCells.push_back(exits[t][k]);
+		}
+	vector<int> next(exitCells.size(), -1), pending(exitCells.size(), 0);
+	for(size_t x = 0; x < exitCells.size(); x++)
+	{
+		int e = flow.receiver[exitCells[x]];
+		int end = entries[flow.tileOf(e)].find(e)->second;
+		unordered_map<int, int>::const_iterator it = end < 0 ? exitIds.end() : exitIds.find(end);
+		if(it != exitIds.end())
+		{
+			next[x] = it->second;
+			pending[it->second]++;
+		}
+	}
+	vector<int> ready;
+	for(size_t x = 0; x < exitCells.size(); x++)
+		if(pending[x] == 0)
+			ready.push_back(int(x));
+	vector<double> passed(exitCells.size(), 0);
+	vector<unordered_map<int, double> > inflow(flow.tileCount());
+	for(size_t k = 0; k < ready.size(); k++)
+	{
+		int x = ready[k], e = flow.receiver[exitCells[x]];
+		double out = acc[exitCells[x]] + passed[x];
+		inflow[flow.tileOf(e)][e] += out;
+		if(next[x] >= 0)
+		{
+			passed[next[x]] += out;
+			if(--pending[next[x]] == 0)
+				ready.push_back(next[x]);
+		}
+	}
+
+	//exits never ready are on cycles over the tiles, so are the cells from
+	//where their flow enters the next tile up to the next exit; like cycles
+	//within a tile they keep their own weight
+	for(size_t x = 0; x < exitCells.size(); x++)
+	{
+		if(pending[x] == 0)
+			continue;
+		for(int i = flow.receiver[exitCells[x]];; i = flow.receiver[i])
+		{
+			onCycle[i] = 1;
+			acc[i] = ownWeight(i);
+			if(i == exitCells[next[x]])
+				break;
+		}
+	}
+
+	//3. add the inflow from the other tiles along the paths within the tiles
+	flow.forEachTile([&](const D8Tile& tile)
+	{
+		const unordered_map<int, double>& in = inflow[tile.index];
+		if(in.empty())
+			return;
+		int width = tile.c1 - tile.c0;
+		auto local = [&](int i) { return (i / cols - tile.r0)*width + i % cols - tile.c0; };
+		vector<double> add(size_t(tile.r1 - tile.r0)*width, 0);
+		for(unordered_map<int, double>::const_iterator it = in.begin(); it != in.end(); ++it)
+			add[local(it->first)] = it->second;
+		vector<int> cells;
+		flow.order(tile, cells);
+		for(size_t k = 0; k < cells.size(); k++)
+		{
+			int i = cells[k], j = flow.receiver[i];
+			double a = add[local(i)];
+			if(a == 0 || onCycle[i])
+				continue;
+			acc[i] += a;
+			if(j >= 0 && tile.contains(j / cols, j % cols))
+				add[local(j)] += a;
+		}
+	});
+
+	grid* gx = gridLike(dir);
+	flow.forEachRow([&](int r)
+	{
+		for(int c = 0; c < cols; c++)
+		{
+			int i = flow.index(r, c);
+			gx->feld[r][c] = flow.valid[i] ? float(acc[i]) : float(dir.nodata);
+		}
+	});
+	return gx;
+}
+
+grid* Grids::basins(const grid& dir, Tools::ExecutionPolicy policy)
+{
+	D8Flow flow(dir, policy);
+	vector<int> number(flow.receiver.size(), 0);
+	int count = 0;
+	for(size_t i = 0; i < number.size(); i++)
+		if(flow.valid[i] && flow.receiver[i] < 0)
+			number[i] = ++count;
+	return labelFlowPaths(dir, flow, [&](int i) { return float(number[i]); });
+}
+
+grid* Grids::watersheds(const grid& dir, const vector<pair<int, int> >& pourPoints,
+												Tools::ExecutionPolicy policy)
+{
+	D8Flow flow(dir, policy);
+	unordered_map<int, int> number;
+	for(size_t p = 0; p < pourPoints.size(); p++)
+	{
+		int r = pourPoints[p].first, c = pourPoints[p].second;
+		if(r < 0 || r >= flow.rows || c < 0 || c >= flow.cols || !flow.valid[flow.index(r, c)])
+			continue;
+		//a flow path ends at its first pour point
+		flow.receiver[flow.index(r, c)] = -1;
+		number.insert(make_pair(flow.index(r, c), int(p) + 1));
+	}
+	return labelFlowPaths(dir, flow, [&](int i)
+	{
+		unordered_map<int, int>::const_iterator it = number.find(i);
+		return it == number.end() ? 0.0f : float(it->second);
+	});
+}
+
+grid* Grids::streamOrder(const grid& dir, const grid& accumulation, float threshold,
+												 StreamOrdering ordering, Tools::ExecutionPolicy policy)
+{
+	D8Flow flow(dir, policy);
+	int rows = flow.rows, cols = flow.cols;
+	vector<unsigned char> stream(flow.receiver.size(), 0);
+	flow.forEachRow([&](int r)
+	{
+		for(int c = 0; c < cols; c++)
+		{
+			float a = accumulation.feld[r][c];
+			stream[flow.index(r, c)] = flow.valid[flow.index(r, c)]
+																 && !isNoDataValue(a, accumulation.nodata) && a >= threshold;
+		}
+	});
+
+	//stream cells draining into a stream cell which aren't done yet
+	vector<unsigned char> pending(stream.size(), 0);
+	flow.forEachRow([&](int r)
+	{
+		for(int c = 0; c < cols; c++)
+		{
+			int i = flow.index(r, c);
+			if(!stream[i])
+				continue;
+			for(int k = 0; k < 8; k++)
+			{
+				int nr = r + dRow[k], nc = c + dCol[k];
+				if(nr >= 0 && nr < rows && nc >= 0 && nc < cols
+					 && stream[flow.index(nr, nc)] && flow.receiver[flow.index(nr, nc)] == i)
+					pending[i]++;
+			}
+		}
+	});
+
+	//only the stream cells in topological order, for Strahler the highest
+	//order flowing in and how often, for Shreve the sum of the inflows
+	vector<int> order(stream.size(), 0), upper(stream.size(), 0);
+	vector<unsigned char> upperCount(stream.size(), 0);
+	vector<int> cells;
+	for(size_t i = 0; i < stream.size(); i++)
+		if(stream[i] && pending[i] == 0)
+			cells.push_back(int(i));
+	for(size_t k = 0; k < cells.size(); k++)
+	{
+		int i = cells[k], j = flow.receiver[i];
+		if(ordering == eShreve)
+			order[i] = max(upper[i], 1);
+		else
+			order[i] = upper[i] == 0 ? 1 : (upperCount[i] > 1 ? upper[i] + 1 : upper[i]);
+		if(j < 0 || !stream[j])
+			continue;
+		if(ordering == eShreve)
+			upper[j] += order[i];
+		else if(order[i] > upper[j])
+		{
+			upper[j] = order[i];
+			upperCount[j] = 1;
+		}
+		else if(order[i] == upper[j])
+			upperCount[j] = 2;
+		if(--pending[j] == 0)
+			cells.push_back(j);
+	}
+
+	grid* gx = gridLike(dir);
+	flow.forEachRow([&](int r)
+	{
+		for(int c = 0; c < cols; c++)
+		{
+			int i = flow.index(r, c);
+			gx->feld[r][c] = flow.valid[i] ? float(order[i]) : float(dir.nodata);
+		}
+	});
+	return gx;
+}
@@ -0,0 +1,104 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef HYDROLOGY_H_
+#define HYDROLOGY_H_
+
+#include <vector>
+#include <utility>
+
+#include "grid.h"
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	/*!
+	 * fill all depressions of dem in place in one pass (priority flood,
+	 * Barnes et al. 2014): starting at the outlets (valid cells at the grid
+	 * border or next to no data) the cells are visited lowest first, a cell
+	 * lower than the cell it is reached from is raised to it, the raised cells
+	 * go through a plain queue, so it is O(n log n) for the unraised cells only
+	 * @param epsilon 0: depressions become flat,
+	 * > 0: a raised cell is at least epsilon (at least the next float) higher
+	 * than the cell it drains to, so every cell has a lower neighbour
+	 */
+	void fillDepressions(grid& dem, float epsilon = 0);
+
+	/*!
+	 * like fillDepressions(dem, 0) for large DEMs: tiles of tileSize^2 cells
+	 * are filled in parallel from their perimeter, every perimeter cell labels
+	 * the cells it floods, the spill elevations between the labels of all
+	 * tiles give the final water level of each label (Barnes 2016),
+	 * the result is the same as of fillDepressions
+	 */
+	void fillDepressionsTiled(grid& dem, int tileSize = 1024,
+														Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * the functions below take D8 flow directions as w_flowdirection writes
+	 * them (e:1 se:2 s:4 sw:8 w:16 nw:32 n:64 ne:128), a flow path ends at a
+	 * cell with another code (0 = pit/flat), pointing out of the grid or into
+	 * no data; they run in linear time, with a parallel policy the grid is
+	 * split into tiles processed on the library thread pool and the flow
+	 * between the tiles is joined afterwards
+	 */
+
+	/*!
+	 * number of cells draining through every cell (including itself) or with
+	 * weights the sum of their weights (no data weights count 0),
+	 * the cells are accumulated in topological order (a cell after all cells
+	 * draining into it); cells on cycles of directions keep their own weight,
+	 * the flow draining into a cycle is not added to it (for every policy)
+	 * @return no data where dir has no data
+	 */
+	grid* flowAccumulation(const grid& dir, const grid* weights = NULL,
+												 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * every cell gets the number (1..) of the outlet its flow path ends in,
+	 * the outlets are numbered row by row
+	 * @return no data where dir has no data, 0 for cells on cycles
+	 */
+	grid* basins(const grid& dir,
+							 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * cells draining through pour point i (row, col) get i + 1, a flow path
+	 * belongs to the first pour point on it, 0 for cells draining past all of them
+	 * @return no data where dir has no data
+	 */
+	grid* watersheds(const grid& dir, const std::vector<std::pair<int, int> >& pourPoints,
+									 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	enum StreamOrdering
+	{
+		//! 1 at the sources, +1 below the junction of two streams of the same order
+		eStrahler,
+		//! number of sources upstream
+		eShreve
+	};
+
+	/*!
+	 * order of the stream cells (accumulation >= threshold), 0 for the other
+	 * cells, no data where dir has no data
+	 */
+	grid* streamOrder(const grid& dir, const grid& accumulation, float threshold,
+										StreamOrdering ordering = eStrahler,
+										Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+}
+
+#endif
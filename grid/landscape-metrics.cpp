@@ -0,0 +1,352 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "landscape-metrics.h"
+#include "distance-transform.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	const int sideRow[4] = {0, 1, 0, -1};
+	const int sideCol[4] = {1, 0, -1, 0};
+
+	//! one part of the rows per thread of the pool
+	size_t rowPartCount(size_t rows, Tools::ExecutionPolicy policy)
+	{
+		return Tools::isParallel(policy)
+				? max(min(rows, size_t(Tools::defaultThreadPool().size())), size_t(1)) : 1;
+	}
+
+	//! f(part, first row, end row) for the parts of the rows
+	template<class F>
+	void forEachRowPart(size_t rows, Tools::ExecutionPolicy policy, F f)
+	{
+		size_t parts = rowPartCount(rows, policy);
+		auto run = [&](size_t p) { f(p, rows*p/parts, rows*(p + 1)/parts); };
+		if(parts > 1)
+			Tools::defaultThreadPool().parallelFor(parts, run);
+		else
+			run(0);
+	}
+
+	//! number of edges of the most compact patch of n cells
+	double minimalPerimeter(size_t n)
+	{
+		size_t s = size_t(sqrt(double(n)));
+		while(s*s > n)
+			s--;
+		while((s + 1)*(s + 1) <= n)
+			s++;
+		size_t m = n - s*s;
+		return double(m == 0 ? 4*s : (m <= s ? 4*s + 2 : 4*s + 4));
+	}
+
+	//! up to this number of classes the adjacencies of all pairs are counted in a matrix
+	const size_t maxDenseClasses = 256;
+
+	//! adjacencies of the cells in a part of the rows
+	struct Adjacencies
+	{
+		explicit Adjacencies(size_t classes)
+			: classes(classes), like(classes, 0), unlike(classes, 0),
+				dense(classes <= maxDenseClasses ? classes*classes : 0, 0) {}
+
+		void addUnlike(int a, int b, size_t n = 1)
+		{
+			unlike[a] += n;
+			if(dense.empty())
+				sparse[(uint64_t(a) << 32) | uint64_t(b)] += n;
+			else
+				dense[a*classes + b] += n;
+		}
+
+		//! f(a, b, sides) for all pairs of different classes side by side
+		template<class F>
+		void forEachUnlike(F f) const
+		{
+			for(size_t i = 0; i < dense.size(); i++)
+				if(dense[i] > 0)
+					f(i / classes, i % classes, dense[i]);
+			for(unordered_map<uint64_t, size_t>::const_iterator it = sparse.begin(); it != sparse.end(); ++it)
+				f(size_t(it->first >> 32), size_t(it->first & 0xffffffff), it->second);
+		}
+
+		size_t classes;
+		//! sides of cells of the same class
+		vector<size_t> like;
+		//! sides of cells of a class to the other classes
+		vector<size_t> unlike;
+		//! sides between two classes, a*classes + b or (a << 32 | b)
+		vector<size_t> dense;
+		unordered_map<uint64_t, size_t> sparse;
+	};
+}
+
+void Grids::landscapeMetrics(const grid& g, LandscapeMetrics& metrics,
+														 const LandscapeMetricsOptions& options,
+														 Tools::ExecutionPolicy policy)
+{
+	size_t rows = g.nrows, cols = g.ncols;
+	double cellSize = g.csize, cellArea = cellSize*cellSize;
+	metrics = LandscapeMetrics();
+
+	//1. the patches
+	vector<unsigned char> mask(rows*cols);
+	forEachRowPart(rows, policy, [&](size_t, size_t r0, size_t r1)
+	{
+		for(size_t r = r0; r < r1; r++)
+			for(size_t c = 0; c < cols; c++)
+				mask[r*cols + c] = !isNoDataValue(g.feld[r][c], g.nodata);
+	});
+	vector<int> labels;
+	vector<Component> components;
+	labelComponents(rows, cols, mask, g.feld, options.connectivity, labels, &components, policy);
+	size_t patchCount = components.size();
+
+	vector<float> classValues(patchCount);
+	for(size_t p = 0; p < patchCount; p++)
+		classValues[p] = g.feld[components[p].row][components[p].col];
+	sort(classValues.begin(), classValues.end());
+	classValues.erase(unique(classValues.begin(), classValues.end()), classValues.end());
+	size_t classCount = classValues.size();
+
+	metrics.patches.resize(patchCount);
+	for(size_t p = 0; p < patchCount; p++)
+	{
+		PatchMetrics& pm = metrics.patches[p];
+		pm.cells = components[p];
+		pm.value = g.feld[components[p].row][components[p].col];
+		pm.classIndex = int(lower_bound(classValues.begin(), classValues.end(), pm.value)
+												- classValues.begin());
+		pm.area = components[p].area*cellArea;
+		metrics.area += pm.area;
+	}
+	auto classOf = [&](size_t i) { return metrics.patches[labels[i] - 1].classIndex; };
+
+	//2. the sides of every cell to other patches and the adjacencies of the classes,
+	//cells of one class side by side always belong to the same patch
+	vector<unsigned char> sides(rows*cols, 0);
+	vector<Adjacencies> parts(rowPartCount(rows, policy), Adjacencies(classCount));
+	forEachRowPart(rows, policy, [&](size_t part, size_t r0, size_t r1)
+	{
+		Adjacencies& a = parts[part];
+		for(size_t r = r0; r < r1; r++)
+			for(size_t c = 0; c < cols; c++)
+			{
+				size_t i = r*cols + c;
+				if(!mask[i])
+					continue;
+				int ci = classOf(i);
+				for(int k = 0; k < 4; k++)
+				{
+					ptrdiff_t nr = ptrdiff_t(r) + sideRow[k], nc = ptrdiff_t(c) + sideCol[k];
+					if(nr < 0 || nr >= ptrdiff_t(rows) || nc < 0 || nc >= ptrdiff_t(cols))
+					{
+						sides[i]++;
+						continue;
+					}
+					size_t j = size_t(nr)*cols + size_t(nc);
+					if(!mask[j])
+						sides[i]++;
+					else if(labels[j] == labels[i])
+						a.like[ci]++;
+					else
+					{
+						sides[i]++;
+						a.addUnlike(ci, classOf(j));
+					}
+				}
+			}
+	});
+
+	vector<size_t> perimeter(patchCount, 0);
+	for(size_t i = 0; i < labels.size(); i++)
+		if(mask[i])
+			perimeter[labels[i] - 1] += sides[i];
+	for(size_t p = 0; p < patchCount; p++)
+	{
+		PatchMetrics& pm = metrics.patches[p];
+		pm.perimeter = perimeter[p]*cellSize;
+		pm.shapeIndex = perimeter[p] / minimalPerimeter(pm.cells.area);
+	}
+
+	Adjacencies total(classCount);
+	for(size_t p = 0; p < parts.size(); p++)
+	{
+		for(size_t k = 0; k < classCount; k++)
+			total.like[k] += parts[p].like[k];
+		parts[p].forEachUnlike([&](size_t a, size_t b, size_t n) { total.addUnlike(int(a), int(b), n); });
+	}
+
+	//3. nearest neighbours: a cell next to a cell with another nearest patch
+	//of the class lies on the border of their Voronoi zones
+	if(options.nearestNeighbour)
+	{
+		vector<int> classPatches(classCount, 0);
+		vector<Component> classBox(classCount);
+		for(size_t p = 0; p < patchCount; p++)
+		{
+			const Component& c = components[p];
+			Component& b = classBox[metrics.patches[p].classIndex];
+			if(classPatches[metrics.patches[p].classIndex]++ == 0)
+				b = c;
+			b.minRow = min(b.minRow, c.minRow);
+			b.minCol = min(b.minCol, c.minCol);
+			b.maxRow = max(b.maxRow, c.maxRow);
+			b.maxCol = max(b.maxCol, c.maxCol);
+		}
+		vector<double> nearest2(patchCount, -1);
+		vector<unsigned char> isSource;
+		vector<double> dist2;
+		vector<ptrdiff_t> nearest;
+		for(size_t k = 0; k < classCount; k++)
+		{
+			if(classPatches[k] < 2)
+				continue;
+			//only within the class' bounding box: it holds all sources and the
+			//segments between the closest cells of two patches, so the cost is the
+			//sum of the boxes, not classes*cells
+			const Component& box = classBox[k];
+			size_t top = size_t(box.minRow), left = size_t(box.minCol);
+			size_t boxRows = size_t(box.maxRow - box.minRow) + 1;
+			size_t boxCols = size_t(box.maxCol - box.minCol) + 1;
+			auto label = [&](ptrdiff_t bi)
+			{
+				return labels[(top + size_t(bi) / boxCols)*cols + left + size_t(bi) % boxCols];
+			};
+			isSource.resize(boxRows*boxCols);
+			forEachRowPart(boxRows, policy, [&](size_t, size_t r0, size_t r1)
+			{
+				for(size_t r = r0; r < r1; r++)
+					for(size_t c = 0; c < boxCols; c++)
+					{
+						size_t i = (top + r)*cols + left + c;
+						isSource[r*boxCols + c] = mask[i] && classOf(i) == int(k);
+					}
+			});
+			squaredDistanceTransform(boxRows, boxCols, isSource, dist2, &nearest, policy);
+
+			vector<vector<pair<int, double> > > found(rowPartCount(boxRows, policy));
+			forEachRowPart(boxRows, policy, [&](size_t part, size_t r0, size_t r1)
+			{
+				const int dr[4] = {0, 1, 1, 1}, dc[4] = {1, -1, 0, 1};
+				//the last pair per direction, along a border the same pairs follow each other
+				int lastA[4] = {-1, -1, -1, -1}, lastB[4] = {-1, -1, -1, -1};
+				double lastD2[4] = {0, 0, 0, 0};
+				for(size_t r = r0; r < r1; r++)
+					for(size_t c = 0; c < boxCols; c++)
+					{
+						ptrdiff_t a = nearest[r*boxCols + c];
+						int la = label(a);
+						for(int n = 0; n < 4; n++)
+						{
+							ptrdiff_t nr = ptrdiff_t(r) + dr[n], nc = ptrdiff_t(c) + dc[n];
+							if(nr >= ptrdiff_t(boxRows) || nc < 0 || nc >= ptrdiff_t(boxCols))
+								continue;
+							ptrdiff_t b = nearest[size_t(nr)*boxCols + size_t(nc)];
+							int lb = label(b);
+							if(la == lb)
+								continue;
+							double rowDist = double(a / ptrdiff_t(boxCols) - b / ptrdiff_t(boxCols));
+							double colDist = double(a % ptrdiff_t(boxCols) - b % ptrdiff_t(boxCols));
+							double d2 = rowDist*rowDist + colDist*colDist;
+							if(la == lastA[n] && lb == lastB[n] && d2 >= lastD2[n])
+								continue;
+							lastA[n] = la;
+							lastB[n] = lb;
+							lastD2[n] = d2;
+							found[part].push_back(make_pair(la - 1, d2));
+							found[part].push_back(make_pair(lb - 1, d2));
+						}
+					}
+			});
+			for(size_t part = 0; part < found.size(); part++)
+				for(size_t n = 0; n < found[part].size(); n++)
+				{
+					double& d2 = nearest2[found[part][n].first];
+					if(d2 < 0 || found[part][n].second < d2)
+						d2 = found[part][n].second;
+				}
+		}
+		for(size_t p = 0; p < patchCount; p++)
+			if(nearest2[p] >= 0)
+				metrics.patches[p].nearestNeighbour = sqrt(nearest2[p])*cellSize;
+	}
+
+	//4. classes and landscape
+	metrics.classes.resize(classCount);
+	vector<int> nearestCount(classCount, 0);
+	vector<double> nearestSum(classCount, 0);
+	for(size_t k = 0; k < classCount; k++)
+		metrics.classes[k].value = classValues[k];
+	for(size_t p = 0; p < patchCount; p++)
+	{
+		const PatchMetrics& pm = metrics.patches[p];
+		ClassMetrics& cm = metrics.classes[pm.classIndex];
+		cm.patches++;
+		cm.area += pm.area;
+		cm.largestPatchIndex = max(cm.largestPatchIndex, pm.area);
+		cm.meanShapeIndex += pm.shapeIndex;
+		if(pm.nearestNeighbour >= 0)
+		{
+			nearestCount[pm.classIndex]++;
+			nearestSum[pm.classIndex] += pm.nearestNeighbour;
+		}
+	}
+	for(size_t k = 0; k < classCount; k++)
+	{
+		ClassMetrics& cm = metrics.classes[k];
+		cm.proportion = cm.area / metrics.area;
+		cm.edge = total.unlike[k]*cellSize;
+		cm.edgeDensity = cm.edge / metrics.area*10000;
+		cm.meanPatchArea = cm.area / cm.patches;
+		cm.largestPatchIndex = cm.largestPatchIndex / metrics.area*100;
+		cm.meanShapeIndex /= cm.patches;
+		if(nearestCount[k] > 0)
+			cm.meanNearestNeighbour = nearestSum[k] / nearestCount[k];
+		metrics.edge += cm.edge / 2;
+	}
+	if(metrics.area > 0)
+		metrics.edgeDensity = metrics.edge / metrics.area*10000;
+
+	//contagion: 1 + sum_i sum_k p_i g_ik / sum_k g_ik ln(p_i g_ik / sum_k g_ik) / (2 ln m)
+	if(classCount > 1)
+	{
+		double sum = 0;
+		auto add = [&](size_t i, size_t g_ik)
+		{
+			size_t adjacencies = total.like[i] + total.unlike[i];
+			if(g_ik == 0)
+				return;
+			double q = metrics.classes[i].proportion*g_ik / adjacencies;
+			sum += q*log(q);
+		};
+		for(size_t k = 0; k < classCount; k++)
+			add(k, total.like[k]);
+		total.forEachUnlike([&](size_t a, size_t, size_t n) { add(a, n); });
+		metrics.contagion = (1 + sum / (2*log(double(classCount))))*100;
+	}
+}
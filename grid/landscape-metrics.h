@@ -0,0 +1,132 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef LANDSCAPE_METRICS_H_
+#define LANDSCAPE_METRICS_H_
+
+#include <vector>
+
+#include "grid.h"
+#include "components.h"
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	/*!
+	 * metrics of a patch (connected cells of one class), lengths and areas
+	 * in map units (csize), cells side by side in the 4 main directions share
+	 * an edge
+	 */
+	struct PatchMetrics
+	{
+		PatchMetrics()
+			: value(0), classIndex(0), area(0), perimeter(0), shapeIndex(0),
+				nearestNeighbour(-1) {}
+
+		//! class of the patch and its index in LandscapeMetrics::classes
+		float value;
+		int classIndex;
+		double area;
+		//! edges to other patches, no data and the grid border
+		double perimeter;
+		//! perimeter / perimeter of the most compact patch of the same number of cells (1 = square)
+		double shapeIndex;
+		//! distance of the nearest cells (centres) of the nearest patch of the same class, -1 if there is none
+		double nearestNeighbour;
+		//! number of cells, first cell and bounding box
+		Component cells;
+	};
+
+	struct ClassMetrics
+	{
+		ClassMetrics()
+			: value(0), patches(0), area(0), proportion(0), edge(0), edgeDensity(0),
+				meanPatchArea(0), largestPatchIndex(0), meanShapeIndex(0),
+				meanNearestNeighbour(-1) {}
+
+		float value;
+		int patches;
+		double area;
+		//! area / area of the landscape (0..1)
+		double proportion;
+		//! edges to the other classes (not to no data or the grid border)
+		double edge;
+		//! edge per hectare of the landscape (csize in m)
+		double edgeDensity;
+		double meanPatchArea;
+		//! largest patch in % of the landscape
+		double largestPatchIndex;
+		double meanShapeIndex;
+		//! mean over the patches having a neighbour, -1 if none has
+		double meanNearestNeighbour;
+	};
+
+	struct LandscapeMetrics
+	{
+		LandscapeMetrics() : area(0), edge(0), edgeDensity(0), contagion(0) {}
+
+		//! area of all valid cells
+		double area;
+		//! edges between the classes
+		double edge;
+		//! edge per hectare (csize in m)
+		double edgeDensity;
+		/*!
+		 * aggregation of the classes in % (0 = maximally dispersed,
+		 * 100 = one patch per class) from the adjacencies of the cells (double
+		 * count), 0 if there are less than 2 classes
+		 */
+		double contagion;
+		//! sorted by value
+		std::vector<ClassMetrics> classes;
+		//! patch i has label i + 1 of labelPatches(g, connectivity)
+		std::vector<PatchMetrics> patches;
+	};
+
+	struct LandscapeMetricsOptions
+	{
+		LandscapeMetricsOptions()
+			: connectivity(eConnect8), nearestNeighbour(true) {}
+
+		//! cells of a class forming a patch
+		ComponentConnectivity connectivity;
+		/*!
+		 * calculate the nearest neighbour distances: a distance transform per
+		 * class with at least two patches over the bounding box of the class,
+		 * so classes spread over the whole grid cost a full pass each (with
+		 * a double and a ptrdiff_t per cell of the box)
+		 */
+		bool nearestNeighbour;
+	};
+
+	/*!
+	 * patch, class and landscape metrics of a categorical grid (every value
+	 * other than no data is a class) in a few linear passes (the nearest
+	 * neighbours aside, one pass per class over its bounding box): the patches are
+	 * labelled by labelComponents, perimeters and adjacencies are counted in
+	 * one pass over the cells, the nearest neighbours of the patches of a
+	 * class are found along the borders of their Voronoi zones (the distance
+	 * transform of the class' cells with the nearest cell, within the class'
+	 * bounding box, see LandscapeMetricsOptions::nearestNeighbour); all passes run on
+	 * the library thread pool unless policy is sequential
+	 */
+	void landscapeMetrics(const grid& g, LandscapeMetrics& metrics,
+												const LandscapeMetricsOptions& options = LandscapeMetricsOptions(),
+												Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+}
+
+#endif
@@ -0,0 +1,112 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped-file.h"
+
+using namespace Grids;
+using namespace std;
+
+MappedFile::MappedFile(const string& pathToFile, bool copyOnWrite)
+	: _data(NULL), _size(0), _isOpen(false), _copyOnWrite(copyOnWrite)
+#ifdef WIN32
+	, _file(INVALID_HANDLE_VALUE), _mapping(NULL)
+#endif
+{
+#ifdef WIN32
+	HANDLE f = CreateFileA(pathToFile.c_str(), GENERIC_READ, FILE_SHARE_READ,
+												 NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(f == INVALID_HANDLE_VALUE)
+		return;
+	_file = f;
+	LARGE_INTEGER s;
+	if(!GetFileSizeEx(f, &s))
+		return;
+	_size = size_t(s.QuadPart);
+	_isOpen = true;
+	if(_size == 0)
+		return;
+	_mapping = CreateFileMappingA(f, NULL, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY,
+																0, 0, NULL);
+	if(_mapping)
+		_data = (const char*)MapViewOfFile(_mapping, copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ,
+																			 0, 0, 0);
+	if(!_data)
+		_isOpen = false;
+#else
+	int fd = open(pathToFile.c_str(), O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat st;
+	if(fstat(fd, &st) == 0)
+	{
+		_size = size_t(st.st_size);
+		_isOpen = true;
+		if(_size > 0)
+		{
+			void* p = mmap(NULL, _size, copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ,
+										 MAP_PRIVATE, fd, 0);
+			if(p == MAP_FAILED)
+				_isOpen = false;
+			else
+			{
+				_data = (const char*)p;
+				if(!copyOnWrite)
+					madvise(p, _size, MADV_SEQUENTIAL);
+			}
+		}
+	}
+	close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef WIN32
+	if(_data)
+		UnmapViewOfFile(_data);
+	if(_mapping)
+		CloseHandle(_mapping);
+	if(_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+#else
+	if(_data)
+		munmap((void*)_data, _size);
+#endif
+}
+
+void MappedFile::dontNeed(size_t offset)
+{
+#ifndef WIN32
+	//dropping pages of a copy on write mapping would lose the changes
+	if(_copyOnWrite)
+		return;
+	static const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+	size_t len = min(offset, _size) / pageSize * pageSize;
+	if(_data && len > 0)
+		madvise((void*)_data, len, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,61 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <string>
+#include <cstddef>
+
+namespace Grids
+{
+	/*!
+	 * view of a whole file, memory mapped if possible
+	 * read only or as private copy on write mapping, where changes stay in
+	 * memory and never reach the file
+	 */
+	class MappedFile
+	{
+	public:
+		explicit MappedFile(const std::string& pathToFile, bool copyOnWrite = false);
+		~MappedFile();
+
+		bool isOpen() const { return _isOpen; }
+		const char* data() const { return _data; }
+		std::size_t size() const { return _size; }
+
+		//! writable data, only for copy on write mappings else NULL
+		char* mutableData() const { return _copyOnWrite ? const_cast<char*>(_data) : NULL; }
+
+		//! hint that the pages before offset aren't needed anymore (streaming)
+		void dontNeed(std::size_t offset);
+
+	private:
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+
+		const char* _data;
+		std::size_t _size;
+		bool _isOpen;
+		bool _copyOnWrite;
+#ifdef WIN32
+		void* _file;
+		void* _mapping;
+#endif
+	};
+}
+
+#endif
@@ -0,0 +1,394 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <cfloat>
+
+#include "neighbourhood.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+NeighbourhoodTile::NeighbourhoodTile(const grid& g, int row, int col, int rows, int cols,
+																		 int halo, float fill)
+	: _g(&g),
+		_row(row),
+		_col(col),
+		_rows(rows),
+		_cols(cols),
+		_halo(halo),
+		_r0(max(row - halo, 0)),
+		_c0(max(col - halo, 0))
+{
+	int r1 = min(row + rows + halo, int(g.nrows)), c1 = min(col + cols + halo, int(g.ncols));
+	_stride = size_t(c1 - _c0);
+	_values.resize(size_t(r1 - _r0)*_stride);
+	_valid.resize(_values.size());
+
+	for(int r = _r0; r < r1; r++)
+	{
+		const float* src = g.feld[r] + _c0;
+		float* v = &_values[index(r, _c0)];
+		float* ok = &_valid[index(r, _c0)];
+		for(size_t c = 0; c < _stride; c++)
+		{
+			bool valid = !isNoDataValue(src[c], g.nodata);
+			v[c] = valid ? src[c] : fill;
+			ok[c] = valid ? 1.0f : 0.0f;
+		}
+	}
+}
+
+vector<WindowRect> Grids::windowRects(const int* const* mask, int radius)
+{
+	int n = 2*radius + 1;
+	vector<WindowRect> rects, open, next;
+	for(int i = 0; i < n; i++)
+	{
+		next.clear();
+		for(int j = 0; j < n; j++)
+		{
+			if(mask[i][j] == 0)
+				continue;
+			WindowRect run;
+			run.r0 = run.r1 = i - radius;
+			run.c0 = j - radius;
+			while(j + 1 < n && mask[i][j + 1] != 0)
+				j++;
+			run.c1 = j - radius;
+
+			//continue a rectangle of the previous row with the same columns
+			for(vector<WindowRect>::iterator it = open.begin(); it != open.end(); ++it)
+				if(it->c0 == run.c0 && it->c1 == run.c1)
+				{
+					run.r0 = it->r0;
+					open.erase(it);
+					break;
+				}
+			next.push_back(run);
+		}
+		rects.insert(rects.end(), open.begin(), open.end());
+		open.swap(next);
+	}
+	rects.insert(rects.end(), open.begin(), open.end());
+	return rects;
+}
+
+SummedAreaTile::SummedAreaTile(const NeighbourhoodTile& t, bool squares)
+	: _r0(t.haloRow()),
+		_r1(t.haloEndRow() - 1),
+		_c0(t.haloCol()),
+		_c1(t.haloEndCol() - 1),
+		_stride(size_t(_c1 - _c0 + 2)),
+		_offset(0)
+{
+	int rows = _r1 - _r0 + 1, cols = _c1 - _c0 + 1;
+
+	if(squares)
+	{
+		double n = 0;
+		for(int r = _r0; r <= _r1; r++)
+		{
+			const float* v = t.values(r, _c0);
+			const float* ok = t.valid(r, _c0);
+			for(int c = 0; c < cols; c++)
+				if(ok[c] > 0)
+				{
+					_offset += v[c];
+					n++;
+				}
+		}
+		if(n > 0)
+			_offset /= n;
+	}
+
+	size_t size = size_t(rows + 1)*_stride;
+	_count.assign(size, 0.0);
+	_sum.assign(size, 0.0);
+	if(squares)
+		_squares.assign(size, 0.0);
+
+	for(int r = 0; r < rows; r++)
+	{
+		const float* v = t.values(_r0 + r, _c0);
+		const float* ok = t.valid(_r0 + r, _c0);
+		size_t i = size_t(r + 1)*_stride + 1;
+		double count = 0, sum = 0, sq = 0;
+		for(int c = 0; c < cols; c++, i++)
+		{
+			double d = ok[c] > 0 ? v[c] - _offset : 0.0;
+			count += ok[c];
+			sum += d;
+			_count[i] = _count[i - _stride] + count;
+			_sum[i] = _sum[i - _stride] + sum;
+			if(squares)
+			{
+				sq += d*d;
+				_squares[i] = _squares[i - _stride] + sq;
+			}
+		}
+	}
+}
+
+namespace
+{
+	struct MinOp
+	{
+		float operator()(float a, float b) const { return a < b ? a : b; }
+	};
+
+	struct MaxOp
+	{
+		float operator()(float a, float b) const { return a > b ? a : b; }
+	};
+
+	/*!
+	 * out[i*outStride] = op over in[j*inStride] for j in [i + a, i + b],
+	 * positions outside [0, n) count as identity;
+	 * the padded sequence is split into blocks of the window size, every window
+	 * is the suffix extremum (h) of one block and the prefix extremum (g) of the next
+	 */
+	template<class Op>
+	void runningExtremum(const float* in, ptrdiff_t inStride, int n, int a, int b,
+											 float identity, Op op, float* out, ptrdiff_t outStride,
+											 vector<float>& g, vector<float>& h)
+	{
+		int k = b - a + 1, m = n + k - 1;
+		g.resize(m);
+		h.resize(m);
+		for(int j = 0; j < m; j++)
+		{
+			int s = j + a;
+			float v = s >= 0 && s < n ? in[s*inStride] : identity;
+			g[j] = j % k == 0 ? v : op(g[j - 1], v);
+		}
+		for(int j = m - 1; j >= 0; j--)
+		{
+			int s = j + a;
+			float v = s >= 0 && s < n ? in[s*inStride] : identity;
+			h[j] = j % k == k - 1 || j == m - 1 ? v : op(h[j + 1], v);
+		}
+		for(int i = 0; i < n; i++)
+			out[i*outStride] = op(h[i], g[i + k - 1]);
+	}
+
+	template<class Op>
+	void extremum(const NeighbourhoodTile& t, const vector<WindowRect>& rects,
+								float identity, Op op, grid& out, bool keepOutNoData)
+	{
+		int rows = t.haloEndRow() - t.haloRow(), cols = t.haloEndCol() - t.haloCol();
+		int tr = t.row() - t.haloRow(), tc = t.col() - t.haloCol();
+		int tileRows = t.endRow() - t.row(), tileCols = t.endCol() - t.col();
+
+		vector<float> v(size_t(rows)*cols), hor(v.size()), column(rows), g, h;
+		vector<float> res(size_t(tileRows)*tileCols, identity);
+		for(int r = 0; r < rows; r++)
+		{
+			const float* values = t.values(t.haloRow() + r, t.haloCol());
+			const float* valid = t.valid(t.haloRow() + r, t.haloCol());
+			for(int c = 0; c < cols; c++)
+				v[size_t(r)*cols + c] = valid[c] > 0 ? values[c] : identity;
+		}
+
+		for(size_t i = 0; i < rects.size(); i++)
+		{
+			const WindowRect& w = rects[i];
+			for(int r = 0; r < rows; r++)
+				runningExtremum(&v[size_t(r)*cols], 1, cols, w.c0, w.c1, identity, op,
+												&hor[size_t(r)*cols], 1, g, h);
+			for(int c = 0; c < tileCols; c++)
+			{
+				runningExtremum(&hor[tc + c], cols, rows, w.r0, w.r1, identity, op,
+												&column[0], 1, g, h);
+				for(int r = 0; r < tileRows; r++)
+					res[size_t(r)*tileCols + c] = op(res[size_t(r)*tileCols + c], column[tr + r]);
+			}
+		}
+
+		for(int r = 0; r < tileRows; r++)
+		{
+			float* o = out.feld[t.row() + r] + t.col();
+			for(int c = 0; c < tileCols; c++)
+				if(!keepOutNoData || o[c] != out.nodata)
+					o[c] = res[size_t(r)*tileCols + c];
+		}
+	}
+
+	/*!
+	 * counts of ranks, additionally summed in blocks of 2^shift ranks,
+	 * so the k-th smallest rank is found in about 2*sqrt(ranks) steps
+	 */
+	class RankHistogram
+	{
+	public:
+		explicit RankHistogram(size_t ranks) : _shift(0), _total(0)
+		{
+			while((size_t(1) << (2*_shift)) < ranks)
+				_shift++;
+			_counts.assign(ranks, 0);
+			_blocks.assign((ranks >> _shift) + 1, 0);
+		}
+
+		void add(int rank)
+		{
+			_counts[rank]++;
+			_blocks[rank >> _shift]++;
+			_total++;
+		}
+
+		void remove(int rank)
+		{
+			_counts[rank]--;
+			_blocks[rank >> _shift]--;
+			_total--;
+		}
+
+		int total() const { return _total; }
+
+		//! rank of the k-th smallest value (0 based, k < total())
+		int kth(int k) const
+		{
+			size_t b = 0;
+			while(k >= _blocks[b])
+				k -= _blocks[b++];
+			size_t r = b << _shift;
+			while(k >= _counts[r])
+				k -= _counts[r++];
+			return int(r);
+		}
+
+	private:
+		unsigned int _shift;
+		int _total;
+		vector<int> _counts, _blocks;
+	};
+
+	//! one row of a window relative to its center
+	struct WindowSpan
+	{
+		int dr, c0, c1;
+	};
+}
+
+void Grids::windowExtremum(const NeighbourhoodTile& t, const vector<WindowRect>& rects,
+													 bool maximum, grid& out, bool keepOutNoData)
+{
+	if(maximum)
+		extremum(t, rects, -FLT_MAX, MaxOp(), out, keepOutNoData);
+	else
+		extremum(t, rects, FLT_MAX, MinOp(), out, keepOutNoData);
+}
+
+void Grids::windowPercentile(const NeighbourhoodTile& t, const vector<WindowRect>& rects,
+														 double p, grid& out, bool keepOutNoData)
+{
+	p = min(max(p, 0.0), 1.0);
+	int r0 = t.haloRow(), c0 = t.haloCol();
+	int rows = t.haloEndRow() - r0, cols = t.haloEndCol() - c0;
+
+	//the distinct values of the tile and halo, the cells get their ranks (-1 = no data)
+	vector<float> levels;
+	levels.reserve(size_t(rows)*cols);
+	for(int r = r0; r < r0 + rows; r++)
+	{
+		const float* values = t.values(r, c0);
+		const float* valid = t.valid(r, c0);
+		for(int c = 0; c < cols; c++)
+			if(valid[c] > 0)
+				levels.push_back(values[c]);
+	}
+	sort(levels.begin(), levels.end());
+	levels.erase(unique(levels.begin(), levels.end()), levels.end());
+
+	vector<int> ranks(size_t(rows)*cols, -1);
+	for(int r = 0; r < rows; r++)
+	{
+		const float* values = t.values(r0 + r, c0);
+		const float* valid = t.valid(r0 + r, c0);
+		for(int c = 0; c < cols; c++)
+			if(valid[c] > 0)
+				ranks[size_t(r)*cols + c] =
+						int(lower_bound(levels.begin(), levels.end(), values[c]) - levels.begin());
+	}
+
+	vector<WindowSpan> spans;
+	for(size_t i = 0; i < rects.size(); i++)
+		for(int dr = rects[i].r0; dr <= rects[i].r1; dr++)
+		{
+			WindowSpan s = {dr, rects[i].c0, rects[i].c1};
+			spans.push_back(s);
+		}
+
+	RankHistogram hist(levels.size());
+	vector<WindowSpan> active(spans.size());
+	vector<const int*> rowRanks(spans.size());
+	for(int r = t.row(); r < t.endRow(); r++)
+	{
+		//the spans within the grid with their row of ranks, columns relative to c0
+		size_t n = 0;
+		for(size_t i = 0; i < spans.size(); i++)
+		{
+			int rr = r + spans[i].dr;
+			if(rr >= r0 && rr < r0 + rows)
+			{
+				active[n] = spans[i];
+				rowRanks[n++] = &ranks[size_t(rr - r0)*cols];
+			}
+		}
+
+		for(size_t i = 0; i < n; i++)
+			for(int c = max(t.col() + active[i].c0, c0) - c0;
+					c <= min(t.col() + active[i].c1 - c0, cols - 1); c++)
+				if(rowRanks[i][c] >= 0)
+					hist.add(rowRanks[i][c]);
+
+		float* o = out.feld[r];
+		for(int c = t.col(); c < t.endCol(); c++)
+		{
+			if(c > t.col())
+				for(size_t i = 0; i < n; i++)
+				{
+					int x = c - 1 + active[i].c0 - c0, y = c + active[i].c1 - c0;
+					if(x >= 0 && x < cols && rowRanks[i][x] >= 0)
+						hist.remove(rowRanks[i][x]);
+					if(y >= 0 && y < cols && rowRanks[i][y] >= 0)
+						hist.add(rowRanks[i][y]);
+				}
+
+			if(keepOutNoData && o[c] == out.nodata)
+				continue;
+			if(hist.total() == 0)
+			{
+				o[c] = float(out.nodata);
+				continue;
+			}
+			double pos = p*(hist.total() - 1);
+			int k = int(pos);
+			double frac = pos - k;
+			double v = levels[hist.kth(k)];
+			if(frac > 0)
+				v = (1 - frac)*v + frac*levels[hist.kth(k + 1)];
+			o[c] = float(v);
+		}
+
+		//empty the histogram for the next row
+		int c = t.endCol() - 1 - c0;
+		for(size_t i = 0; i < n; i++)
+			for(int x = max(c + active[i].c0, 0); x <= min(c + active[i].c1, cols - 1); x++)
+				if(rowRanks[i][x] >= 0)
+					hist.remove(rowRanks[i][x]);
+	}
+}
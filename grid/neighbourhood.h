@@ -0,0 +1,296 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef NEIGHBOURHOOD_H_
+#define NEIGHBOURHOOD_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+
+#include "grid.h"
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	//! window of a cell clamped to the grid, inclusive bounds in grid coordinates
+	struct NeighbourhoodWindow
+	{
+		int r0, r1, c0, c1;
+	};
+
+	//! rectangle of a window relative to its center, inclusive bounds
+	struct WindowRect
+	{
+		int r0, r1, c0, c1;
+	};
+
+	/*!
+	 * decompose the cells != 0 of a (2*radius+1)^2 mask into rectangles:
+	 * the runs of every row, runs with the same columns in consecutive rows
+	 * are merged (a full mask gives one rectangle, a circle one per row width)
+	 */
+	std::vector<WindowRect> windowRects(const int* const* mask, int radius);
+
+	/*!
+	 * a tile of a grid and its halo (up to halo cells around the tile, less at
+	 * the grid border), the values are copied into one contiguous buffer with
+	 * fill instead of no data values and the validity as 0/1, so kernels can
+	 * sum and compare without branches and without touching the whole grid
+	 */
+	class NeighbourhoodTile
+	{
+	public:
+		NeighbourhoodTile(const grid& g, int row, int col, int rows, int cols,
+											int halo, float fill);
+
+		//! the cells the kernel computes: [row, endRow) x [col, endCol)
+		int row() const { return _row; }
+		int col() const { return _col; }
+		int endRow() const { return _row + _rows; }
+		int endCol() const { return _col + _cols; }
+		int halo() const { return _halo; }
+
+		//! the cells in the buffer (tile and halo): [haloRow, haloEndRow) x [haloCol, haloEndCol)
+		int haloRow() const { return _r0; }
+		int haloCol() const { return _c0; }
+		int haloEndRow() const { return _r0 + int(_values.size()/_stride); }
+		int haloEndCol() const { return _c0 + int(_stride); }
+
+		const grid& source() const { return *_g; }
+
+		//! window of radius (<= halo) around (r, c), clamped to the grid
+		NeighbourhoodWindow window(int r, int c, int radius) const
+		{
+			NeighbourhoodWindow w;
+			w.r0 = std::max(r - radius, 0);
+			w.r1 = std::min(r + radius, int(_g->nrows) - 1);
+			w.c0 = std::max(c - radius, 0);
+			w.c1 = std::min(c + radius, int(_g->ncols) - 1);
+			return w;
+		}
+
+		//! values (fill for no data) starting at grid cell (r, c) up to the halo's right end
+		const float* values(int r, int c) const { return &_values[index(r, c)]; }
+
+		//! validity as 1/0 starting at grid cell (r, c)
+		const float* valid(int r, int c) const { return &_valid[index(r, c)]; }
+
+		float value(int r, int c) const { return _values[index(r, c)]; }
+		bool isValid(int r, int c) const { return _valid[index(r, c)] != 0; }
+
+	private:
+		std::size_t index(int r, int c) const
+		{
+			return std::size_t(r - _r0)*_stride + std::size_t(c - _c0);
+		}
+
+		const grid* _g;
+		int _row, _col, _rows, _cols, _halo;
+		int _r0, _c0;
+		std::size_t _stride;
+		std::vector<float> _values, _valid;
+	};
+
+	//! sums over the valid cells of some rectangles of a window
+	struct WindowSums
+	{
+		WindowSums() : count(0), sum(0), squares(0), offset(0) {}
+
+		//! sum of the values
+		double total() const { return sum + offset*count; }
+		double mean() const { return offset + sum/count; }
+		//! sum of the squared deviations from the mean
+		double squaredDeviations() const { return squares - sum*sum/count; }
+
+		double count;
+		//! sum of (value - offset) and of its squares
+		double sum, squares;
+		double offset;
+	};
+
+	/*!
+	 * summed-area tables of a NeighbourhoodTile (number of valid cells, sum of
+	 * their values and optionally of the squares), so the sums over a rectangle
+	 * are 4 lookups, independent of its size;
+	 * with squares the values are shifted by the mean of the tile to keep
+	 * the precision, otherwise integer values are summed exactly
+	 */
+	class SummedAreaTile
+	{
+	public:
+		explicit SummedAreaTile(const NeighbourhoodTile& t, bool squares = false);
+
+		//! add the sums over the cells [r0, r1] x [c0, c1] (clamped to the tile and halo)
+		void add(int r0, int r1, int c0, int c1, WindowSums& s) const
+		{
+			r0 = std::max(r0, _r0);
+			r1 = std::min(r1, _r1);
+			c0 = std::max(c0, _c0);
+			c1 = std::min(c1, _c1);
+			if(r0 > r1 || c0 > c1)
+				return;
+			std::size_t a = index(r0, c0), b = index(r0, c1 + 1),
+					c = index(r1 + 1, c0), d = index(r1 + 1, c1 + 1);
+			s.count += _count[d] - _count[b] - _count[c] + _count[a];
+			s.sum += _sum[d] - _sum[b] - _sum[c] + _sum[a];
+			if(!_squares.empty())
+				s.squares += _squares[d] - _squares[b] - _squares[c] + _squares[a];
+		}
+
+		//! sums over the rectangles (within the halo) around (r, c)
+		WindowSums sums(int r, int c, const std::vector<WindowRect>& rects) const
+		{
+			WindowSums s;
+			s.offset = _offset;
+			for(std::size_t i = 0; i < rects.size(); i++)
+				add(r + rects[i].r0, r + rects[i].r1, c + rects[i].c0, c + rects[i].c1, s);
+			return s;
+		}
+
+		//! sums over the square window of radius (<= halo) around (r, c)
+		WindowSums sums(int r, int c, int radius) const
+		{
+			WindowSums s;
+			s.offset = _offset;
+			add(r - radius, r + radius, c - radius, c + radius, s);
+			return s;
+		}
+
+	private:
+		//! index of the sums over [_r0, r) x [_c0, c)
+		std::size_t index(int r, int c) const
+		{
+			return std::size_t(r - _r0)*_stride + std::size_t(c - _c0);
+		}
+
+		int _r0, _r1, _c0, _c1;
+		std::size_t _stride;
+		double _offset;
+		std::vector<double> _count, _sum, _squares;
+	};
+
+	//! tile size of the neighbourhood operations, values and validity of a tile fit into L2
+	const int neighbourhoodTileRows = 64;
+	const int neighbourhoodTileCols = 512;
+
+	/*!
+	 * split a rows x cols grid into tiles and call kernel(tile) for them, on the
+	 * library thread pool unless policy is sequential,
+	 * kernels run concurrently, so they may only write their tile's cells
+	 */
+	template<class Kernel>
+	void forEachTile(int rows, int cols, Kernel kernel,
+									 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel)
+	{
+		if(rows <= 0 || cols <= 0)
+			return;
+		if(Tools::isParallel(policy))
+			Tools::defaultThreadPool().parallelForTiles(rows, cols, neighbourhoodTileRows,
+																									neighbourhoodTileCols, kernel);
+		else
+			for(int r = 0; r < rows; r += neighbourhoodTileRows)
+				for(int c = 0; c < cols; c += neighbourhoodTileCols)
+				{
+					Tools::Tile t;
+					t.row = r;
+					t.col = c;
+					t.rows = std::min(neighbourhoodTileRows, rows - r);
+					t.cols = std::min(neighbourhoodTileCols, cols - c);
+					kernel(t);
+				}
+	}
+
+	//! forEachTile over g, kernel gets the NeighbourhoodTile with the given halo and fill
+	template<class Kernel>
+	void forEachNeighbourhoodTile(const grid& g, int halo, float fill, Kernel kernel,
+																Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel)
+	{
+		forEachTile(int(g.nrows), int(g.ncols), [&](const Tools::Tile& t)
+		{
+			NeighbourhoodTile nt(g, int(t.row), int(t.col), int(t.rows), int(t.cols), halo, fill);
+			kernel(nt);
+		}, policy);
+	}
+
+	/*!
+	 * out.feld[r][c] = f(tile, r, c) for all cells of in,
+	 * with keepOutNoData cells being no data in out stay untouched
+	 */
+	template<class F>
+	void neighbourhoodMap(const grid& in, grid& out, int halo, float fill, F f,
+												bool keepOutNoData = false,
+												Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel)
+	{
+		forEachNeighbourhoodTile(in, halo, fill, [&](const NeighbourhoodTile& t)
+		{
+			for(int r = t.row(); r < t.endRow(); r++)
+			{
+				float* o = out.feld[r];
+				for(int c = t.col(); c < t.endCol(); c++)
+					if(!keepOutNoData || o[c] != out.nodata)
+						o[c] = f(t, r, c);
+			}
+		}, policy);
+	}
+
+	/*!
+	 * out.feld[r][c] = minimum (or maximum) of the valid values in the
+	 * rectangles (within the halo) around (r, c) for the cells of the tile,
+	 * FLT_MAX (or -FLT_MAX) if there are none;
+	 * with van Herk/Gil-Werman running extrema per rectangle, first along the
+	 * rows, then along the columns, so the cost per cell grows with the number
+	 * of rectangles (1 for MOORE), not with their area
+	 */
+	void windowExtremum(const NeighbourhoodTile& t, const std::vector<WindowRect>& rects,
+											bool maximum, grid& out, bool keepOutNoData = false);
+
+	/*!
+	 * out.feld[r][c] = percentile p (0..1, linear between the sorted values,
+	 * 0.5 is the median) of the valid values in the rectangles (within the
+	 * halo) around (r, c) for the cells of the tile, out.nodata if there are none;
+	 * the values of the tile are replaced by their ranks and a histogram of
+	 * the ranks slides along the rows (Huang), adding and removing one cell per
+	 * row of the window, the histogram is 2 level, so the percentile is found
+	 * in about 2*sqrt(distinct values) steps, quantised data is fastest
+	 */
+	void windowPercentile(const NeighbourhoodTile& t, const std::vector<WindowRect>& rects,
+												double p, grid& out, bool keepOutNoData = false);
+
+	/*!
+	 * like neighbourhoodMap, but f(sat, r, c) gets the SummedAreaTile of
+	 * the tile (with squares if requested) instead of the tile
+	 */
+	template<class F>
+	void summedAreaMap(const grid& in, grid& out, int halo, bool squares, F f,
+										 bool keepOutNoData = false,
+										 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel)
+	{
+		forEachNeighbourhoodTile(in, halo, 0.0f, [&](const NeighbourhoodTile& t)
+		{
+			SummedAreaTile sat(t, squares);
+			for(int r = t.row(); r < t.endRow(); r++)
+			{
+				float* o = out.feld[r];
+				for(int c = t.col(); c < t.endCol(); c++)
+					if(!keepOutNoData || o[c] != out.nodata)
+						o[c] = f(sat, r, c);
+			}
+		}, policy);
+	}
+}
+
+#endif
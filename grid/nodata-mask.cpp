@@ -0,0 +1,183 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "nodata-mask.h"
+#include "grid.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	inline size_t popCount(uint64_t w)
+	{
+		w = w - ((w >> 1) & 0x5555555555555555ULL);
+		w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+		w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+		return size_t((w * 0x0101010101010101ULL) >> 56);
+	}
+}
+
+NoDataMask::NoDataMask(size_t rows, size_t cols, bool valid)
+	: _rows(rows),
+		_cols(cols),
+		_wordsPerRow((cols + 63) / 64),
+		_bits(rows*_wordsPerRow, 0)
+{
+	if(valid)
+	{
+		vector<uint64_t> r(_wordsPerRow, ~uint64_t(0));
+		if(cols % 64)
+			r.back() = (uint64_t(1) << (cols % 64)) - 1;
+		for(size_t i = 0; i < rows; i++)
+			copy(r.begin(), r.end(), row(i));
+	}
+}
+
+NoDataMask::NoDataMask(const grid& g)
+	: _rows(g.nrows),
+		_cols(g.ncols),
+		_wordsPerRow((g.ncols + 63) / 64),
+		_bits(g.nrows*_wordsPerRow, 0)
+{
+	for(size_t i = 0; i < _rows; i++)
+		noDataMaskBits(g.feld[i], _cols, g.nodata, row(i));
+}
+
+NoDataMask& NoDataMask::operator&=(const NoDataMask& other)
+{
+	for(size_t i = 0, size = min(_bits.size(), other._bits.size()); i < size; i++)
+		_bits[i] &= other._bits[i];
+	return *this;
+}
+
+NoDataMask& NoDataMask::operator|=(const NoDataMask& other)
+{
+	for(size_t i = 0, size = min(_bits.size(), other._bits.size()); i < size; i++)
+		_bits[i] |= other._bits[i];
+	return *this;
+}
+
+size_t NoDataMask::count() const
+{
+	size_t c = 0;
+	for(size_t i = 0, size = _bits.size(); i < size; i++)
+		c += popCount(_bits[i]);
+	return c;
+}
+
+void Grids::noDataMaskBits(const float* values, size_t n, int nodata, uint64_t* words)
+{
+	//the valid range is everything outside [lo, hi]
+	float lo, hi;
+	if(nodata < 0) { lo = nextafterf(float(nodata - 1), float(nodata)); hi = float(nodata); }
+	else if(nodata > 0) { lo = float(nodata); hi = nextafterf(float(nodata + 1), float(nodata)); }
+	else { lo = nextafterf(-1.0f, 0.0f); hi = nextafterf(1.0f, 0.0f); }
+	bool exact = nodata > -(1 << 24) && nodata < (1 << 24);
+
+	for(size_t w = 0, i0 = 0; i0 < n; w++, i0 += 64)
+	{
+		size_t e = min(n - i0, size_t(64));
+		const float* v = values + i0;
+		uint64_t bits = 0;
+		if(exact)
+			for(size_t k = 0; k < e; k++)
+				bits |= uint64_t(!(v[k] >= lo && v[k] <= hi)) << k;
+		else
+			for(size_t k = 0; k < e; k++)
+				bits |= uint64_t(!isNoDataValue(v[k], nodata)) << k;
+		words[w] = bits;
+	}
+}
+
+void Grids::maskedSum(const uint64_t* words, size_t n, const float* values,
+											double& sum, size_t& count)
+{
+	sum = 0;
+	count = 0;
+	for(size_t w = 0, i0 = 0; i0 < n; w++, i0 += 64)
+	{
+		size_t e = min(n - i0, size_t(64));
+		uint64_t bits = words[w];
+		const float* v = values + i0;
+		double s = 0;
+		if(bits == ~uint64_t(0))
+			for(size_t k = 0; k < e; k++)
+				s += v[k];
+		else if(bits != 0)
+			for(size_t k = 0; k < e; k++)
+				s += (bits >> k) & 1 ? double(v[k]) : 0.0;
+		sum += s;
+		count += popCount(bits);
+	}
+}
+
+bool Grids::maskedMinMax(const uint64_t* words, size_t n, const float* values,
+												 float& mi, float& ma)
+{
+	float lo = FLT_MAX, hi = -FLT_MAX;
+	bool any = false;
+	for(size_t w = 0, i0 = 0; i0 < n; w++, i0 += 64)
+	{
+		size_t e = min(n - i0, size_t(64));
+		uint64_t bits = words[w];
+		const float* v = values + i0;
+		if(bits == 0)
+			continue;
+		any = true;
+		if(bits == ~uint64_t(0))
+			for(size_t k = 0; k < e; k++)
+			{
+				lo = v[k] < lo ? v[k] : lo;
+				hi = v[k] > hi ? v[k] : hi;
+			}
+		else
+			for(size_t k = 0; k < e; k++)
+			{
+				bool b = (bits >> k) & 1;
+				float l = b ? v[k] : FLT_MAX, h = b ? v[k] : -FLT_MAX;
+				lo = l < lo ? l : lo;
+				hi = h > hi ? h : hi;
+			}
+	}
+	if(any)
+	{
+		mi = lo;
+		ma = hi;
+	}
+	return any;
+}
+
+void Grids::maskedValues(const NoDataMask& mask, const float* const* rows,
+												 float fill, vector<float>& values, vector<float>& valid)
+{
+	size_t nr = mask.rows(), nc = mask.cols();
+	values.resize(nr*nc);
+	valid.resize(nr*nc);
+	for(size_t i = 0; i < nr; i++)
+	{
+		const uint64_t* words = mask.row(i);
+		const float* from = rows[i];
+		float* v = &values[i*nc];
+		float* ok = &valid[i*nc];
+		maskedApply(words, nc, v, fill, [from](size_t j) { return from[j]; });
+		maskedApply(words, nc, ok, 0.0f, [](size_t) { return 1.0f; });
+	}
+}
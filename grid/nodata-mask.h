@@ -0,0 +1,156 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+#ifndef NODATA_MASK_H_
+#define NODATA_MASK_H_
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+namespace Grids
+{
+	class grid;
+
+	/*!
+	 * is value a no data value in the sense of grid/GridP (int(value) == nodata),
+	 * written as range test, so loops using it don't convert and can be vectorized
+	 */
+	inline bool isNoDataValue(float value, int nodata)
+	{
+		//int(value) truncates towards zero
+		double v = value, nd = nodata;
+		return nodata < 0 ? (v > nd - 1 && v <= nd)
+			: nodata > 0 ? (v >= nd && v < nd + 1)
+			: (v > -1 && v < 1);
+	}
+
+	/*!
+	 * packed validity bits of a grid, 1 = data, 0 = no data, one bit per cell,
+	 * every row starts at a new 64 bit word, unused bits are 0
+	 */
+	class NoDataMask
+	{
+	public:
+		NoDataMask() : _rows(0), _cols(0), _wordsPerRow(0) {}
+
+		NoDataMask(std::size_t rows, std::size_t cols, bool valid = false);
+
+		//! mask of the data cells of g
+		explicit NoDataMask(const grid& g);
+
+		bool empty() const { return _bits.empty(); }
+		std::size_t rows() const { return _rows; }
+		std::size_t cols() const { return _cols; }
+		std::size_t wordsPerRow() const { return _wordsPerRow; }
+
+		uint64_t* row(std::size_t r) { return &_bits[r*_wordsPerRow]; }
+		const uint64_t* row(std::size_t r) const { return &_bits[r*_wordsPerRow]; }
+
+		bool isValid(std::size_t r, std::size_t c) const
+		{
+			return (row(r)[c >> 6] >> (c & 63)) & 1;
+		}
+
+		void set(std::size_t r, std::size_t c, bool valid)
+		{
+			uint64_t& w = row(r)[c >> 6];
+			uint64_t bit = uint64_t(1) << (c & 63);
+			w = valid ? (w | bit) : (w & ~bit);
+		}
+
+		//! valid where both are valid (same size)
+		NoDataMask& operator&=(const NoDataMask& other);
+
+		//! valid where one of both is valid (same size)
+		NoDataMask& operator|=(const NoDataMask& other);
+
+		//! number of valid cells
+		std::size_t count() const;
+
+	private:
+		std::size_t _rows, _cols, _wordsPerRow;
+		std::vector<uint64_t> _bits;
+	};
+
+	//! set the bits of the n values in words (bits beyond n are cleared)
+	void noDataMaskBits(const float* values, std::size_t n, int nodata, uint64_t* words);
+
+	/*!
+	 * out[i] = f(i) for the valid cells, fill for the others, cells in
+	 * completely valid or invalid words are done without looking at single bits,
+	 * f has to be side effect free, it may be called for invalid cells too
+	 */
+	template<class F>
+	void maskedApply(const uint64_t* words, std::size_t n, float* out, float fill, F f)
+	{
+		for(std::size_t w = 0, i0 = 0; i0 < n; w++, i0 += 64)
+		{
+			std::size_t e = n - i0 < 64 ? n - i0 : 64;
+			uint64_t bits = words[w];
+			if(bits == ~uint64_t(0))
+				for(std::size_t k = 0; k < e; k++)
+					out[i0 + k] = f(i0 + k);
+			else if(bits == 0)
+				for(std::size_t k = 0; k < e; k++)
+					out[i0 + k] = fill;
+			else
+				for(std::size_t k = 0; k < e; k++)
+				{
+					float v = f(i0 + k);
+					out[i0 + k] = (bits >> k) & 1 ? v : fill;
+				}
+		}
+	}
+
+	/*!
+	 * out[i] = f(i) for the valid cells, the others keep their value,
+	 * f is only called for valid cells
+	 */
+	template<class F>
+	void maskedUpdate(const uint64_t* words, std::size_t n, float* out, F f)
+	{
+		for(std::size_t w = 0, i0 = 0; i0 < n; w++, i0 += 64)
+		{
+			std::size_t e = n - i0 < 64 ? n - i0 : 64;
+			uint64_t bits = words[w];
+			if(bits == ~uint64_t(0))
+				for(std::size_t k = 0; k < e; k++)
+					out[i0 + k] = f(i0 + k);
+			else if(bits != 0)
+				for(std::size_t k = 0; k < e; k++)
+					if((bits >> k) & 1)
+						out[i0 + k] = f(i0 + k);
+		}
+	}
+
+	//! sum and count of the valid values
+	void maskedSum(const uint64_t* words, std::size_t n, const float* values,
+								 double& sum, std::size_t& count);
+
+	//! min/max of the valid values, false if there are none
+	bool maskedMinMax(const uint64_t* words, std::size_t n, const float* values,
+										float& min, float& max);
+
+	/*!
+	 * copy of the values with fill instead of no data values and the validity
+	 * as 0/1, so neighbourhood loops can sum or compare without branches
+	 */
+	void maskedValues(const NoDataMask& mask, const float* const* rows,
+										float fill, std::vector<float>& values, std::vector<float>& valid);
+}
+
+#endif
@@ -0,0 +1,144 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <cmath>
+#include <algorithm>
+
+#include "point-index.h"
+
+using namespace Grids;
+using namespace std;
+
+PointIndex::PointIndex(const double* const* xy, const vector<int>& indices, double pointsPerBucket)
+	: _x0(0), _y0(0), _size(1), _rows(1), _cols(1)
+{
+	size_t n = indices.size();
+	_points.resize(n);
+	double x1 = 0, y1 = 0;
+	for(size_t i = 0; i < n; i++)
+	{
+		Entry& e = _points[i];
+		e.x = xy[indices[i]][0];
+		e.y = xy[indices[i]][1];
+		e.index = indices[i];
+		if(i == 0)
+		{
+			_x0 = x1 = e.x;
+			_y0 = y1 = e.y;
+		}
+		_x0 = min(_x0, e.x);
+		_y0 = min(_y0, e.y);
+		x1 = max(x1, e.x);
+		y1 = max(y1, e.y);
+	}
+
+	//square buckets, at least as large as for all points on a line, so
+	//there are O(n) buckets for flat extents too
+	double width = x1 - _x0, height = y1 - _y0;
+	if(n > 0 && max(width, height) > 0)
+		_size = max(sqrt(width*height*pointsPerBucket/n), max(width, height)*pointsPerBucket/n);
+	_cols = int(width/_size) + 1;
+	_rows = int(height/_size) + 1;
+
+	//counting sort into the buckets, by index within a bucket
+	_start.assign(size_t(_rows)*_cols + 1, 0);
+	vector<size_t> bucket(n);
+	for(size_t i = 0; i < n; i++)
+	{
+		bucket[i] = size_t(bucketRow(_points[i].y))*_cols + bucketCol(_points[i].x);
+		_start[bucket[i] + 1]++;
+	}
+	for(size_t b = 1; b < _start.size(); b++)
+		_start[b] += _start[b - 1];
+	vector<Entry> sorted(n);
+	vector<size_t> next(_start.begin(), _start.end() - 1);
+	for(size_t i = 0; i < n; i++)
+		sorted[next[bucket[i]]++] = _points[i];
+	_points.swap(sorted);
+}
+
+int PointIndex::bucketCol(double x) const
+{
+	double c = floor((x - _x0)/_size);
+	return c < 0 ? 0 : (c >= _cols ? _cols - 1 : int(c));
+}
+
+int PointIndex::bucketRow(double y) const
+{
+	double r = floor((y - _y0)/_size);
+	return r < 0 ? 0 : (r >= _rows ? _rows - 1 : int(r));
+}
+
+int PointIndex::nearest(double x, double y) const
+{
+	int best = -1;
+	double bestD2 = 0;
+	int cr = bucketRow(y), cc = bucketCol(x);
+	//the rings of buckets around the bucket of (x, y)
+	for(int k = 0; ; k++)
+	{
+		int r0 = cr - k, r1 = cr + k, c0 = cc - k, c1 = cc + k;
+		if(r0 < 0 && c0 < 0 && r1 >= _rows && c1 >= _cols)
+			break;
+		if(best >= 0)
+		{
+			//the points of this ring are outside the buckets of the rings before,
+			//on the sides where there are buckets left
+			double bound = HUGE_VAL;
+			if(c0 >= 0)
+				bound = min(bound, max(0.0, x - (_x0 + (c0 + 1)*_size)));
+			if(c1 < _cols)
+				bound = min(bound, max(0.0, _x0 + c1*_size - x));
+			if(r0 >= 0)
+				bound = min(bound, max(0.0, y - (_y0 + (r0 + 1)*_size)));
+			if(r1 < _rows)
+				bound = min(bound, max(0.0, _y0 + r1*_size - y));
+			bound -= 1e-9*_size;
+			if(bound > 0 && bound*bound > bestD2)
+				break;
+		}
+
+		auto visit = [&](int r, int c)
+		{
+			size_t b = size_t(r)*_cols + c;
+			for(size_t i = _start[b]; i < _start[b + 1]; i++)
+			{
+				const Entry& e = _points[i];
+				double d2 = (x - e.x)*(x - e.x) + (y - e.y)*(y - e.y);
+				if(best < 0 || d2 < bestD2 || (d2 == bestD2 && e.index < best))
+				{
+					best = e.index;
+					bestD2 = d2;
+				}
+			}
+		};
+		for(int r = max(r0, 0); r <= min(r1, _rows - 1); r++)
+		{
+			if(r == r0 || r == r1)
+			{
+				for(int c = max(c0, 0); c <= min(c1, _cols - 1); c++)
+					visit(r, c);
+				continue;
+			}
+			if(c0 >= 0)
+				visit(r, c0);
+			if(c1 < _cols)
+				visit(r, c1);
+		}
+	}
+	return best;
+}
@@ -0,0 +1,83 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef POINT_INDEX_H_
+#define POINT_INDEX_H_
+
+#include <vector>
+#include <cstddef>
+
+namespace Grids
+{
+	/*!
+	 * bucket grid over a set of points (x, y) for the points near a location
+	 * and the nearest point, the points are sorted into the buckets by a
+	 * counting sort, a bucket holds about pointsPerBucket points
+	 */
+	class PointIndex
+	{
+	public:
+		/*!
+		 * @param xy rows (x, y, ...) like point::feld
+		 * @param indices the rows to index
+		 */
+		PointIndex(const double* const* xy, const std::vector<int>& indices,
+							 double pointsPerBucket = 2);
+
+		std::size_t size() const { return _points.size(); }
+
+		/*!
+		 * f(index) for the points in the buckets touching the square of
+		 * 2*radius around (x, y), these are at least all within radius
+		 */
+		template<class F>
+		void forEachNear(double x, double y, double radius, F f) const
+		{
+			if(_points.empty())
+				return;
+			int c0 = bucketCol(x - radius), c1 = bucketCol(x + radius);
+			int r0 = bucketRow(y - radius), r1 = bucketRow(y + radius);
+			for(int r = r0; r <= r1; r++)
+				for(std::size_t i = _start[r*_cols + c0]; i < _start[r*_cols + c1 + 1]; i++)
+					f(_points[i].index);
+		}
+
+		/*!
+		 * index of the nearest point to (x, y) (the lowest index of equally
+		 * near points), -1 if there are no points
+		 */
+		int nearest(double x, double y) const;
+
+	private:
+		struct Entry
+		{
+			double x, y;
+			int index;
+		};
+
+		int bucketCol(double x) const;
+		int bucketRow(double y) const;
+
+		double _x0, _y0, _size;
+		int _rows, _cols;
+		//! points of bucket b: [_start[b], _start[b + 1]), buckets row by row
+		std::vector<std::size_t> _start;
+		std::vector<Entry> _points;
+	};
+}
+
+#endif
@@ -0,0 +1,331 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <mutex>
+
+#include "viewshed.h"
+#include "nodata-mask.h"
+
+using namespace Grids;
+using namespace std;
+
+namespace
+{
+	const double noHeight = -numeric_limits<double>::infinity();
+
+	//! the dem as seen by one observer: heights lowered by the curvature, slopes of the lines of sight
+	class Sight
+	{
+	public:
+		Sight(const grid& dem, const ViewshedObserver& o, const ViewshedOptions& options)
+			: _dem(dem), _o(o), _options(options),
+				_rows(int(dem.nrows)), _cols(int(dem.ncols))
+		{
+			_z0 = double(dem.feld[o.row][o.col]) + o.height;
+		}
+
+		bool isValid(int r, int c) const { return !isNoDataValue(_dem.feld[r][c], _dem.nodata); }
+
+		//! distance to the observer
+		double distance(double dr, double dc) const
+		{
+			return sqrt(dr*dr + dc*dc)*_dem.csize;
+		}
+
+		//! slope of the line of sight to height z at distance d, z lowered by the curvature
+		double slope(double z, double d) const
+		{
+			if(_options.earthDiameter > 0)
+				z -= d*d/_options.earthDiameter;
+			return (z - _z0)/d;
+		}
+
+		//! slope to the ground of cell (r, c) (noHeight for no data)
+		double groundSlope(int r, int c, double d) const
+		{
+			return isValid(r, c) ? slope(_dem.feld[r][c], d) : noHeight;
+		}
+
+		//! slope to a cell looked at
+		double targetSlope(int r, int c, double d) const
+		{
+			return slope(double(_dem.feld[r][c]) + _options.targetHeight, d);
+		}
+
+		/*!
+		 * slope to the ground at the point major steps along the major axis
+		 * and the fractional minor position on the other axis, interpolated
+		 * between the two cells (no data cells left out)
+		 */
+		double interpolatedSlope(bool rowMajor, int major, double minor, double d) const
+		{
+			int m0 = int(floor(minor));
+			double f = minor - m0;
+			int m1 = f > 0 ? m0 + 1 : m0;
+			int r0 = rowMajor ? major : m0, c0 = rowMajor ? m0 : major;
+			int r1 = rowMajor ? major : m1, c1 = rowMajor ? m1 : major;
+			bool v0 = isValid(r0, c0), v1 = isValid(r1, c1);
+			if(!v0 && !v1)
+				return noHeight;
+			double z = !v1 ? _dem.feld[r0][c0]
+											: !v0 ? _dem.feld[r1][c1]
+														: (1 - f)*_dem.feld[r0][c0] + f*_dem.feld[r1][c1];
+			return slope(z, d);
+		}
+
+		void exact(vector<unsigned char>& visible) const;
+		void r2(vector<unsigned char>& visible) const;
+		void xdraw(vector<unsigned char>& visible) const;
+
+	private:
+		void ray(int tr, int tc, vector<unsigned char>& visible) const;
+
+		const grid& _dem;
+		ViewshedObserver _o;
+		const ViewshedOptions& _options;
+		int _rows, _cols;
+		double _z0;
+	};
+
+	void Sight::exact(vector<unsigned char>& visible) const
+	{
+		for(int r = 0; r < _rows; r++)
+		{
+			for(int c = 0; c < _cols; c++)
+			{
+				if(!isValid(r, c))
+					continue;
+				int dr = r - _o.row, dc = c - _o.col;
+				int steps = max(abs(dr), abs(dc));
+				if(steps <= 1)
+				{
+					visible[size_t(r)*_cols + c] = 1;
+					continue;
+				}
+				bool rowMajor = abs(dr) >= abs(dc);
+				double d = distance(dr, dc);
+				double target = targetSlope(r, c, d), horizon = noHeight;
+				for(int t = 1; t < steps && horizon <= target; t++)
+				{
+					double s = double(t)/steps;
+					horizon = rowMajor
+										? max(horizon, interpolatedSlope(true, _o.row + (dr > 0 ? t : -t), _o.col + s*dc, s*d))
+										: max(horizon, interpolatedSlope(false, _o.col + (dc > 0 ? t : -t), _o.row + s*dr, s*d));
+				}
+				visible[size_t(r)*_cols + c] = horizon <= target;
+			}
+		}
+	}
+
+	//! walk the line of sight to (tr, tc), marking the visible cells passed
+	void Sight::ray(int tr, int tc, vector<unsigned char>& visible) const
+	{
+		int dr = tr - _o.row, dc = tc - _o.col;
+		int steps = max(abs(dr), abs(dc));
+		bool rowMajor = abs(dr) >= abs(dc);
+		double length = distance(dr, dc), horizon = noHeight;
+		for(int t = 1; t <= steps; t++)
+		{
+			double s = double(t)/steps;
+			int major = rowMajor ? _o.row + (dr > 0 ? t : -t) : _o.col + (dc > 0 ? t : -t);
+			double minor = rowMajor ? _o.col + s*dc : _o.row + s*dr;
+			int r = rowMajor ? major : int(floor(minor + 0.5));
+			int c = rowMajor ? int(floor(minor + 0.5)) : major;
+			if(isValid(r, c) && (t == 1 || targetSlope(r, c, distance(r - _o.row, c - _o.col)) >= horizon))
+				visible[size_t(r)*_cols + c] = 1;
+			horizon = max(horizon, interpolatedSlope(rowMajor, major, minor, s*length));
+		}
+	}
+
+	void Sight::r2(vector<unsigned char>& visible) const
+	{
+		for(int c = 0; c < _cols; c++)
+		{
+			ray(0, c, visible);
+			ray(_rows - 1, c, visible);
+		}
+		for(int r = 1; r < _rows - 1; r++)
+		{
+			ray(r, 0, visible);
+			ray(r, _cols - 1, visible);
+		}
+	}
+
+	void Sight::xdraw(vector<unsigned char>& visible) const
+	{
+		//horizon (largest slope) of the line of sight up to every cell
+		vector<double> horizon(size_t(_rows)*_cols, noHeight);
+		int rings = max(max(_o.row, _rows - 1 - _o.row), max(_o.col, _cols - 1 - _o.col));
+		for(int k = 1; k <= rings; k++)
+		{
+			int r0 = max(_o.row - k, 0), r1 = min(_o.row + k, _rows - 1);
+			int c0 = max(_o.col - k, 0), c1 = min(_o.col + k, _cols - 1);
+			for(int r = r0; r <= r1; r++)
+			{
+				int dr = r - _o.row;
+				//the ring's columns in this row: all in the top and bottom row, else the two sides
+				bool full = abs(dr) == k;
+				for(int c = full ? c0 : _o.col - k; c <= (full ? c1 : _o.col + k); c += full ? 1 : 2*k)
+				{
+					if(c < c0 || c > c1)
+						continue;
+					int dc = c - _o.col;
+					double d = distance(dr, dc);
+					double inner = noHeight;
+					if(k > 1)
+					{
+						//where the line of sight crosses the inner ring
+						double s = double(k - 1)/k;
+						bool rowMajor = abs(dr) >= abs(dc);
+						int major = rowMajor ? _o.row + (dr > 0 ? k - 1 : 1 - k) : _o.col + (dc > 0 ? k - 1 : 1 - k);
+						double minor = rowMajor ? _o.col + s*dc : _o.row + s*dr;
+						int m0 = int(floor(minor));
+						double f = minor - m0;
+						const double* h = &horizon[0];
+						double h0 = rowMajor ? h[size_t(major)*_cols + m0] : h[size_t(m0)*_cols + major];
+						double h1 = f <= 0 ? h0 : rowMajor ? h[size_t(major)*_cols + m0 + 1] : h[size_t(m0 + 1)*_cols + major];
+						inner = h0 == noHeight ? h1 : h1 == noHeight ? h0 : (1 - f)*h0 + f*h1;
+					}
+					size_t i = size_t(r)*_cols + c;
+					if(isValid(r, c))
+					{
+						visible[i] = targetSlope(r, c, d) >= inner;
+						horizon[i] = max(inner, groundSlope(r, c, d));
+					}
+					else
+						horizon[i] = inner;
+				}
+			}
+		}
+	}
+
+	//! the visible buffers (a byte per cell) of the parallel observers stay below this
+	const size_t visibleBudget = size_t(256) << 20;
+
+	/*!
+	 * run f(acc, observer, visible, begin, end) for all observers and all
+	 * blocks of rows [begin, end) of the single shared accumulator acc,
+	 * every block is guarded by its own mutex, the observers run in parallel
+	 * with one visible buffer each (bounded by visibleBudget)
+	 */
+	template<class T, class F>
+	void forEachViewshed(const grid& dem, const vector<ViewshedObserver>& observers,
+											 const ViewshedOptions& options, Tools::ExecutionPolicy policy,
+											 vector<T>& acc, T init, F f)
+	{
+		size_t cells = size_t(dem.nrows)*dem.ncols;
+		acc.assign(cells, init);
+		size_t parts = Tools::isParallel(policy)
+									 ? min(observers.size(), size_t(Tools::defaultThreadPool().size())) : 1;
+		parts = max<size_t>(min(parts, visibleBudget / max<size_t>(cells, 1)), 1);
+		//a few blocks per part, so the parts rarely wait for each other
+		size_t blocks = min(size_t(dem.nrows), parts*4);
+		size_t blockRows = blocks > 0 ? (size_t(dem.nrows) + blocks - 1) / blocks : 0;
+		vector<mutex> locks(blocks);
+		auto run = [&](size_t p)
+		{
+			vector<unsigned char> visible;
+			for(size_t i = p; i < observers.size(); i += parts)
+			{
+				viewshed(dem, observers[i], visible, options);
+				//every part starts at another block
+				for(size_t k = 0; k < blocks; k++)
+				{
+					size_t b = (k + p*blocks / parts) % blocks;
+					size_t begin = min(b*blockRows, size_t(dem.nrows))*dem.ncols;
+					size_t end = min((b + 1)*blockRows, size_t(dem.nrows))*dem.ncols;
+					lock_guard<mutex> lock(locks[b]);
+					f(acc, observers[i], visible, begin, end);
+				}
+			}
+		};
+		if(parts > 1)
+			Tools::defaultThreadPool().parallelFor(parts, run);
+		else
+			run(0);
+	}
+}
+
+void Grids::viewshed(const grid& dem, const ViewshedObserver& observer,
+										 vector<unsigned char>& visible, const ViewshedOptions& options)
+{
+	visible.assign(dem.nrows*dem.ncols, 0);
+	if(observer.row < 0 || observer.row >= int(dem.nrows)
+		 || observer.col < 0 || observer.col >= int(dem.ncols)
+		 || isNoDataValue(dem.feld[observer.row][observer.col], dem.nodata))
+		return;
+
+	Sight sight(dem, observer, options);
+	visible[size_t(observer.row)*dem.ncols + observer.col] = 1;
+	switch(options.algorithm)
+	{
+	case eViewshedExact: sight.exact(visible); break;
+	case eViewshedR2: sight.r2(visible); break;
+	case eViewshedXDraw: sight.xdraw(visible); break;
+	}
+}
+
+grid* Grids::cumulativeViewshed(const grid& dem, const vector<ViewshedObserver>& observers,
+																const ViewshedOptions& options, Tools::ExecutionPolicy policy)
+{
+	vector<int> count;
+	forEachViewshed(dem, observers, options, policy, count, 0,
+									[](vector<int>& count, const ViewshedObserver&, const vector<unsigned char>& visible,
+										 size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; i++)
+			count[i] += visible[i];
+	});
+
+	grid* gx = gridLike(dem);
+	for(size_t r = 0; r < dem.nrows; r++)
+		for(size_t c = 0; c < dem.ncols; c++)
+			gx->feld[r][c] = isNoDataValue(dem.feld[r][c], dem.nodata)
+				? float(dem.nodata) : float(count[r*dem.ncols + c]);
+	return gx;
+}
+
+grid* Grids::viewshedDistance(const grid& dem, const vector<ViewshedObserver>& observers,
+															const ViewshedOptions& options, Tools::ExecutionPolicy policy)
+{
+	size_t cols = dem.ncols;
+	vector<float> nearest;
+	forEachViewshed(dem, observers, options, policy, nearest, -1.0f,
+									[&](vector<float>& dist, const ViewshedObserver& o, const vector<unsigned char>& visible,
+											size_t begin, size_t end)
+	{
+		for(size_t i = begin; i < end; i++)
+			if(visible[i])
+			{
+				double dr = double(i / cols) - o.row, dc = double(i % cols) - o.col;
+				float d = float(sqrt(dr*dr + dc*dc)*dem.csize);
+				if(dist[i] < 0 || d < dist[i])
+					dist[i] = d;
+			}
+	});
+
+	grid* gx = gridLike(dem);
+	for(size_t r = 0; r < dem.nrows; r++)
+		for(size_t c = 0; c < dem.ncols; c++)
+			gx->feld[r][c] = isNoDataValue(dem.feld[r][c], dem.nodata)
+				? float(dem.nodata) : nearest[r*cols + c];
+	return gx;
+}
@@ -0,0 +1,93 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+* License, v. 2.0. If a copy of the MPL was not distributed with this
+* file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+/*
+Authors:
+Michael Berg <michael.berg@zalf.de>
+
+Maintainers:
+Currently maintained by the authors.
+
+This file is part of the util library used by models created at the Institute of
+Landscape Systems Analysis at the ZALF.
+Copyright (C) Leibniz Centre for Agricultural Landscape Research (ZALF)
+*/
+
+
+#ifndef VIEWSHED_H_
+#define VIEWSHED_H_
+
+#include <vector>
+
+#include "grid.h"
+#include "common/thread-pool.h"
+
+namespace Grids
+{
+	//! how the lines of sight are evaluated
+	enum ViewshedAlgorithm
+	{
+		//! own line of sight to every cell, the heights between the cells are
+		//! interpolated, O(cells*distance) per observer
+		eViewshedExact = 0,
+		//! lines of sight to the border cells only, every cell passed is
+		//! tested against the horizon of its ray, O(cells) per observer
+		eViewshedR2 = 1,
+		//! the horizon is propagated ring by ring, interpolated between the two
+		//! cells of the inner ring next to the line of sight, O(cells) per observer
+		eViewshedXDraw = 2
+	};
+
+	//! observer at a cell of the grid, height above ground
+	struct ViewshedObserver
+	{
+		ViewshedObserver(int row = 0, int col = 0, double height = 0)
+			: row(row), col(col), height(height) {}
+
+		int row, col;
+		double height;
+	};
+
+	struct ViewshedOptions
+	{
+		ViewshedOptions(ViewshedAlgorithm algorithm = eViewshedXDraw)
+			: algorithm(algorithm), targetHeight(0), earthDiameter(12742000.0) {}
+
+		ViewshedAlgorithm algorithm;
+		//! height above ground of the cells looked at
+		double targetHeight;
+		//! the earth curvature lowers a cell at distance d by d^2/earthDiameter, 0 = flat
+		double earthDiameter;
+	};
+
+	/*!
+	 * visible[r*ncols + c] = 1 if cell (r, c) can be seen from the observer,
+	 * no data cells don't block the view and are never visible,
+	 * nothing is visible from an observer outside of the grid or on no data
+	 */
+	void viewshed(const grid& dem, const ViewshedObserver& observer,
+								std::vector<unsigned char>& visible,
+								const ViewshedOptions& options = ViewshedOptions());
+
+	/*!
+	 * number of observers every cell can be seen from (no data where dem has
+	 * no data), the observers are processed on the library thread pool
+	 * unless policy is sequential (with one byte per cell for every observer
+	 * in work, at most 256 MB, and one shared count grid)
+	 */
+	grid* cumulativeViewshed(const grid& dem, const std::vector<ViewshedObserver>& observers,
+													 const ViewshedOptions& options = ViewshedOptions(),
+													 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+
+	/*!
+	 * distance in map units (cells times csize) to the nearest observer every
+	 * cell can be seen from, -1 if it can't be seen, no data where dem has no data,
+	 * processed like cumulativeViewshed
+	 */
+	grid* viewshedDistance(const grid& dem, const std::vector<ViewshedObserver>& observers,
+												 const ViewshedOptions& options = ViewshedOptions(),
+												 Tools::ExecutionPolicy policy = Tools::ExecutionPolicy::parallel);
+}
+
+#endif
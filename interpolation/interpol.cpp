@@ -1,4 +1,5 @@
 #include "interpol.h"
+#include "common/thread-pool.h"
 
 
 #define SIM_LENGTH 1 // 30
@@ -201,7 +202,8 @@ interpolation::~interpolation()
   delete voronoi;
 }
 
-double interpolation::get_TX(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_TX(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -233,16 +235,19 @@ double interpolation::get_TX(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_TX(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_TX(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0)   // return value of weather if dist<100m
         return(stv[k]->get_TX(yearday));
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_TM(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_TM(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -274,16 +279,19 @@ double interpolation::get_TM(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_TM(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_TM(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0)   // return value of weather if dist<100m
         return(stv[k]->get_TM(yearday));
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_TN(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_TN(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -315,16 +323,19 @@ double interpolation::get_TN(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_TN(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_TN(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0)   // return value of weather if dist<100m
         return(stv[k]->get_TN(yearday));
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_RR(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_RR(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -360,19 +371,22 @@ double interpolation::get_RR(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_RR(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_RR(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0){   // return value of weather if dist<100m
           // cerr << k << " " << dist << " " << hwx << " " << stv[k]->hw <<
           //        " " << rwx << " " << stv[k]->rw << endl;
           return(stv[k]->get_RR(yearday));
       }
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_SD(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_SD(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -408,19 +422,22 @@ double interpolation::get_SD(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_SD(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_SD(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0){   // return value of weather if dist<100m
           // cerr << k << " " << dist << " " << hwx << " " << stv[k]->hw <<
           //        " " << rwx << " " << stv[k]->rw << endl;
           return(stv[k]->get_SD(yearday));
       }
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_FF(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_FF(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -456,19 +473,22 @@ double interpolation::get_FF(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_FF(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_FF(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0){   // return value of weather if dist<100m
           // cerr << k << " " << dist << " " << hwx << " " << stv[k]->hw <<
           //        " " << rwx << " " << stv[k]->rw << endl;
           return(stv[k]->get_FF(yearday));
       }
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_RF(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_RF(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -504,19 +524,22 @@ double interpolation::get_RF(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_RF(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_RF(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0){   // return value of weather if dist<100m
           // cerr << k << " " << dist << " " << hwx << " " << stv[k]->hw <<
           //        " " << rwx << " " << stv[k]->rw << endl;
           return(stv[k]->get_RF(yearday));
       }
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
-double interpolation::get_GS(int yearday,double hwx,double rwx,double nn)
+double interpolation::get_GS(int yearday,double hwx,double rwx,double nn,
+                             bool storeResidium)
 {
   // calc the regression
   double varx,vary,varxy,xquer,yquer;
@@ -548,15 +571,27 @@ double interpolation::get_GS(int yearday,double hwx,double rwx,double nn)
   sum=sumz=0.0;
   for(int k=0; k<stv.size(); k++){
       dist=stv[k]->dist(hwx,rwx);
-      stv[k]->residium=(stv[k]->get_GS(yearday))-(m*(stv[k]->nn)+n);
+      double residium=(stv[k]->get_GS(yearday))-(m*(stv[k]->nn)+n);
+      if(storeResidium)
+        stv[k]->residium=residium;
       if(dist<10000.0)   // return value of weather if dist<100m
         return(stv[k]->get_GS(yearday));
       sum+=1.0/(dist);
-      sumz+=(stv[k]->residium)/(dist);
+      sumz+=residium/(dist);
   }
   return(m*nn+n+sumz/sum);
 }
 
+// last cell map_* interpolates (row by row), false if there is none
+static bool lastDataCell(const grid* g, int& row, int& col)
+{
+  for(row=g->nrows-1; row>=0; row--)
+    for(col=g->ncols-1; col>=0; col--)
+      if((int)(g->feld[row][col])!=g->nodata)
+        return true;
+  return false;
+}
+
 void interpolation::map_RR(int yearday)
 {
   // commulative function
@@ -564,11 +599,19 @@ void interpolation::map_RR(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_RR(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_RR(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_TM(int yearday)
@@ -578,11 +621,19 @@ void interpolation::map_TM(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_TM(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_TM(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_TN(int yearday)
@@ -592,11 +643,19 @@ void interpolation::map_TN(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_TM(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_TM(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_TX(int yearday)
@@ -606,11 +665,19 @@ void interpolation::map_TX(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_TM(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_TM(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_GS(int yearday)
@@ -620,11 +687,19 @@ void interpolation::map_GS(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_GS(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_GS(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_SD(int yearday)
@@ -634,11 +709,19 @@ void interpolation::map_SD(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_SD(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_SD(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 void interpolation::map_FF(int yearday)
@@ -648,11 +731,19 @@ void interpolation::map_FF(int yearday)
   double dy=igrid->csize;
   double x=igrid->xcorner+0.5*igrid->csize;
   double dx=igrid->csize;
-  for(int i=0; i<igrid->nrows; i++)
+  int li, lj;
+  bool any=lastDataCell(igrid,li,lj);
+  // rows in parallel on the library thread pool
+  Tools::defaultThreadPool().parallelFor(igrid->nrows, [&](size_t i)
+  {
     for(int j=0; j<igrid->ncols; j++)
       if((int)(igrid->feld[i][j])!=igrid->nodata)
         igrid->feld[i][j]+=get_FF(yearday,
-            y-i*dy,x+j*dx,dgm->feld[i][j]);
+            y-i*dy,x+j*dx,dgm->feld[i][j],false);
+  });
+  // weather::residium as the row by row loop left it: from the last cell
+  if(any)
+    get_FF(yearday,y-li*dy,x+lj*dx,dgm->feld[li][lj]);
 }
 
 
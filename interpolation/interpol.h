@@ -64,14 +64,14 @@ class interpolation{
   interpolation(grid*,grid*);  // dem,voronoi as grid
   ~interpolation();
   void add_stat(int,int,int,int); // id,sz,begin,end
-  double get_TX(int,double,double,double); // yearday, hw,rw,nn 
-  double get_TM(int,double,double,double); // yearday, hw,rw,nn 
-  double get_TN(int,double,double,double); // yearday, hw,rw,nn 
-  double get_RR(int,double,double,double); // yearday, hw,rw,nn 
-  double get_GS(int,double,double,double); // yearday, hw,rw,nn 
-  double get_SD(int,double,double,double); // yearday, hw,rw,nn 
-  double get_FF(int,double,double,double); // yearday, hw,rw,nn
-  double get_RF(int,double,double,double); // yearday, hw,rw,nn
+  double get_TX(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_TM(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_TN(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_RR(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_GS(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_SD(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium 
+  double get_FF(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium
+  double get_RF(int,double,double,double,bool=true); // yearday, hw,rw,nn, set weather::residium
   void map_TM(int);
   void map_TX(int);
   void map_TN(int);